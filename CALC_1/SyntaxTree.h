@@ -7,7 +7,6 @@
 #include <map>
 #include <iterator>
 #include <exception>
-#include "create_map.h"
 #include "Logger.h"
 
 using std::pair;
@@ -2,7 +2,6 @@
 #include <cctype>
 #include <vector>
 #include "Tokenizer.h"
-#include "create_map.h"
 #include "utils.h"
 
 #define DEBUG_LOG_OFF
@@ -12,7 +11,6 @@
 using std::istream;
 using std::string;
 using std::exception;
-using std::map;
 using std::vector;
 
 TokenizerException::TokenizerException(string msg) :
@@ -86,26 +84,29 @@ int LocatableStream::getLinePosition() const {
     return _linePosition;
 }
 
-map<Tokenizer::ValueType, string> Tokenizer::_valueTypeTags =
-        create_map<Tokenizer::ValueType, string>
-        (T_UNDEFINED, "Undefined symbol")
-(T_WORD, "Word")
-(T_INTEGER, "Integer")
-(T_REAL, "Real")
-(T_PLUS, "Plus")
-(T_MINUS, "Minus")
-(T_MULT, "Multiplication")
-(T_DIV, "Division")
-(T_POWER, "Power")
-(T_MOD, "Mod")
-(T_EQUALS, "Equals")
-(T_SEMICOLON, "Semicolon")
-(T_OPENING_RBRACKET, "Opening round bracket")
-(T_CLOSING_RBRACKET, "Closing round bracket")
-(T_OPENING_CBRACKET, "Opening curly bracket")
-(T_CLOSING_CBRACKET, "Closing curly bracket")
-(T_EOF, "End Of File")
-(T_KEYWORD, "Keyword");
+constexpr frozen_map<Tokenizer::ValueType, const char *, Tokenizer::VALUE_TYPE_COUNT>
+Tokenizer::_valueTypeTags = {{
+    {T_UNDEFINED, "Undefined symbol"},
+    {T_WORD, "Word"},
+    {T_INTEGER, "Integer"},
+    {T_REAL, "Real"},
+    {T_PLUS, "Plus"},
+    {T_MINUS, "Minus"},
+    {T_MULT, "Multiplication"},
+    {T_DIV, "Division"},
+    {T_POWER, "Power"},
+    {T_MOD, "Mod"},
+    {T_EQUALS, "Equals"},
+    {T_SEMICOLON, "Semicolon"},
+    {T_OPENING_RBRACKET, "Opening round bracket"},
+    {T_CLOSING_RBRACKET, "Closing round bracket"},
+    {T_OPENING_CBRACKET, "Opening curly bracket"},
+    {T_CLOSING_CBRACKET, "Closing curly bracket"},
+    {T_EOF, "End Of File"},
+    {T_KEYWORD, "Keyword"},
+}};
+static_assert(Tokenizer::_valueTypeTags.isDense(),
+        "_valueTypeTags must list every ValueType in the order of declaration");
 
 Tokenizer::Tokenizer(istream &stream) :
 _type(Tokenizer::T_UNDEFINED),
@@ -6,7 +6,8 @@
 #include <cstdlib>
 #include <string>
 #include <vector>
-#include <map>
+
+#include "frozen_map.h"
 
 class TokenizerException : public std::exception {
 private:
@@ -58,10 +59,11 @@ public:
         T_OPENING_CBRACKET, // {
         T_CLOSING_CBRACKET, // }
         T_EOF, // getc == EOF
-        T_KEYWORD // print, return etc 
+        T_KEYWORD, // print, return etc 
+        VALUE_TYPE_COUNT // number of token types, not a token
     };
 
-    static std::map<ValueType, std::string> _valueTypeTags;
+    static const frozen_map<ValueType, const char *, VALUE_TYPE_COUNT> _valueTypeTags;
 
 private:
     LocatableStream _stream;
@@ -301,8 +301,6 @@ public:
     _root(NULL) {
         ARITHMETICS_PARSER_DEBUG;
         
-		NodeFactory::defaultInit();
-		
 		nextToken();
         ParseData result = parseTerm1();
         _value = result.first;
@@ -1,6 +1,46 @@
 #include "SyntaxTree.h"
 
-map<NodeType, INodeCreator*> NodeFactory::_creators;
+namespace {
+
+template<typename T>
+Node *createNode(string token) {
+	return new T(token);
+}
+
+}
+
+constexpr frozen_map<NodeType, NodeFactory::Creator, NODE_TYPE_COUNT>
+NodeFactory::_creators = {{
+	{N_REAL, createNode<RealNode>},
+	{N_INTEGER, createNode<IntegerNode>},
+	{N_POWER, createNode<PowerNode>},
+	{N_MOD, createNode<ModNode>},
+	{N_DIVISION, createNode<DivisionNode>},
+	{N_MULTIPLICATION, createNode<MultiplicationNode>},
+	{N_MINUS, createNode<MinusNode>},
+	{N_PLUS, createNode<PlusNode>},
+	{N_OPENING_RBRACKET, createNode<OpeningRBracketNode>},
+	{N_CLOSING_RBRACKET, createNode<ClosingRBracketNode>},
+	{N_TERM1, createNode<Term1Node>},
+	{N_TERM2, createNode<Term2Node>},
+	{N_TERM3, createNode<Term3Node>},
+	{N_TERM4, createNode<Term4Node>},
+	{N_TERMN, createNode<TermNNode>},
+	{N_T1, createNode<T1Node>},
+	{N_T2, createNode<T2Node>},
+	{N_T3, createNode<T3Node>},
+	{N_T4, createNode<T4Node>},
+	{N_NUMBER, createNode<NumberNode>},
+}};
+
+Node *NodeFactory::create(NodeType type, string token) {
+	static_assert(_creators.isDense(),
+			"_creators must list every NodeType in the order of declaration");
+	if (!_creators.contains(type)) {
+		throw NodeFactoryException(LOG_MSG("Requested node creator not found"));
+	}
+	return _creators[type](token);
+}
 
 string XMLTree(Node *node, int level) {
 	string xml, start, end;
@@ -30,33 +70,6 @@ string XMLTree(Node *node, int level) {
 	
 	return xml;
 }
-bool NodeFactory::_inited = false;
-
-void NodeFactory::defaultInit() {
-	if (NodeFactory::_inited) 
-		return;
-	NodeFactory::registerCreator(N_REAL, new NodeCreator<RealNode>());
-	NodeFactory::registerCreator(N_INTEGER, new NodeCreator<IntegerNode>());
-	NodeFactory::registerCreator(N_POWER, new NodeCreator<PowerNode>());
-	NodeFactory::registerCreator(N_MOD, new NodeCreator<ModNode>());
-	NodeFactory::registerCreator(N_DIVISION, new NodeCreator<DivisionNode>());
-	NodeFactory::registerCreator(N_MULTIPLICATION, new NodeCreator<MultiplicationNode>());
-	NodeFactory::registerCreator(N_MINUS, new NodeCreator<MinusNode>());
-	NodeFactory::registerCreator(N_PLUS, new NodeCreator<PlusNode>());
-	NodeFactory::registerCreator(N_OPENING_RBRACKET, new NodeCreator<OpeningRBracketNode>());
-	NodeFactory::registerCreator(N_CLOSING_RBRACKET, new NodeCreator<ClosingRBracketNode>());
-	NodeFactory::registerCreator(N_TERM1, new NodeCreator<Term1Node>());
-	NodeFactory::registerCreator(N_TERM2, new NodeCreator<Term2Node>());
-	NodeFactory::registerCreator(N_TERM3, new NodeCreator<Term3Node>());
-	NodeFactory::registerCreator(N_TERM4, new NodeCreator<Term4Node>());
-	NodeFactory::registerCreator(N_TERMN, new NodeCreator<TermNNode>());
-	NodeFactory::registerCreator(N_T1, new NodeCreator<T1Node>());
-	NodeFactory::registerCreator(N_T2, new NodeCreator<T2Node>());
-	NodeFactory::registerCreator(N_T3, new NodeCreator<T3Node>());
-	NodeFactory::registerCreator(N_T4, new NodeCreator<T4Node>());
-	NodeFactory::registerCreator(N_NUMBER, new NodeCreator<NumberNode>());
-}
-
 int main2(int argc, char *argv[]) {
 
 
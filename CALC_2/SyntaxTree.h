@@ -4,16 +4,14 @@
 #include <string>
 #include <iostream>
 #include <vector>
-#include <map>
 #include <iterator>
 #include <exception>
-#include "create_map.h"
 #include "Logger.h"
+#include "frozen_map.h"
 
 using std::pair;
 using std::exception;
 using std::iterator;
-using std::map;
 using std::vector;
 using std::string;
 using std::endl;
@@ -28,7 +26,8 @@ enum NodeType {
     N_PLUS, N_OPENING_RBRACKET, N_CLOSING_RBRACKET,
     N_TERM1, N_TERM2, N_TERM3, N_TERM4, N_TERMN,
     // non-terminals
-    N_T1, N_T2, N_T3, N_T4, N_NUMBER
+    N_T1, N_T2, N_T3, N_T4, N_NUMBER,
+    NODE_TYPE_COUNT // number of node types, not a node
 };
 
 class Node {
@@ -81,20 +80,6 @@ public:
 // file is generated with genNodes script
 #include "_Nodes.h"
 
-class INodeCreator {
-public:
-    virtual Node *create(string token) = 0;
-};
-
-template<typename T>
-class NodeCreator : public INodeCreator {
-public:
-
-    Node *create(string token) {
-        return new T(token);
-    }
-};
-
 class NodeFactoryException : exception {
 private:
     string _msg;
@@ -114,29 +99,11 @@ public:
 
 class NodeFactory {
 private:
-    static map<NodeType, INodeCreator*> _creators;
-    static bool _inited;
-public:
-    static void defaultInit();
-
-    static Node *create(NodeType type, string token = "") {
-        map<NodeType, INodeCreator*>::iterator it = _creators.find(type);
-        if (it == _creators.end()) {
-            throw NodeFactoryException(LOG_MSG("Requested NodeCreator not found"));
-        }
-        INodeCreator *creator = it->second;
-        Node *node = creator->create(token);
-        return node;
-    }
+    typedef Node *(*Creator)(string token);
 
-    static void registerCreator(NodeType type, INodeCreator *creator) {
-        // put into the map
-        map<NodeType, INodeCreator*>::iterator it = _creators.find(type);
-        if (it != _creators.end()) {
-            throw NodeFactoryException(LOG_MSG("NodeCreator already exists"));
-        }
-        _creators.insert(pair<NodeType, INodeCreator*>(type, creator));
-    }
+    static const frozen_map<NodeType, Creator, NODE_TYPE_COUNT> _creators;
+public:
+    static Node *create(NodeType type, string token = "");
 };
 
 string XMLTree(Node *node, int level = 0);
@@ -3,7 +3,6 @@
 #include <vector>
 #include <math.h>
 #include "Tokenizer.h"
-#include "create_map.h"
 
 #define DEBUG_LOG_OFF
 #include "Logger.h"
@@ -12,7 +11,6 @@
 using std::istream;
 using std::string;
 using std::exception;
-using std::map;
 using std::vector;
 
 TokenizerException::TokenizerException(string msg) :
@@ -25,57 +23,60 @@ TokenizerException::~TokenizerException() throw () {
 const char *TokenizerException::what() const throw () {
     return _msg.c_str();
 }
-map<Tokenizer::ValueType, string> Tokenizer::_valueTypeTags =
-        create_map<Tokenizer::ValueType, string>
-        (T_UNDEFINED, "Undefined symbol")
-(T_ID, "ID")
-(T_INTEGER, "Integer")
-(T_FLOAT, "Float")
-(T_PLUS, "Plus")
-(T_MINUS, "Minus")
-(T_MULT, "Multiplication")
-(T_DIV, "Division")
-//(T_POWER, "Power")
-(T_MOD, "Mod")
-(T_ASSIGNMENT, "Assignment")
-(T_SEMICOLON, "Semicolon")
-(T_OPENING_RBRACKET, "Opening round bracket")
-(T_CLOSING_RBRACKET, "Closing round bracket")
-//(T_OPENING_CBRACKET, "Opening curly bracket")
-//(T_CLOSING_CBRACKET, "Closing curly bracket")
-(T_EOF, "End Of File")
-(T_TYPE_INT, "Integer type")
-(T_TYPE_FLOAT, "Float type")
-(T_READ, "Read operation")
-(T_PRINT, "Print operation")
-(T_WHILE, "While")
-(T_IF, "If")
-(T_ELSE, "Else")
-(T_LESS, "Less")
-(T_LESS_OR_EQUAL, "Less or equal")
-(T_GREATER, "Greater")
-(T_GREATER_OR_EQUAL, "Greater or equal")
-//(T_SHIFT_LEFT, "Shift left")
-//(T_SHIFT_RIGHT, "Shift right")
-(T_EQUAL, "Equal")
-(T_NOT_EQUAL, "Not equal")
-// (T_OPENING_SBRACKET, "Opening square bracket")
-// (T_CLOSING_SBRACKET, "Closing square bracket")
-(T_AND, "And")
-(T_OR, "Or")
-(T_NOT, "Not")
-(T_FALSE, "False")
-(T_TRUE, "True")
-(T_RETURN, "Return")
-
-(T_DEF, "Define function")
-(T_COLON, "Colon")
-(T_ENDDEF, "Define function end")
-(T_COMMA, "Comma")
-(T_DO, "Do")
-(T_DONE, "Done")
-(T_THEN, "Then")
-(T_FI, "Fi"); //(T_DOT, "Dot");
+constexpr frozen_map<Tokenizer::ValueType, const char *, Tokenizer::VALUE_TYPE_COUNT>
+Tokenizer::_valueTypeTags = {{
+    {T_UNDEFINED, "Undefined symbol"},
+    {T_ID, "ID"},
+    {T_INTEGER, "Integer"},
+    {T_FLOAT, "Float"},
+    {T_PLUS, "Plus"},
+    {T_MINUS, "Minus"},
+    {T_MULT, "Multiplication"},
+    {T_DIV, "Division"},
+    //{T_POWER, "Power"},
+    {T_MOD, "Mod"},
+    {T_ASSIGNMENT, "Assignment"},
+    {T_SEMICOLON, "Semicolon"},
+    {T_OPENING_RBRACKET, "Opening round bracket"},
+    {T_CLOSING_RBRACKET, "Closing round bracket"},
+    //{T_OPENING_CBRACKET, "Opening curly bracket"},
+    //{T_CLOSING_CBRACKET, "Closing curly bracket"},
+    {T_EOF, "End Of File"},
+    {T_TYPE_INT, "Integer type"},
+    {T_TYPE_FLOAT, "Float type"},
+    {T_PRINT, "Print operation"},
+    {T_READ, "Read operation"},
+    {T_WHILE, "While"},
+    {T_IF, "If"},
+    {T_ELSE, "Else"},
+    {T_LESS, "Less"},
+    {T_LESS_OR_EQUAL, "Less or equal"},
+    {T_GREATER, "Greater"},
+    {T_GREATER_OR_EQUAL, "Greater or equal"},
+    //{T_SHIFT_LEFT, "Shift left"},
+    //{T_SHIFT_RIGHT, "Shift right"},
+    {T_EQUAL, "Equal"},
+    {T_NOT_EQUAL, "Not equal"},
+    //{T_OPENING_SBRACKET, "Opening square bracket"},
+    //{T_CLOSING_SBRACKET, "Closing square bracket"},
+    {T_AND, "And"},
+    {T_OR, "Or"},
+    {T_NOT, "Not"},
+    {T_FALSE, "False"},
+    {T_TRUE, "True"},
+    {T_RETURN, "Return"},
+    {T_DEF, "Define function"},
+    {T_COLON, "Colon"},
+    {T_ENDDEF, "Define function end"},
+    {T_COMMA, "Comma"},
+    {T_DO, "Do"},
+    {T_DONE, "Done"},
+    {T_THEN, "Then"},
+    {T_FI, "Fi"},
+    //{T_DOT, "Dot"},
+}};
+static_assert(Tokenizer::_valueTypeTags.isDense(),
+        "_valueTypeTags must list every ValueType in the order of declaration");
 
 Tokenizer::Tokenizer(LocatableStream &stream) :
 _type(Tokenizer::T_UNDEFINED),
@@ -6,7 +6,8 @@
 #include <cstdlib>
 #include <string>
 #include <vector>
-#include <map>
+
+#include "frozen_map.h"
 
 #include "LocatableStream.h"
 
@@ -73,9 +74,10 @@ public:
         T_DONE,
         T_THEN,
         T_FI,
+        VALUE_TYPE_COUNT // number of token types, not a token
     };
 
-    static std::map<ValueType, std::string> _valueTypeTags;
+    static const frozen_map<ValueType, const char *, VALUE_TYPE_COUNT> _valueTypeTags;
 
 private:
     LocatableStream &_stream;
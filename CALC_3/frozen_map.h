@@ -0,0 +1,44 @@
+#ifndef FROZEN_MAP_H
+#define	FROZEN_MAP_H
+
+#include <cstddef>
+
+/**
+ * Constant table for keys of an enum with values 0..N-1. It is an
+ * aggregate, so a constexpr definition is placed in read-only data:
+ * nothing is allocated or run at startup (unlike a std::map filled in
+ * a static initializer), and a lookup is indexing of the array.
+ *
+ * Entries are listed as {key, value} in the order of the keys; check it
+ * with static_assert(table.isDense(), ...) next to the definition.
+ */
+template <typename Key, typename Value, size_t N>
+struct frozen_map {
+
+    struct entry {
+        Key key;
+        Value value;
+    };
+
+    entry _entries[N];
+
+    constexpr size_t size() const {
+        return N;
+    }
+
+    // true if i-th entry and all the following are at their keys' indices
+    constexpr bool isDense(size_t i = 0) const {
+        return i >= N
+                || (static_cast<size_t> (_entries[i].key) == i && isDense(i + 1));
+    }
+
+    constexpr bool contains(Key key) const {
+        return static_cast<size_t> (key) < N;
+    }
+
+    constexpr const Value &operator[](Key key) const {
+        return _entries[key].value;
+    }
+};
+
+#endif	/* FROZEN_MAP_H */
@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <cstring>
+#include "Arena.h"
+
+Arena::Arena(size_t blockSize) :
+_block_size(blockSize),
+_blocks(NULL),
+_pos(NULL),
+_end(NULL),
+_used(0),
+_reserved(0),
+_count(0) {
+}
+
+Arena::~Arena() {
+    release();
+}
+
+/*
+ * Starts a new block. Allocations bigger than a quarter of a block get a
+ * block of their own, and the current block stays in use.
+ */
+void *Arena::allocateSlow(size_t size) {
+    size_t header = (sizeof (Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    bool separate = size > _block_size / 4;
+    size_t blockSize = header + (separate ? size : _block_size);
+
+    Block *block = static_cast<Block *> (malloc(blockSize));
+    if (block == NULL) {
+        throw std::bad_alloc();
+    }
+    block->size = blockSize;
+    block->next = _blocks;
+    _blocks = block;
+    _reserved += blockSize;
+
+    char *memory = reinterpret_cast<char *> (block) + header;
+    if (!separate) {
+        _pos = memory + size;
+        _end = memory + _block_size;
+    }
+    return memory;
+}
+
+StringRef Arena::copy(StringRef str) {
+    char *data = static_cast<char *> (allocate(str.length()));
+    memcpy(data, str.data(), str.length());
+    return StringRef(data, str.length());
+}
+
+void Arena::release() {
+    while (_blocks != NULL) {
+        Block *next = _blocks->next;
+        free(_blocks);
+        _blocks = next;
+    }
+    _pos = NULL;
+    _end = NULL;
+    _used = 0;
+    _reserved = 0;
+    _count = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef ARENA_H
+#define	ARENA_H
+
+#include <cstddef>
+#include <new>
+
+#include "StringRef.h"
+
+/**
+ * Bump allocator: memory is taken from big blocks and is released all at
+ * once when the Arena is destroyed (or on release()). Destructors of the
+ * objects placed here are not called, so they must not own anything
+ * outside the arena.
+ */
+class Arena {
+private:
+    struct Block {
+        Block *next;
+        size_t size;
+    };
+
+    size_t _block_size;
+    Block *_blocks;
+    char *_pos;
+    char *_end;
+    // bytes handed out, bytes taken from the heap, number of allocations
+    size_t _used;
+    size_t _reserved;
+    size_t _count;
+
+    void *allocateSlow(size_t size);
+
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+public:
+    const static size_t BLOCK_SIZE = 64 * 1024;
+    const static size_t ALIGNMENT = sizeof (void *);
+
+    explicit Arena(size_t blockSize = BLOCK_SIZE);
+    ~Arena();
+
+    void *allocate(size_t size) {
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        _used += size;
+        _count++;
+        if (size <= (size_t) (_end - _pos)) {
+            void *memory = _pos;
+            _pos += size;
+            return memory;
+        }
+        return allocateSlow(size);
+    }
+
+    template <class T>
+    T *allocateArray(size_t count) {
+        return static_cast<T *> (allocate(count * sizeof (T)));
+    }
+
+    // copy of the characters owned by the arena
+    StringRef copy(StringRef str);
+
+    // frees all the memory; nothing allocated before may be used
+    void release();
+
+    size_t getBytesUsed() const {
+        return _used;
+    }
+
+    size_t getBytesReserved() const {
+        return _reserved;
+    }
+
+    size_t getAllocationCount() const {
+        return _count;
+    }
+};
+
+#endif	/* ARENA_H */
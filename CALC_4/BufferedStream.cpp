@@ -1,6 +1,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <cerrno>
 #include <cstring>
@@ -10,79 +11,210 @@ using std::string;
 using std::exception;
 
 
-BufferedStream::BufferedStream(std::string filename) :
+BufferedStream::BufferedStream(std::string filename,
+		size_t bufferSize, size_t lookbehind) :
+	_data(NULL),
+	_capacity(0),
+	_buffer_size(bufferSize),
+	_lookbehind(lookbehind),
 	_spos(0),
 	_epos(0),
-	_unget(false),
-	_eof(false) {
+	_offset(0),
+	_mark(0),
+	_marked(false),
+	_eof(false),
+	_mapped(false) {
 		_fd = open(filename.c_str(), O_LARGEFILE | O_NOCTTY);
 		if (_fd == -1) {
 			throw BufferedStreamException(LOG_MSG(strerror(errno)));
 		}
-		_data = new char[BUF_SIZE];
-		if (_data == NULL) {
-			throw BufferedStreamException(LOG_MSG(strerror(errno)));
+		if (!map()) {
+			allocate();
 		}
 	}
 
-BufferedStream::BufferedStream(int fd) :
+BufferedStream::BufferedStream(int fd, size_t bufferSize, size_t lookbehind) :
 	_fd(fd),
+	_data(NULL),
+	_capacity(0),
+	_buffer_size(bufferSize),
+	_lookbehind(lookbehind),
 	_spos(0),
 	_epos(0),
-	_unget(false),
-	_eof(false) {
-		_data = new char[BUF_SIZE];
-		if (_data == NULL) {
-			throw BufferedStreamException(LOG_MSG(strerror(errno)));
-		}
+	_offset(0),
+	_mark(0),
+	_marked(false),
+	_eof(false),
+	_mapped(false) {
+		allocate();
 	}
 
 BufferedStream::~BufferedStream() {
+	if (_mapped) {
+		munmap(_data, _epos);
+	} else {
+		delete[] _data;
+	}
 	close(_fd);
-	delete[] _data;
 }
 
-int BufferedStream::get() {
-	// Still have something in the buffer?
-	if (_spos != _epos) {
-		_unget = true;
-		return _data[_spos++];
+bool BufferedStream::map() {
+	struct stat st;
+	if (fstat(_fd, &st) == -1) {
+		throw BufferedStreamException(LOG_MSG(strerror(errno)));
 	}
-	// Reading from fd to the buffer
-	int bytesRead = read(_fd, _data, BUF_SIZE);
+	// empty files can't be mapped, special files may change under us
+	if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	_data = static_cast<char *>(data);
+	_epos = st.st_size;
+	_mapped = true;
+	return true;
+}
+
+void BufferedStream::allocate() {
+	_capacity = _buffer_size + _lookbehind;
+	_data = new char[_capacity];
+}
+
+bool BufferedStream::fill() {
+	// Mapped file has nothing more to read
+	if (_mapped) {
+		return false;
+	}
+	// Keeping the lookbehind before the current symbol or the mark,
+	// whichever is earlier, so that it is there after reset() too
+	size_t start = _spos;
+	if (_marked && _mark - _offset < start) {
+		start = _mark - _offset;
+	}
+	size_t keep = (start > _lookbehind) ? start - _lookbehind : 0;
+	if (keep > 0) {
+		memmove(_data, _data + keep, _epos - keep);
+		_offset += keep;
+		_spos -= keep;
+		_epos -= keep;
+	}
+	// Growing if everything has to be kept
+	if (_capacity - _epos < _buffer_size) {
+		size_t capacity = _epos + _buffer_size;
+		if (capacity < 2 * _capacity) {
+			capacity = 2 * _capacity;
+		}
+		char *data = new char[capacity];
+		memcpy(data, _data, _epos);
+		delete[] _data;
+		_data = data;
+		_capacity = capacity;
+	}
+	// Reading from fd to the window
+	ssize_t bytesRead = read(_fd, _data + _epos, _capacity - _epos);
 	if (bytesRead == -1) { // error
-		_unget = false;
 		throw BufferedStreamException(LOG_MSG(strerror(errno)));
 	} else if (bytesRead == 0) { // EOF
-		_unget = true;
+		return false;
+	}
+	_lines.append(_data + _epos, bytesRead);
+	_epos += bytesRead;
+	return true;
+}
+
+int BufferedStream::get() {
+	if (_spos == _epos && !fill()) {
 		_eof = true;
 		return 0;
-	} else {
-		_unget = true;
-		_epos = bytesRead;
-		_spos = 0;
-		return _data[_spos++];
 	}
+	_eof = false;
+	return _data[_spos++];
 }
 
 void BufferedStream::unget() {
-	if (_unget == true) {
-		_unget = false;
-		_spos--;
-	} else {
+	unget(1);
+}
+
+void BufferedStream::unget(size_t count) {
+	// EOF is not a symbol from the buffer, nothing to push back
+	if (_eof && count > 0) {
+		_eof = false;
+		count--;
+	}
+	if (count > _spos) {
 		throw BufferedStreamUnderflowException(
 				LOG_MSG("BufferedStream unget underflow"));
 	}
+	_spos -= count;
 }
 
 int BufferedStream::peek() {
-	int symbol = get();
-	if (symbol != 0)
-		unget();
-	return symbol;
+	return peek(0);
+}
+
+int BufferedStream::peek(size_t n) {
+	while (_epos - _spos <= n) {
+		if (!fill()) {
+			return 0;
+		}
+	}
+	return _data[_spos + n];
+}
+
+void BufferedStream::mark() {
+	_mark = getOffset();
+	_marked = true;
+}
+
+void BufferedStream::reset() {
+	if (!_marked) {
+		throw BufferedStreamException(LOG_MSG("BufferedStream reset without mark"));
+	}
+	_spos = _mark - _offset;
+	_eof = false;
+}
+
+void BufferedStream::clearMark() {
+	_marked = false;
 }
 
 bool BufferedStream::eof() {
 	return _eof;
 }
 
+size_t BufferedStream::getOffset() const {
+	return _offset + _spos;
+}
+
+bool BufferedStream::isMapped() const {
+	return _mapped;
+}
+
+const char *BufferedStream::getData() const {
+	return _mapped ? _data : NULL;
+}
+
+size_t BufferedStream::getSize() const {
+	return _mapped ? _epos : _offset + _epos;
+}
+
+int BufferedStream::getLineNumber(size_t offset) const {
+	return getLines().getLineNumber(offset);
+}
+
+int BufferedStream::getLinePosition(size_t offset) const {
+	return getLines().getLinePosition(offset);
+}
+
+const LineIndex &BufferedStream::getLines() const {
+	// mapped file is indexed at once when needed
+	if (_mapped) {
+		_lines.update(_data, _epos);
+	}
+	return _lines;
+}
@@ -3,6 +3,9 @@
 
 #include <exception>
 #include <string>
+#include <cstddef>
+
+#include "LineIndex.h"
 
 class BufferedStreamException : public std::exception {
 private:
@@ -31,31 +34,86 @@ public:
 
 };
 
+/**
+ * Regular files are mapped into memory as a whole, so the complete source
+ * is one contiguous byte range (see getData()/getSize()).
+ * Everything else (pipes, terminals, stdin) is read through a sliding
+ * window: refill keeps everything from the mark and at least lookbehind
+ * symbols before the current one (or the mark), so unget(n) and reset()
+ * work across refills; the window grows if peek(n) or the mark needs more.
+ * Lines are indexed as blocks are read, or on the first query if mapped.
+ */
 class BufferedStream {
 private:
     // file descriptor
     int _fd;
-    // buffer
+    // window or the whole mapped file
     char *_data;
+    // size of _data if not mapped
+    size_t _capacity;
+    // bytes read at once
+    size_t _buffer_size;
+    // symbols kept before the current one on refill
+    size_t _lookbehind;
     // start position of data in buffer
-    int _spos;
+    size_t _spos;
     // end position of data in buffer
-    int _epos;
-    // true if can unget
-    bool _unget;
+    size_t _epos;
+    // offset of _data[0] from the beginning of the input
+    size_t _offset;
+    // offset of the mark
+    size_t _mark;
+    bool _marked;
+    // last get() hit the end of input
     bool _eof;
+    // true if _data is mmap'ed file
+    bool _mapped;
+    mutable LineIndex _lines;
+
+    bool map();
+    void allocate();
+    // reads more input to the end of the window; false at EOF
+    bool fill();
 public:
     const static int BUF_SIZE = 4096;
+    const static int LOOKBEHIND = 64;
 
-    BufferedStream(std::string filename);
-    BufferedStream(int fd);
-    ~BufferedStream();
+    BufferedStream(std::string filename,
+            size_t bufferSize = BUF_SIZE, size_t lookbehind = LOOKBEHIND);
+    BufferedStream(int fd,
+            size_t bufferSize = BUF_SIZE, size_t lookbehind = LOOKBEHIND);
+    virtual ~BufferedStream();
 
+    // returns 0 and sets eof() at the end of input
     virtual int get();
+    // unget() right after EOF only clears eof()
     virtual void unget();
+    // symbol to be read next or 0 at EOF; doesn't move
     virtual int peek();
     virtual bool eof();
+
+    // pushes back count symbols; at least lookbehind ones are always kept
+    void unget(size_t count);
+    // n-th symbol after the current one (peek(0) == peek())
+    int peek(size_t n);
+    // reset() returns to the marked symbol until the mark is cleared
+    void mark();
+    void reset();
+    void clearMark();
+
+    // offset of the next symbol from the beginning of the input
+    size_t getOffset() const;
+
+    bool isMapped() const;
+    // whole input; valid only if isMapped()
+    const char *getData() const;
+    size_t getSize() const;
+
+    // line and position of the symbol at offset (e.g. start of a token)
+    int getLineNumber(size_t offset) const;
+    int getLinePosition(size_t offset) const;
+    // lines of the input read so far
+    const LineIndex &getLines() const;
 };
 
 #endif	/* BUFFEREDSTREAM_H */
-
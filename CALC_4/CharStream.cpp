@@ -0,0 +1,34 @@
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "CharStream.h"
+#include "BufferedStream.h"
+#include "Logger.h"
+
+FdSource::FdSource(int fd) :
+_fd(fd),
+_data(new char[BUF_SIZE]),
+_spos(0),
+_epos(0),
+_offset(0),
+_eof(false) {
+}
+
+FdSource::~FdSource() {
+    delete[] _data;
+}
+
+int FdSource::fill() {
+    ssize_t bytesRead = read(_fd, _data, BUF_SIZE);
+    if (bytesRead == -1) {
+        throw BufferedStreamException(LOG_MSG(strerror(errno)));
+    } else if (bytesRead == 0) {
+        _eof = true;
+        return 0;
+    }
+    _offset += _epos;
+    _epos = bytesRead;
+    _spos = 0;
+    _lines.append(_data, bytesRead);
+    return _data[_spos++];
+}
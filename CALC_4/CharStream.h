@@ -0,0 +1,214 @@
+#ifndef CHARSTREAM_H
+#define	CHARSTREAM_H
+
+#include <cstddef>
+
+#include "LineIndex.h"
+
+/*
+ * Statically dispatched character streams: CharStream<Source> takes bytes
+ * from the Source policy. Everything on the per-symbol path is inline, so
+ * a tokenizer instantiated with a CharStream has no indirect calls per
+ * symbol (unlike BufferedStream/LocatableStream with virtual get/unget).
+ * Nothing is counted per symbol either: locations are byte offsets which
+ * the Source resolves to line and position with its LineIndex.
+ *
+ * Behaviour is the same as of LocatableStream: get() returns 0 and sets
+ * eof() at the end of input, one symbol can be pushed back with unget(),
+ * peek() returns the next symbol, a NUL byte included, without taking it.
+ */
+
+/**
+ * Contiguous input (e.g. mapped file); the bytes are not owned.
+ * Lines are indexed on the first query.
+ */
+class MemorySource {
+private:
+    const char *_data;
+    size_t _size;
+    size_t _pos;
+    bool _eof;
+    mutable LineIndex _lines;
+public:
+
+    MemorySource(const char *data, size_t size) :
+    _data(data),
+    _size(size),
+    _pos(0),
+    _eof(false) {
+    }
+
+    int get() {
+        if (_pos < _size) {
+            return _data[_pos++];
+        }
+        _eof = true;
+        return 0;
+    }
+
+    void unget() {
+        // EOF is not a symbol from the input, nothing to push back
+        if (!_eof) {
+            _pos--;
+        }
+    }
+
+    bool eof() const {
+        return _eof;
+    }
+
+    size_t getOffset() const {
+        return _pos;
+    }
+
+    bool isMapped() const {
+        return true;
+    }
+
+    const char *getData() const {
+        return _data;
+    }
+
+    size_t getSize() const {
+        return _size;
+    }
+
+    const LineIndex &getLines() const {
+        _lines.update(_data, _size);
+        return _lines;
+    }
+};
+
+/**
+ * File descriptor (pipe, terminal, stdin) read through BUF_SIZE buffer.
+ * Lines are indexed as blocks are read. The descriptor is not closed.
+ */
+class FdSource {
+private:
+    int _fd;
+    char *_data;
+    size_t _spos;
+    size_t _epos;
+    // offset of _data[0] from the beginning of the input
+    size_t _offset;
+    bool _eof;
+    LineIndex _lines;
+
+    // reads the next block; returns its first symbol or 0 at EOF
+    int fill();
+
+    FdSource(const FdSource &);
+    FdSource &operator=(const FdSource &);
+public:
+    const static int BUF_SIZE = 4096;
+
+    FdSource(int fd);
+    ~FdSource();
+
+    int get() {
+        if (_spos != _epos) {
+            return _data[_spos++];
+        }
+        return fill();
+    }
+
+    void unget() {
+        if (!_eof) {
+            _spos--;
+        }
+    }
+
+    bool eof() const {
+        return _eof;
+    }
+
+    size_t getOffset() const {
+        return _offset + _spos;
+    }
+
+    bool isMapped() const {
+        return false;
+    }
+
+    const char *getData() const {
+        return NULL;
+    }
+
+    size_t getSize() const {
+        return _offset + _epos;
+    }
+
+    const LineIndex &getLines() const {
+        return _lines;
+    }
+};
+
+template <class Source>
+class CharStream {
+private:
+    Source _source;
+public:
+
+    template <class Arg>
+    explicit CharStream(Arg arg) : _source(arg) {
+    }
+
+    template <class Arg1, class Arg2>
+    CharStream(Arg1 arg1, Arg2 arg2) : _source(arg1, arg2) {
+    }
+
+    int get() {
+        return _source.get();
+    }
+
+    void unget() {
+        _source.unget();
+    }
+
+    // the next symbol is not taken; at the end of input it is 0 and
+    // eof() tells it from a NUL byte, as in BufferedStream::peek()
+    int peek() {
+        int symbol = get();
+        unget();
+        return symbol;
+    }
+
+    bool eof() const {
+        return _source.eof();
+    }
+
+    size_t getOffset() const {
+        return _source.getOffset();
+    }
+
+    bool isMapped() const {
+        return _source.isMapped();
+    }
+
+    const char *getData() const {
+        return _source.getData();
+    }
+
+    size_t getSize() const {
+        return _source.getSize();
+    }
+
+    // line and position of the symbol at offset (e.g. start of a token)
+    int getLineNumber(size_t offset) const {
+        return _source.getLines().getLineNumber(offset);
+    }
+
+    int getLinePosition(size_t offset) const {
+        return _source.getLines().getLinePosition(offset);
+    }
+
+    // lines of the input read so far
+    const LineIndex &getLines() const {
+        return _source.getLines();
+    }
+};
+
+typedef CharStream<MemorySource> MemoryCharStream;
+typedef CharStream<FdSource> FdCharStream;
+
+#endif	/* CHARSTREAM_H */
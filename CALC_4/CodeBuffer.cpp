@@ -0,0 +1,102 @@
+#include <unistd.h>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include "CodeBuffer.h"
+#include "BufferedStream.h"
+#include "Logger.h"
+
+CodeBuffer::CodeBuffer(int fd) :
+_size(0),
+_fd(fd) {
+}
+
+std::string &CodeBuffer::tail() {
+    if (_blocks.empty() || _blocks.back().length() >= BLOCK_SIZE) {
+        _blocks.push_back(std::string());
+    }
+    return _blocks.back();
+}
+
+void CodeBuffer::append(const char *data, size_t length) {
+    tail().append(data, length);
+    _size += length;
+    if (_fd != -1 && _size >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void CodeBuffer::format(const char *fmt, ...) {
+    // most of the lines fit; longer ones are formatted twice
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int length = vsnprintf(line, sizeof (line), fmt, ap);
+    va_end(ap);
+
+    if (length < (int) sizeof (line)) {
+        append(line, length);
+    } else {
+        std::string text(length + 1, '\0');
+        va_start(ap, fmt);
+        vsnprintf(&text[0], text.length(), fmt, ap);
+        va_end(ap);
+        append(text.data(), length);
+    }
+}
+
+void CodeBuffer::splice(CodeBuffer &other) {
+    for (size_t i = 0; i < other._blocks.size(); ++i) {
+        std::string &block = other._blocks[i];
+        if (block.length() < SPLICE_COPY_SIZE) {
+            tail().append(block);
+        } else {
+            _blocks.push_back(std::string());
+            _blocks.back().swap(block);
+        }
+    }
+    _size += other._size;
+    other._blocks.clear();
+    other._size = 0;
+
+    if (_fd != -1 && _size >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void CodeBuffer::flush() {
+    if (_fd == -1) {
+        return;
+    }
+    for (size_t i = 0; i < _blocks.size(); ++i) {
+        const char *data = _blocks[i].data();
+        size_t length = _blocks[i].length();
+        while (length != 0) {
+            ssize_t written = write(_fd, data, length);
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw BufferedStreamException(LOG_MSG(strerror(errno)));
+            }
+            data += written;
+            length -= written;
+        }
+    }
+    // the first block keeps its memory for the following code
+    _blocks.resize(_blocks.empty() ? 0 : 1);
+    if (!_blocks.empty()) {
+        _blocks[0].clear();
+    }
+    _size = 0;
+}
+
+std::string CodeBuffer::str() const {
+    std::string text;
+    text.reserve(_size);
+    for (size_t i = 0; i < _blocks.size(); ++i) {
+        text += _blocks[i];
+    }
+    return text;
+}
@@ -0,0 +1,58 @@
+#ifndef CODEBUFFER_H
+#define	CODEBUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only buffer for the generated code. Text is kept in blocks, so
+ * code generated out of order (e.g. loop body before the condition) goes
+ * to a separate CodeBuffer and is moved to the end of another one with
+ * splice() without copying the text again.
+ *
+ * With a file descriptor the buffer is written out whenever it holds
+ * FLUSH_SIZE bytes and on flush(); the descriptor is not closed.
+ */
+class CodeBuffer {
+private:
+    std::vector<std::string> _blocks;
+    size_t _size;
+    int _fd;
+
+    std::string &tail();
+
+    CodeBuffer(const CodeBuffer &);
+    CodeBuffer &operator=(const CodeBuffer &);
+public:
+    const static size_t BLOCK_SIZE = 64 * 1024;
+    const static size_t FLUSH_SIZE = 64 * 1024;
+    // smaller blocks are copied on splice() to keep the block count low
+    const static size_t SPLICE_COPY_SIZE = 256;
+
+    explicit CodeBuffer(int fd = -1);
+
+    void append(const char *data, size_t length);
+
+    void append(const std::string &str) {
+        append(str.data(), str.length());
+    }
+
+    // printf into the buffer
+    void format(const char *fmt, ...) __attribute__ ((format(printf, 2, 3)));
+
+    // moves the content of other to the end; other becomes empty
+    void splice(CodeBuffer &other);
+
+    // bytes in the buffer (not written yet)
+    size_t size() const {
+        return _size;
+    }
+
+    // writes the content to the file descriptor and empties the buffer
+    void flush();
+
+    std::string str() const;
+};
+
+#endif	/* CODEBUFFER_H */
@@ -0,0 +1,75 @@
+#ifndef COMPILATION_H
+#define	COMPILATION_H
+
+#include <string>
+
+#include "Parser.h"
+#include "CodeBuffer.h"
+
+/**
+ * One compilation session: the tokens and the syntax tree (kept by the
+ * Parser) and the Program generated from them, i.e. the function tables
+ * and the marker counter. Sessions share no state, so any number of them
+ * may run at the same time, each on its own thread.
+ */
+class Compilation {
+private:
+    Parser _parser;
+    Program _program;
+    bool _register_allocation;
+
+    Compilation(const Compilation &);
+    Compilation &operator=(const Compilation &);
+public:
+
+    template <class Stream>
+    explicit Compilation(BasicTokenizer<Stream> *tokenizer,
+            int maxNesting = Parser::DEFAULT_MAX_NESTING) :
+    _parser(tokenizer, maxNesting),
+    _register_allocation(false) {
+    }
+
+    // tokens must outlive the compilation
+    explicit Compilation(const TokenBuffer *tokens,
+            int maxNesting = Parser::DEFAULT_MAX_NESTING) :
+    _parser(tokens, maxNesting),
+    _register_allocation(false) {
+    }
+
+    Parser &getParser() {
+        return _parser;
+    }
+
+    Program &getProgram() {
+        return _program;
+    }
+
+    // with true the bodies are generated through the IR and the register
+    // allocator instead of the stack machine
+    void setRegisterAllocation(bool allocate) {
+        _register_allocation = allocate;
+    }
+
+    // the program is generated anew on every call, after the constants
+    // are folded (again: folding a folded tree changes nothing); with
+    // jobs > 0 the functions are generated on that many threads and
+    // numbered markers of their own (see generateProgramParallel())
+    void generate(CodeBuffer &code, int jobs = 0) {
+        foldConstants(_parser.getRoot(), _parser.getArena());
+        _program.clear();
+        _program.setRegisterAllocation(_register_allocation);
+        if (jobs > 0) {
+            generateProgramParallel(NodePtr(_parser.getRoot()), _program, code, jobs);
+        } else {
+            generateProgram(NodePtr(_parser.getRoot()), _program, code);
+        }
+    }
+
+    std::string generate(int jobs = 0) {
+        CodeBuffer code;
+        generate(code, jobs);
+        return code.str();
+    }
+};
+
+#endif	/* COMPILATION_H */
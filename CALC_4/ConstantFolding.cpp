@@ -0,0 +1,249 @@
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <vector>
+
+#include "Parser.h"
+
+namespace {
+
+// value of an integer literal; false for anything else
+bool getInteger(const Node *node, int &value) {
+    return node->getKind() == NODE_INTEGER && parseInteger(node->getTagRef(), value);
+}
+
+// value of true, false or a condition made of one of them
+bool getBoolean(const Node *node, bool &value) {
+    switch (node->getKind()) {
+        case NODE_TRUE:
+        case NODE_FALSE:
+            value = node->getKind() == NODE_TRUE;
+            return true;
+        case NODE_BATOM:
+        case NODE_BDISJ:
+        case NODE_BEXPRESSION:
+            return node->childrenCount() == 1 && getBoolean(node->get(0), value);
+        default:
+            return false;
+    }
+}
+
+bool compare(NodeKind kind, int a, int b) {
+    switch (kind) {
+        case NODE_CMP_LESS:
+            return a < b;
+        case NODE_CMP_GREATER:
+            return a > b;
+        case NODE_CMP_LESS_OR_EQUAL:
+            return a <= b;
+        case NODE_CMP_GREATER_OR_EQUAL:
+            return a >= b;
+        case NODE_CMP_EQUAL:
+            return a == b;
+        default:
+            return a != b;
+    }
+}
+
+bool isCmp(NodeKind kind) {
+    return kind >= NODE_CMP_LESS && kind <= NODE_CMP_NOT_EQUAL;
+}
+
+/*
+ * Replaces the subtrees made only of literals with their values, from the
+ * leaves up. Variables and calls are never dropped, so the generators find
+ * the same errors in the same order. Values are the ones the code would
+ * compute: 32 bits with wraparound, division truncated toward zero;
+ * division by zero and INT_MIN / -1 are left to trap at run time.
+ */
+class ConstantFolder {
+private:
+    Arena &_arena;
+
+    Node *newInteger(int value) {
+        char buffer[16];
+        int length = snprintf(buffer, sizeof (buffer), "%d", value);
+        return new (_arena) IntegerNode(_arena.copy(StringRef(buffer, length)));
+    }
+
+    Node *newBoolean(bool value) {
+        if (value) {
+            return new (_arena) TrueNode();
+        }
+        return new (_arena) FalseNode();
+    }
+
+    // a batom or a bdisj of the value
+    Node *newCondition(NodeKind kind, bool value) {
+        Node *batom = new (_arena) BAtomNode();
+        batom->addChild(newBoolean(value), _arena);
+        if (kind == NODE_BATOM) {
+            return batom;
+        }
+        Node *bdisj = new (_arena) BdisjNode();
+        bdisj->addChild(batom, _arena);
+        return bdisj;
+    }
+
+    Node *foldBinaryChain(Node *node);
+    Node *foldNegation(Node *node);
+    Node *foldBinary(Node *node);
+    void foldAtom(Node *batom);
+    void foldChain(Node *node, bool conjunction);
+
+public:
+
+    explicit ConstantFolder(Arena &arena) : _arena(arena) {
+    }
+
+    // the node or the one to put in its place
+    Node *fold(Node *node);
+};
+
+Node *ConstantFolder::fold(Node *node) {
+    if (node->getKind() == NODE_BINARY) {
+        return foldBinaryChain(node);
+    }
+    for (int i = 0; i < node->childrenCount(); ++i) {
+        node->set(i, fold(node->get(i)));
+    }
+    switch (node->getKind()) {
+        case NODE_NEGATION:
+            return foldNegation(node);
+        case NODE_BATOM:
+            foldAtom(node);
+            break;
+        case NODE_BDISJ:
+            foldChain(node, true);
+            break;
+        case NODE_BEXPRESSION:
+            foldChain(node, false);
+            break;
+        default:
+            break;
+    }
+    return node;
+}
+
+// each node of the spine is folded in place once its operands are
+Node *ConstantFolder::foldBinaryChain(Node *node) {
+    std::vector<NodePtr> spine;
+    Node *folded = fold(collectSpine(NodePtr(node), spine).getNode());
+    for (size_t k = spine.size(); k-- > 0;) {
+        Node *binary = spine[k].getNode();
+        binary->set(0, folded);
+        binary->set(1, fold(binary->get(1)));
+        folded = foldBinary(binary);
+    }
+    return folded;
+}
+
+Node *ConstantFolder::foldNegation(Node *node) {
+    int a;
+    if (!getInteger(node->get(0), a)) {
+        return node;
+    }
+    return newInteger((int) (0u - (unsigned) a));
+}
+
+Node *ConstantFolder::foldBinary(Node *node) {
+    int a, b;
+    if (!getInteger(node->get(0), a) || !getInteger(node->get(1), b)) {
+        return node;
+    }
+    const BinaryOperator *op = findBinaryOperator(node->getTagRef());
+    assert(op != NULL);
+    if (op->isDivision() && (b == 0 || (a == INT_MIN && b == -1))) {
+        return node;
+    }
+    switch (op->token) {
+        case Tokenizer::T_PLUS:
+            return newInteger((int) ((unsigned) a + (unsigned) b));
+        case Tokenizer::T_MINUS:
+            return newInteger((int) ((unsigned) a - (unsigned) b));
+        case Tokenizer::T_MULT:
+            return newInteger((int) ((unsigned) a * (unsigned) b));
+        case Tokenizer::T_DIV:
+            return newInteger(a / b);
+        case Tokenizer::T_MOD:
+            return newInteger(a % b);
+        default:
+            return node;
+    }
+}
+
+// a comparison of literals, not of a constant or a constant in brackets
+void ConstantFolder::foldAtom(Node *batom) {
+    Node *atom = batom->get(0);
+    NodeKind kind = atom->getKind();
+    bool value;
+    if (isCmp(kind)) {
+        int a, b;
+        if (getInteger(atom->get(0), a) && getInteger(atom->get(1), b)) {
+            batom->set(0, newBoolean(compare(kind, a, b)));
+        }
+    } else if (kind == NODE_NOT) {
+        if (getBoolean(atom->get(0), value)) {
+            batom->set(0, newBoolean(!value));
+        }
+    } else if (kind == NODE_BEXPRESSION) {
+        if (getBoolean(atom, value)) {
+            batom->set(0, newBoolean(value));
+        }
+    }
+}
+
+/*
+ * A chain of "and"s (a bdisj of batoms) or of "or"s (a bexpression of
+ * bdisjs). As the generators compute them, "and" is true if its operands
+ * are equal and "or" if either is true; both are associative and
+ * commutative on 0 and 1, so the constants are combined into one at the
+ * end of the chain, and dropped if that one does not change the value
+ * (true for "and", false for "or"). The other operands keep their order.
+ */
+void ConstantFolder::foldChain(Node *node, bool conjunction) {
+    std::vector<Node *> operands;
+    std::vector<Node *> rests;
+    bool constant = false;
+    bool value = false;
+    for (int i = 0; i < node->childrenCount(); ++i) {
+        Node *operand = i == 0 ? node->get(0) : node->get(i)->get(0);
+        if (i > 0) {
+            rests.push_back(node->get(i));
+        }
+        bool operandValue;
+        if (!getBoolean(operand, operandValue)) {
+            operands.push_back(operand);
+        } else if (!constant) {
+            constant = true;
+            value = operandValue;
+        } else {
+            value = conjunction ? value == operandValue : value || operandValue;
+        }
+    }
+    if (!constant || node->childrenCount() == 1) {
+        return;
+    }
+    if (operands.empty() || value != conjunction) {
+        operands.push_back(newCondition(node->get(0)->getKind(), value));
+    }
+
+    // the rest nodes are reused for the operands after the first
+    node->clear();
+    node->addChild(operands[0], _arena);
+    for (size_t k = 1; k < operands.size(); ++k) {
+        Node *rest = rests[k - 1];
+        rest->clear();
+        rest->addChild(operands[k], _arena);
+        node->addChild(rest, _arena);
+    }
+}
+
+}
+
+void foldConstants(Node *root, Arena &arena) {
+    ConstantFolder folder(arena);
+    Node *folded = folder.fold(root);
+    assert(folded == root);
+    (void) folded;
+}
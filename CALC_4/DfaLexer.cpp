@@ -0,0 +1,231 @@
+#include "DfaLexer.h"
+#include "SimdScan.h"
+
+unsigned char DfaLexer::_classes[256];
+unsigned char DfaLexer::_scanners[DfaLexer::STATE_COUNT];
+unsigned char DfaLexer::_transitions[DfaLexer::STATE_COUNT][DfaLexer::CLASS_COUNT];
+Tokenizer::ValueType DfaLexer::_accepts[DfaLexer::STATE_COUNT];
+bool DfaLexer::_initialized = DfaLexer::initTables();
+
+bool DfaLexer::initTables() {
+    for (int c = 0; c < 256; ++c) {
+        _classes[c] = C_OTHER;
+    }
+    _classes[(unsigned char) ' '] = C_SPACE;
+    _classes[(unsigned char) '\t'] = C_SPACE;
+    _classes[(unsigned char) '\v'] = C_SPACE;
+    _classes[(unsigned char) '\f'] = C_SPACE;
+    _classes[(unsigned char) '\r'] = C_SPACE;
+    _classes[(unsigned char) '\n'] = C_NEWLINE;
+    for (int c = '0'; c <= '9'; ++c) {
+        _classes[c] = C_DIGIT;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        _classes[c] = C_LETTER;
+    }
+    for (int c = 'A'; c <= 'Z'; ++c) {
+        _classes[c] = C_LETTER;
+    }
+    _classes[(unsigned char) '_'] = C_LETTER;
+    _classes[(unsigned char) '+'] = C_PLUS;
+    _classes[(unsigned char) '-'] = C_MINUS;
+    _classes[(unsigned char) '*'] = C_STAR;
+    _classes[(unsigned char) '/'] = C_SLASH;
+    _classes[(unsigned char) '%'] = C_PERCENT;
+    _classes[(unsigned char) '='] = C_ASSIGN;
+    _classes[(unsigned char) '<'] = C_LESS;
+    _classes[(unsigned char) '>'] = C_GREATER;
+    _classes[(unsigned char) '!'] = C_BANG;
+    _classes[(unsigned char) '#'] = C_HASH;
+    _classes[(unsigned char) ';'] = C_SEMICOLON;
+    _classes[(unsigned char) ':'] = C_COLON;
+    _classes[(unsigned char) ','] = C_COMMA;
+    _classes[(unsigned char) '('] = C_OPENING_RBRACKET;
+    _classes[(unsigned char) ')'] = C_CLOSING_RBRACKET;
+    _classes[(unsigned char) '{'] = C_OPENING_CBRACKET;
+    _classes[(unsigned char) '}'] = C_CLOSING_CBRACKET;
+    _classes[(unsigned char) '['] = C_OPENING_SBRACKET;
+    _classes[(unsigned char) ']'] = C_CLOSING_SBRACKET;
+
+    // by default every state finishes the token
+    for (int s = 0; s < STATE_COUNT; ++s) {
+        for (int c = 0; c < CLASS_COUNT; ++c) {
+            _transitions[s][c] = S_STOP;
+        }
+        _accepts[s] = Tokenizer::T_UNDEFINED;
+        _scanners[s] = SCAN_NONE;
+    }
+
+    unsigned char *start = _transitions[S_START];
+    start[C_OTHER] = S_UNDEFINED;
+    start[C_SPACE] = S_START;
+    start[C_NEWLINE] = S_START;
+    start[C_DIGIT] = S_INTEGER;
+    start[C_LETTER] = S_ID;
+    start[C_PLUS] = S_PLUS;
+    start[C_MINUS] = S_MINUS;
+    start[C_STAR] = S_MULT;
+    start[C_SLASH] = S_DIV;
+    start[C_PERCENT] = S_MOD;
+    start[C_ASSIGN] = S_ASSIGNMENT;
+    start[C_LESS] = S_LESS;
+    start[C_GREATER] = S_GREATER;
+    start[C_BANG] = S_NOT;
+    start[C_HASH] = S_LINE_COMMENT;
+    start[C_SEMICOLON] = S_SEMICOLON;
+    start[C_COLON] = S_COLON;
+    start[C_COMMA] = S_COMMA;
+    start[C_OPENING_RBRACKET] = S_OPENING_RBRACKET;
+    start[C_CLOSING_RBRACKET] = S_CLOSING_RBRACKET;
+    start[C_OPENING_CBRACKET] = S_OPENING_CBRACKET;
+    start[C_CLOSING_CBRACKET] = S_CLOSING_CBRACKET;
+    start[C_OPENING_SBRACKET] = S_OPENING_SBRACKET;
+    start[C_CLOSING_SBRACKET] = S_CLOSING_SBRACKET;
+
+    _transitions[S_ID][C_LETTER] = S_ID;
+    _transitions[S_ID][C_DIGIT] = S_ID;
+    _transitions[S_INTEGER][C_DIGIT] = S_INTEGER;
+
+    _transitions[S_ASSIGNMENT][C_ASSIGN] = S_EQUAL;
+    _transitions[S_LESS][C_ASSIGN] = S_LESS_OR_EQUAL;
+    _transitions[S_GREATER][C_ASSIGN] = S_GREATER_OR_EQUAL;
+    _transitions[S_NOT][C_ASSIGN] = S_NOT_EQUAL;
+
+    _transitions[S_DIV][C_SLASH] = S_LINE_COMMENT;
+    _transitions[S_DIV][C_STAR] = S_BLOCK_COMMENT;
+
+    // comments last till the end of line or */ (or EOF)
+    for (int c = 0; c < C_EOF; ++c) {
+        _transitions[S_LINE_COMMENT][c] = S_LINE_COMMENT;
+        _transitions[S_BLOCK_COMMENT][c] = S_BLOCK_COMMENT;
+        _transitions[S_BLOCK_COMMENT_STAR][c] = S_BLOCK_COMMENT;
+    }
+    _transitions[S_LINE_COMMENT][C_NEWLINE] = S_START;
+    _transitions[S_BLOCK_COMMENT][C_STAR] = S_BLOCK_COMMENT_STAR;
+    _transitions[S_BLOCK_COMMENT_STAR][C_STAR] = S_BLOCK_COMMENT_STAR;
+    _transitions[S_BLOCK_COMMENT_STAR][C_SLASH] = S_START;
+
+    // S_START is entered after whitespace; the scanners stop right before
+    // the symbol which leaves the state
+    _scanners[S_START] = SCAN_WHITESPACE;
+    _scanners[S_LINE_COMMENT] = SCAN_LINE_COMMENT;
+    _scanners[S_BLOCK_COMMENT] = SCAN_BLOCK_COMMENT;
+
+    // only EOF stops in these states
+    _accepts[S_START] = Tokenizer::T_EOF;
+    _accepts[S_LINE_COMMENT] = Tokenizer::T_EOF;
+    _accepts[S_BLOCK_COMMENT] = Tokenizer::T_EOF;
+    _accepts[S_BLOCK_COMMENT_STAR] = Tokenizer::T_EOF;
+
+    _accepts[S_ID] = Tokenizer::T_ID;
+    _accepts[S_INTEGER] = Tokenizer::T_INTEGER;
+    _accepts[S_PLUS] = Tokenizer::T_PLUS;
+    _accepts[S_MINUS] = Tokenizer::T_MINUS;
+    _accepts[S_MULT] = Tokenizer::T_MULT;
+    _accepts[S_MOD] = Tokenizer::T_MOD;
+    _accepts[S_SEMICOLON] = Tokenizer::T_SEMICOLON;
+    _accepts[S_COLON] = Tokenizer::T_COLON;
+    _accepts[S_COMMA] = Tokenizer::T_COMMA;
+    _accepts[S_OPENING_RBRACKET] = Tokenizer::T_OPENING_RBRACKET;
+    _accepts[S_CLOSING_RBRACKET] = Tokenizer::T_CLOSING_RBRACKET;
+    _accepts[S_OPENING_CBRACKET] = Tokenizer::T_OPENING_CBRACKET;
+    _accepts[S_CLOSING_CBRACKET] = Tokenizer::T_CLOSING_CBRACKET;
+    _accepts[S_OPENING_SBRACKET] = Tokenizer::T_OPENING_SBRACKET;
+    _accepts[S_CLOSING_SBRACKET] = Tokenizer::T_CLOSING_SBRACKET;
+    _accepts[S_ASSIGNMENT] = Tokenizer::T_ASSIGNMENT;
+    _accepts[S_EQUAL] = Tokenizer::T_EQUAL;
+    _accepts[S_LESS] = Tokenizer::T_LESS;
+    _accepts[S_LESS_OR_EQUAL] = Tokenizer::T_LESS_OR_EQUAL;
+    _accepts[S_GREATER] = Tokenizer::T_GREATER;
+    _accepts[S_GREATER_OR_EQUAL] = Tokenizer::T_GREATER_OR_EQUAL;
+    _accepts[S_NOT] = Tokenizer::T_NOT;
+    _accepts[S_NOT_EQUAL] = Tokenizer::T_NOT_EQUAL;
+    _accepts[S_DIV] = Tokenizer::T_DIV;
+    _accepts[S_UNDEFINED] = Tokenizer::T_UNDEFINED;
+
+    return true;
+}
+
+DfaLexer::DfaLexer(const char *data, size_t size) :
+_data(data),
+_size(size),
+_pos(0),
+_type(Tokenizer::T_UNDEFINED),
+_tag_offset(0),
+_tag_length(0) {
+}
+
+Tokenizer::ValueType DfaLexer::nextToken() {
+    int state = S_START;
+    size_t pos = _pos;
+    size_t start = pos;
+
+    while (true) {
+        int symbolClass = (pos < _size)
+                ? _classes[(unsigned char) _data[pos]]
+                : (int) C_EOF;
+        int next = _transitions[state][symbolClass];
+        if (next == S_STOP) {
+            break;
+        }
+        if (next == S_START) {
+            // whitespace or the end of comment
+            start = pos + 1;
+        }
+        state = next;
+        pos++;
+
+        switch (_scanners[state]) {
+            case SCAN_WHITESPACE:
+                pos = SimdScan::skipWhitespace(_data, pos, _size);
+                start = pos;
+                break;
+            case SCAN_LINE_COMMENT:
+                pos = SimdScan::findNewline(_data, pos, _size);
+                break;
+            case SCAN_BLOCK_COMMENT:
+                pos = SimdScan::findCommentEnd(_data, pos, _size);
+                break;
+        }
+    }
+
+    _pos = pos;
+    _type = _accepts[state];
+    if (_type == Tokenizer::T_EOF) {
+        start = pos;
+    }
+    _tag_offset = start;
+    _tag_length = pos - start;
+
+    if (_type == Tokenizer::T_ID) {
+        _type = Tokenizer::lookupKeyword(getTagRef());
+    }
+
+    return _type;
+}
+
+Tokenizer::ValueType DfaLexer::getToken() const {
+    return _type;
+}
+
+size_t DfaLexer::getTagOffset() const {
+    return _tag_offset;
+}
+
+size_t DfaLexer::getTagLength() const {
+    return _tag_length;
+}
+
+StringRef DfaLexer::getTagRef() const {
+    return StringRef(_data + _tag_offset, _tag_length);
+}
+
+int DfaLexer::getLineNumber() const {
+    _lines.update(_data, _size);
+    return _lines.getLineNumber(_tag_offset);
+}
+
+int DfaLexer::getLinePosition() const {
+    _lines.update(_data, _size);
+    return _lines.getLinePosition(_tag_offset);
+}
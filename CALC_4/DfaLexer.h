@@ -0,0 +1,129 @@
+#ifndef DFALEXER_H
+#define	DFALEXER_H
+
+#include <cstddef>
+
+#include "Tokenizer.h"
+#include "StringRef.h"
+#include "LineIndex.h"
+
+/**
+ * Table driven lexer over the contiguous input (e.g. mapped file).
+ * Produces the same stream of tokens as Tokenizer::nextToken() but every
+ * symbol costs a character class lookup and a transition lookup.
+ *
+ * Token is finished when the transition leads to S_STOP; its type is
+ * taken from the accepting table for the current state. Whitespace and
+ * comments lead back to S_START, which moves the start of the token.
+ * Once in whitespace or comment state the lexer jumps over the whole run
+ * with SimdScan instead of going symbol by symbol. Lines are not counted
+ * while lexing; getLineNumber()/getLinePosition() use the line index.
+ */
+class DfaLexer {
+public:
+
+    enum CharClass {
+        C_OTHER,
+        C_SPACE,
+        C_NEWLINE,
+        C_DIGIT,
+        C_LETTER, // letters and underscore
+        C_PLUS,
+        C_MINUS,
+        C_STAR,
+        C_SLASH,
+        C_PERCENT,
+        C_ASSIGN, // =
+        C_LESS,
+        C_GREATER,
+        C_BANG,
+        C_HASH,
+        C_SEMICOLON,
+        C_COLON,
+        C_COMMA,
+        C_OPENING_RBRACKET,
+        C_CLOSING_RBRACKET,
+        C_OPENING_CBRACKET,
+        C_CLOSING_CBRACKET,
+        C_OPENING_SBRACKET,
+        C_CLOSING_SBRACKET,
+        C_EOF,
+        CLASS_COUNT
+    };
+
+    enum State {
+        S_START,
+        S_ID,
+        S_INTEGER,
+        S_PLUS,
+        S_MINUS,
+        S_MULT,
+        S_MOD,
+        S_SEMICOLON,
+        S_COLON,
+        S_COMMA,
+        S_OPENING_RBRACKET,
+        S_CLOSING_RBRACKET,
+        S_OPENING_CBRACKET,
+        S_CLOSING_CBRACKET,
+        S_OPENING_SBRACKET,
+        S_CLOSING_SBRACKET,
+        S_ASSIGNMENT,
+        S_EQUAL,
+        S_LESS,
+        S_LESS_OR_EQUAL,
+        S_GREATER,
+        S_GREATER_OR_EQUAL,
+        S_NOT,
+        S_NOT_EQUAL,
+        S_DIV, // '/' which may start a comment
+        S_LINE_COMMENT,
+        S_BLOCK_COMMENT,
+        S_BLOCK_COMMENT_STAR,
+        S_UNDEFINED,
+        STATE_COUNT,
+        S_STOP = STATE_COUNT
+    };
+
+    enum Scanner {
+        SCAN_NONE,
+        SCAN_WHITESPACE,
+        SCAN_LINE_COMMENT,
+        SCAN_BLOCK_COMMENT
+    };
+
+private:
+    static unsigned char _classes[256];
+    static unsigned char _scanners[STATE_COUNT];
+    static unsigned char _transitions[STATE_COUNT][CLASS_COUNT];
+    static Tokenizer::ValueType _accepts[STATE_COUNT];
+    static bool _initialized;
+
+    static bool initTables();
+
+    const char *_data;
+    size_t _size;
+    size_t _pos;
+
+    Tokenizer::ValueType _type;
+    size_t _tag_offset;
+    size_t _tag_length;
+
+    // indexed on the first query
+    mutable LineIndex _lines;
+
+public:
+    DfaLexer(const char *data, size_t size);
+
+    Tokenizer::ValueType nextToken();
+    Tokenizer::ValueType getToken() const;
+
+    size_t getTagOffset() const;
+    size_t getTagLength() const;
+    StringRef getTagRef() const;
+
+    int getLineNumber() const;
+    int getLinePosition() const;
+};
+
+#endif	/* DFALEXER_H */
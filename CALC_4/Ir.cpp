@@ -0,0 +1,361 @@
+#include <cassert>
+#include <cstdio>
+
+#include "Ir.h"
+#include "RegisterAllocator.h"
+
+IrCond negateCond(IrCond cond) {
+    switch (cond) {
+        case IR_LESS:
+            return IR_GREATER_OR_EQUAL;
+        case IR_GREATER:
+            return IR_LESS_OR_EQUAL;
+        case IR_LESS_OR_EQUAL:
+            return IR_GREATER;
+        case IR_GREATER_OR_EQUAL:
+            return IR_LESS;
+        case IR_EQUAL:
+            return IR_NOT_EQUAL;
+        default:
+            return IR_EQUAL;
+    }
+}
+
+namespace {
+
+// suffix of jcc and setcc after cmpl b, a
+const char *getCondSuffix(IrCond cond) {
+    static const char *suffixes[] = {"l", "g", "le", "ge", "e", "ne"};
+    return suffixes[cond];
+}
+
+const char *getArithmetic(IrOp op) {
+    switch (op) {
+        case IR_ADD:
+            return "addl";
+        case IR_SUB:
+            return "subl";
+        default:
+            return "imull";
+    }
+}
+
+/*
+ * The assembly of one instruction at a time. %eax and %edx are free for
+ * the code of an instruction: values are moved through %eax when both
+ * operands would be in memory or the result cannot be made in place.
+ */
+class Emitter {
+private:
+    typedef RegisterAllocator::Location Location;
+
+    const IrFunction &_function;
+    const RegisterAllocator &_allocator;
+    CodeBuffer &_code;
+    // texts of the operands of the current instruction
+    char _texts[3][32];
+
+    const Location &getLocation(const IrOperand &operand) const {
+        assert(operand.isReg());
+        return _allocator.getLocation(operand.value);
+    }
+
+    bool inRegister(const IrOperand &operand) const {
+        return operand.isReg() && getLocation(operand).kind == Location::REGISTER;
+    }
+
+    bool inMemory(const IrOperand &operand) const {
+        return operand.isReg() && getLocation(operand).kind == Location::FRAME;
+    }
+
+    bool isSame(const IrOperand &x, const IrOperand &y) const {
+        if (x.isImm() || y.isImm()) {
+            return x.isImm() && y.isImm() && x.value == y.value;
+        }
+        const Location &lx = getLocation(x);
+        const Location &ly = getLocation(y);
+        return lx.kind == ly.kind && lx.value == ly.value;
+    }
+
+    const char *text(const IrOperand &operand, int slot) {
+        char *buffer = _texts[slot];
+        if (operand.isImm()) {
+            snprintf(buffer, sizeof (_texts[slot]), "$%d", operand.value);
+            return buffer;
+        }
+        const Location &location = getLocation(operand);
+        assert(location.kind != Location::NONE);
+        if (location.kind == Location::REGISTER) {
+            return RegisterAllocator::getRegisterName(
+                    (RegisterAllocator::Register) location.value);
+        }
+        snprintf(buffer, sizeof (_texts[slot]), "%d(%%ebp)", location.value);
+        return buffer;
+    }
+
+    void move(const IrOperand &dst, const IrOperand &a) {
+        if (isSame(dst, a)) {
+            return;
+        }
+        if (inMemory(dst) && inMemory(a)) {
+            _code.format("    movl %s, %%eax\n", text(a, 1));
+            store("%eax", dst);
+        } else {
+            _code.format("    movl %s, %s\n", text(a, 1), text(dst, 0));
+        }
+    }
+
+    void store(const char *reg, const IrOperand &dst) {
+        _code.format("    movl %s, %s\n", reg, text(dst, 0));
+    }
+
+    void arithmetic(const IrInstruction &instruction) {
+        const char *name = getArithmetic(instruction.op);
+        const IrOperand &dst = instruction.dst;
+        const IrOperand &a = instruction.a;
+        const IrOperand &b = instruction.b;
+        if (inRegister(dst) && !isSame(dst, b)) {
+            move(dst, a);
+            _code.format("    %s %s, %s\n", name, text(b, 2), text(dst, 0));
+        } else if (inRegister(dst) && instruction.op != IR_SUB) {
+            // commutative, the result goes over b
+            _code.format("    %s %s, %s\n", name, text(a, 1), text(dst, 0));
+        } else if (inMemory(dst) && isSame(dst, a) && !inMemory(b)
+                && instruction.op != IR_MUL) {
+            _code.format("    %s %s, %s\n", name, text(b, 2), text(dst, 0));
+        } else {
+            _code.format(
+                    "    movl %s, %%eax\n"
+                    "    %s %s, %%eax\n",
+                    text(a, 1), name, text(b, 2));
+            store("%eax", dst);
+        }
+    }
+
+    void negation(const IrInstruction &instruction) {
+        const IrOperand &dst = instruction.dst;
+        if (inRegister(dst) || isSame(dst, instruction.a)) {
+            move(dst, instruction.a);
+            _code.format("    negl %s\n", text(dst, 0));
+        } else {
+            _code.format(
+                    "    movl %s, %%eax\n"
+                    "    negl %%eax\n",
+                    text(instruction.a, 1));
+            store("%eax", dst);
+        }
+    }
+
+    void division(const IrInstruction &instruction) {
+        assert(instruction.b.isReg());
+        _code.format(
+                "    movl %s, %%eax\n"
+                "    cltd\n"
+                "    idivl %s\n",
+                text(instruction.a, 1), text(instruction.b, 2));
+        store(instruction.op == IR_DIV ? "%eax" : "%edx", instruction.dst);
+    }
+
+    // flags of a - b
+    void compare(const IrInstruction &instruction) {
+        const IrOperand &a = instruction.a;
+        const IrOperand &b = instruction.b;
+        if (a.isImm() || (inMemory(a) && inMemory(b))) {
+            _code.format(
+                    "    movl %s, %%eax\n"
+                    "    cmpl %s, %%eax\n",
+                    text(a, 1), text(b, 2));
+        } else {
+            _code.format("    cmpl %s, %s\n", text(b, 2), text(a, 1));
+        }
+    }
+
+    void set(const IrInstruction &instruction) {
+        compare(instruction);
+        _code.format("    set%s %%al\n", getCondSuffix(instruction.cond));
+        if (inRegister(instruction.dst)) {
+            _code.format("    movzbl %%al, %s\n", text(instruction.dst, 0));
+        } else {
+            _code.format("    movzbl %%al, %%eax\n");
+            store("%eax", instruction.dst);
+        }
+    }
+
+    void read(const IrInstruction &instruction) {
+        const IrOperand &dst = instruction.dst;
+        int scratch = _allocator.getScratchOffset();
+        if (inMemory(dst)) {
+            _code.format("    leal %s, %%eax\n", text(dst, 0));
+        } else {
+            // scanf needs an address; the value is kept if nothing is read
+            _code.format(
+                    "    movl %s, %d(%%ebp)\n"
+                    "    leal %d(%%ebp), %%eax\n",
+                    text(dst, 0), scratch, scratch);
+        }
+        _code.format(
+                "    pushl %%eax\n"
+                "    pushl $.READFORMAT\n"
+                "    call scanf\n"
+                "    addl $8, %%esp\n");
+        if (!inMemory(dst)) {
+            _code.format("    movl %d(%%ebp), %s\n", scratch, text(dst, 0));
+        }
+    }
+
+    // true if label follows p, maybe after other labels
+    bool isNext(size_t p, int label) const {
+        const std::vector<IrInstruction> &code = _function.getCode();
+        for (size_t next = p + 1; next < code.size() && code[next].op == IR_LABEL; ++next) {
+            if (code[next].label == label) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void prologue();
+    void epilogue();
+    void instruction(size_t p);
+
+public:
+
+    Emitter(const IrFunction &function, const RegisterAllocator &allocator,
+            CodeBuffer &code) :
+    _function(function),
+    _allocator(allocator),
+    _code(code) {
+    }
+
+    void emit() {
+        prologue();
+        for (size_t p = 0; p < _function.getCode().size(); ++p) {
+            instruction(p);
+        }
+        epilogue();
+    }
+};
+
+void Emitter::prologue() {
+    StringRef name = _function.getName();
+    _code.format(
+            ".globl %.*s\n"
+            "%.*s:\n"
+            "    pushl %%ebp\n"
+            "    movl %%esp, %%ebp\n"
+            "    subl $%d, %%esp\n",
+            (int) name.length(), name.data(),
+            (int) name.length(), name.data(),
+            _allocator.getFrameSize());
+
+    for (int reg = RegisterAllocator::EBX; reg <= RegisterAllocator::EDI; ++reg) {
+        RegisterAllocator::Register r = (RegisterAllocator::Register) reg;
+        if (_allocator.isSaved(r)) {
+            _code.format("    movl %s, %d(%%ebp)\n",
+                    RegisterAllocator::getRegisterName(r), _allocator.getSaveOffset(r));
+        }
+    }
+
+    for (int reg = 0; reg < _function.getRegisterCount(); ++reg) {
+        if (!_function.isVariable(reg) || getLocation(IrOperand::reg(reg)).kind == Location::NONE) {
+            continue;
+        }
+        IrOperand variable = IrOperand::reg(reg);
+        StringRef id = _function.getVariableName(reg);
+        _code.format("# %.*s in %s\n", (int) id.length(), id.data(), text(variable, 0));
+        if (_function.isParameter(reg) && inRegister(variable)) {
+            _code.format("    movl %d(%%ebp), %s\n",
+                    _function.getParameterOffset(reg), text(variable, 0));
+        }
+    }
+}
+
+void Emitter::epilogue() {
+    _code.format(
+            "# epilogue\n"
+            "%s:\n",
+            _function.getEndMarker().c_str());
+    for (int reg = RegisterAllocator::EBX; reg <= RegisterAllocator::EDI; ++reg) {
+        RegisterAllocator::Register r = (RegisterAllocator::Register) reg;
+        if (_allocator.isSaved(r)) {
+            _code.format("    movl %d(%%ebp), %s\n",
+                    _allocator.getSaveOffset(r), RegisterAllocator::getRegisterName(r));
+        }
+    }
+    _code.format(
+            "    movl %%ebp, %%esp\n"
+            "    popl %%ebp\n"
+            "    ret\n");
+}
+
+void Emitter::instruction(size_t p) {
+    const IrInstruction &instruction = _function.getCode()[p];
+    switch (instruction.op) {
+        case IR_MOV:
+            move(instruction.dst, instruction.a);
+            break;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+            arithmetic(instruction);
+            break;
+        case IR_DIV:
+        case IR_MOD:
+            division(instruction);
+            break;
+        case IR_NEG:
+            negation(instruction);
+            break;
+        case IR_SET:
+            set(instruction);
+            break;
+        case IR_BRANCH:
+            compare(instruction);
+            _code.format("    j%s %s\n", getCondSuffix(instruction.cond),
+                    _function.getMarker(instruction.label).c_str());
+            break;
+        case IR_JMP:
+            if (!isNext(p, instruction.label)) {
+                _code.format("    jmp %s\n", _function.getMarker(instruction.label).c_str());
+            }
+            break;
+        case IR_LABEL:
+            _code.format("%s:\n", _function.getMarker(instruction.label).c_str());
+            break;
+        case IR_ARG:
+            _code.format("    pushl %s\n", text(instruction.a, 1));
+            break;
+        case IR_CALL:
+            _code.format("    call %.*s\n",
+                    (int) instruction.name.length(), instruction.name.data());
+            if (instruction.label > 0) {
+                _code.format("    addl $%d, %%esp\n", 4 * instruction.label);
+            }
+            store("%eax", instruction.dst);
+            break;
+        case IR_PRINT:
+            _code.format(
+                    "    pushl %s\n"
+                    "    pushl $.PRINTFORMAT\n"
+                    "    call printf\n"
+                    "    addl $8, %%esp\n",
+                    text(instruction.a, 1));
+            break;
+        case IR_READ:
+            read(instruction);
+            break;
+        case IR_RET:
+            _code.format("    movl %s, %%eax\n", text(instruction.a, 1));
+            if (p + 1 < _function.getCode().size()) {
+                _code.format("    jmp %s\n", _function.getEndMarker().c_str());
+            }
+            break;
+    }
+}
+
+}
+
+void emitFunction(const IrFunction &function, const RegisterAllocator &allocator,
+        CodeBuffer &code) {
+    Emitter(function, allocator, code).emit();
+}
@@ -0,0 +1,179 @@
+#ifndef IR_H
+#define	IR_H
+
+#include <string>
+#include <vector>
+
+#include "StringRef.h"
+#include "CodeBuffer.h"
+
+/*
+ * Three-address code of one function for the register allocator. Values
+ * are virtual registers: a register per variable and one per temporary
+ * of an expression. Jumps go to labels numbered in the function.
+ */
+enum IrOp {
+    IR_MOV,     // dst = a
+    IR_ADD,     // dst = a + b
+    IR_SUB,     // dst = a - b
+    IR_MUL,     // dst = a * b
+    IR_DIV,     // dst = a / b, b is a register
+    IR_MOD,     // dst = a % b, b is a register
+    IR_NEG,     // dst = -a
+    IR_SET,     // dst = a cond b ? 1 : 0
+    IR_BRANCH,  // if a cond b goto label
+    IR_JMP,     // goto label
+    IR_LABEL,   // label:
+    IR_ARG,     // pushes a as an argument of the next call, the last one first
+    IR_CALL,    // dst = name(count arguments)
+    IR_PRINT,   // print a
+    IR_READ,    // read dst; it keeps its value if nothing is read
+    IR_RET      // return a
+};
+
+enum IrCond {
+    IR_LESS,
+    IR_GREATER,
+    IR_LESS_OR_EQUAL,
+    IR_GREATER_OR_EQUAL,
+    IR_EQUAL,
+    IR_NOT_EQUAL
+};
+
+// the condition that is true when cond is false
+IrCond negateCond(IrCond cond);
+
+struct IrOperand {
+    enum Kind {
+        NONE,
+        REG,
+        IMM
+    };
+
+    Kind kind;
+    // number of the virtual register or the immediate value
+    int value;
+
+    static IrOperand none() {
+        IrOperand operand = {NONE, 0};
+        return operand;
+    }
+
+    static IrOperand reg(int reg) {
+        IrOperand operand = {REG, reg};
+        return operand;
+    }
+
+    static IrOperand imm(int value) {
+        IrOperand operand = {IMM, value};
+        return operand;
+    }
+
+    bool isReg() const {
+        return kind == REG;
+    }
+
+    bool isImm() const {
+        return kind == IMM;
+    }
+};
+
+struct IrInstruction {
+    IrOp op;
+    IrCond cond;
+    IrOperand dst;
+    IrOperand a;
+    IrOperand b;
+    // IR_LABEL, IR_JMP, IR_BRANCH: the label; IR_CALL: number of arguments
+    int label;
+    // IR_CALL: the function
+    StringRef name;
+};
+
+class IrFunction {
+private:
+    StringRef _name;
+    std::vector<IrInstruction> _code;
+    // of the labels
+    std::vector<std::string> _markers;
+    std::string _endMarker;
+
+    // for every virtual register: the variable's name or empty for
+    // a temporary, and the offset of a parameter from %ebp or 0
+    std::vector<StringRef> _names;
+    std::vector<int> _parameter_offsets;
+public:
+
+    IrFunction(StringRef name, const std::string &endMarker) :
+    _name(name),
+    _endMarker(endMarker) {
+    }
+
+    int addVariable(StringRef name, int parameterOffset = 0) {
+        _names.push_back(name);
+        _parameter_offsets.push_back(parameterOffset);
+        return _names.size() - 1;
+    }
+
+    int addTemporary() {
+        return addVariable(StringRef());
+    }
+
+    int addLabel(const std::string &marker) {
+        _markers.push_back(marker);
+        return _markers.size() - 1;
+    }
+
+    template <class Iterator>
+    void append(Iterator begin, Iterator end) {
+        _code.insert(_code.end(), begin, end);
+    }
+
+    StringRef getName() const {
+        return _name;
+    }
+
+    const std::vector<IrInstruction> &getCode() const {
+        return _code;
+    }
+
+    const std::string &getMarker(int label) const {
+        return _markers[label];
+    }
+
+    int getLabelCount() const {
+        return _markers.size();
+    }
+
+    const std::string &getEndMarker() const {
+        return _endMarker;
+    }
+
+    int getRegisterCount() const {
+        return _names.size();
+    }
+
+    bool isVariable(int reg) const {
+        return !_names[reg].empty();
+    }
+
+    StringRef getVariableName(int reg) const {
+        return _names[reg];
+    }
+
+    bool isParameter(int reg) const {
+        return _parameter_offsets[reg] != 0;
+    }
+
+    int getParameterOffset(int reg) const {
+        return _parameter_offsets[reg];
+    }
+};
+
+class RegisterAllocator;
+
+// assembly of the function with the registers of allocator
+void emitFunction(const IrFunction &function, const RegisterAllocator &allocator,
+        CodeBuffer &code);
+
+#endif	/* IR_H */
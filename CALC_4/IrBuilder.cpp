@@ -0,0 +1,407 @@
+#include <list>
+
+#include "Parser.h"
+#include "Ir.h"
+#include "RegisterAllocator.h"
+
+namespace {
+
+/*
+ * Lowers the body of a function definition to an IrFunction. The tree is
+ * walked in the order of the stack machine generators (the branches of an
+ * if before its condition, the operands of a call from the last one), so
+ * the same errors are found first; the parts are put in their places with
+ * list splices as CodeBuffer::splice() does for the assembly.
+ */
+template <class Ref>
+class IrBuilder {
+private:
+    typedef std::list<IrInstruction> Code;
+
+    Function *_context;
+    IrFunction &_function;
+    // virtual registers of the variables in scope
+    SymbolMap<int> _variables;
+
+    static IrInstruction instruction(IrOp op) {
+        IrInstruction instruction = IrInstruction();
+        instruction.op = op;
+        instruction.dst = IrOperand::none();
+        instruction.a = IrOperand::none();
+        instruction.b = IrOperand::none();
+        return instruction;
+    }
+
+    int newLabel() {
+        return _function.addLabel(_context->getNextMarker());
+    }
+
+    void label(Code &code, int label) {
+        IrInstruction i = instruction(IR_LABEL);
+        i.label = label;
+        code.push_back(i);
+    }
+
+    void jump(Code &code, int label) {
+        IrInstruction i = instruction(IR_JMP);
+        i.label = label;
+        code.push_back(i);
+    }
+
+    void branch(Code &code, IrCond cond, IrOperand a, IrOperand b, int label) {
+        IrInstruction i = instruction(IR_BRANCH);
+        i.cond = cond;
+        i.a = a;
+        i.b = b;
+        i.label = label;
+        code.push_back(i);
+    }
+
+    IrOperand add(Code &code, IrOp op, int dst, IrOperand a,
+            IrOperand b = IrOperand::none(), IrCond cond = IR_EQUAL) {
+        IrInstruction i = instruction(op);
+        i.dst = IrOperand::reg(dst);
+        i.a = a;
+        i.b = b;
+        i.cond = cond;
+        code.push_back(i);
+        return i.dst;
+    }
+
+    // register of the variable; the error of the stack machine if it is
+    // not declared
+    int getVariable(Ref id) {
+        ASSERT_KIND(NODE_ID, id);
+        _context->getVariableOffset(id.getSymbol(), id.getTagRef());
+        return _variables[id.getSymbol()];
+    }
+
+    int target(int dst) {
+        return dst != -1 ? dst : _function.addTemporary();
+    }
+
+    static IrCond getCond(NodeKind kind) {
+        switch (kind) {
+            case NODE_CMP_LESS:
+                return IR_LESS;
+            case NODE_CMP_GREATER:
+                return IR_GREATER;
+            case NODE_CMP_LESS_OR_EQUAL:
+                return IR_LESS_OR_EQUAL;
+            case NODE_CMP_GREATER_OR_EQUAL:
+                return IR_GREATER_OR_EQUAL;
+            case NODE_CMP_EQUAL:
+                return IR_EQUAL;
+            default:
+                return IR_NOT_EQUAL;
+        }
+    }
+
+    static bool isCmp(NodeKind kind) {
+        return kind >= NODE_CMP_LESS && kind <= NODE_CMP_NOT_EQUAL;
+    }
+
+    static IrOp getOp(const BinaryOperator *op) {
+        switch (op->token) {
+            case Tokenizer::T_PLUS:
+                return IR_ADD;
+            case Tokenizer::T_MINUS:
+                return IR_SUB;
+            case Tokenizer::T_MULT:
+                return IR_MUL;
+            case Tokenizer::T_DIV:
+                return IR_DIV;
+            default:
+                return IR_MOD;
+        }
+    }
+
+    void lowerStatement(Ref node, Code &code);
+    // the value of the expression, put to dst if it is not -1
+    IrOperand lowerExpression(Ref node, Code &code, int dst = -1);
+    IrOperand lowerChain(Ref node, Code &code, int dst);
+    // jumps to label if the bexpression is whenTrue
+    void lowerBranch(Ref bexpression, bool whenTrue, int label, Code &code);
+    void lowerAtomBranch(Ref batom, bool whenTrue, int label, Code &code);
+    // 1 or 0
+    IrOperand lowerBexpression(Ref node, Code &code);
+    IrOperand lowerAtom(Ref batom, Code &code);
+
+public:
+
+    IrBuilder(Function *context, IrFunction &function) :
+    _context(context),
+    _function(function) {
+    }
+
+    void lower(Ref funcdef) {
+        ASSERT_KIND(NODE_FUNCARGS, funcdef.get(2));
+        for (int i = 0; i < funcdef.get(2).childrenCount(); ++i) {
+            Ref id = funcdef.get(2).get(i).get(1);
+            int offset = _context->getVariableOffset(id.getSymbol(), id.getTagRef());
+            _variables[id.getSymbol()] = _function.addVariable(id.getTagRef(), offset);
+        }
+
+        Code code;
+        lowerStatement(funcdef.get(3), code);
+        _function.append(code.begin(), code.end());
+    }
+};
+
+template <class Ref>
+void IrBuilder<Ref>::lowerStatement(Ref node, Code &code) {
+    switch (node.getKind()) {
+        case NODE_STATEMENTS:
+            for (int i = 0; i < node.childrenCount(); ++i) {
+                lowerStatement(node.get(i), code);
+            }
+            break;
+        case NODE_DECLARATION: {
+            Ref id = node.get(1);
+            _context->addLocalVariable(id.getSymbol(), id.getTagRef());
+            _variables[id.getSymbol()] = _function.addVariable(id.getTagRef());
+            break;
+        }
+        case NODE_ASSIGNMENT: {
+            int variable = getVariable(node.get(0));
+            lowerExpression(node.get(1), code, variable);
+            break;
+        }
+        case NODE_READ: {
+            IrInstruction i = instruction(IR_READ);
+            i.dst = IrOperand::reg(getVariable(node.get(0)));
+            code.push_back(i);
+            break;
+        }
+        case NODE_PRINT: {
+            IrInstruction i = instruction(IR_PRINT);
+            i.a = lowerExpression(node.get(0), code);
+            code.push_back(i);
+            break;
+        }
+        case NODE_RETURN: {
+            IrInstruction i = instruction(IR_RET);
+            i.a = lowerExpression(node.get(0), code);
+            code.push_back(i);
+            break;
+        }
+        case NODE_IF: {
+            Code thenCode;
+            Code elseCode;
+            lowerStatement(node.get(1), thenCode);
+            if (node.childrenCount() == 3) {
+                lowerStatement(node.get(2), elseCode);
+            }
+            int elseLabel = newLabel();
+            lowerBranch(node.get(0), false, elseLabel, code);
+            code.splice(code.end(), thenCode);
+            if (node.childrenCount() == 3) {
+                int endLabel = newLabel();
+                jump(code, endLabel);
+                label(code, elseLabel);
+                code.splice(code.end(), elseCode);
+                label(code, endLabel);
+            } else {
+                label(code, elseLabel);
+            }
+            break;
+        }
+        case NODE_FOR: {
+            int startLabel = newLabel();
+            int condLabel = newLabel();
+            lowerStatement(node.get(0), code);
+            Code stepCode;
+            Code condCode;
+            lowerStatement(node.get(2), stepCode);
+            lowerBranch(node.get(1), true, startLabel, condCode);
+            jump(code, condLabel);
+            label(code, startLabel);
+            lowerStatement(node.get(3), code);
+            code.splice(code.end(), stepCode);
+            label(code, condLabel);
+            code.splice(code.end(), condCode);
+            break;
+        }
+        case NODE_WHILE: {
+            int startLabel = newLabel();
+            int condLabel = newLabel();
+            Code condCode;
+            lowerBranch(node.get(0), true, startLabel, condCode);
+            jump(code, condLabel);
+            label(code, startLabel);
+            lowerStatement(node.get(1), code);
+            label(code, condLabel);
+            code.splice(code.end(), condCode);
+            break;
+        }
+        default:
+            assert(!"not a statement");
+            break;
+    }
+}
+
+template <class Ref>
+IrOperand IrBuilder<Ref>::lowerExpression(Ref node, Code &code, int dst) {
+    switch (node.getKind()) {
+        case NODE_ID: {
+            IrOperand variable = IrOperand::reg(getVariable(node));
+            return dst != -1 ? add(code, IR_MOV, dst, variable) : variable;
+        }
+        case NODE_INTEGER: {
+            int value;
+            if (!parseInteger(node.getTagRef(), value)) {
+                throw ParserException(fmt("Bad integer %s", node.getTag().c_str()));
+            }
+            IrOperand integer = IrOperand::imm(value);
+            return dst != -1 ? add(code, IR_MOV, dst, integer) : integer;
+        }
+        case NODE_NEGATION: {
+            IrOperand a = lowerExpression(node.get(0), code);
+            return add(code, IR_NEG, target(dst), a);
+        }
+        case NODE_BINARY:
+            return lowerChain(node, code, dst);
+        case NODE_FUNCALL: {
+            Ref id = node.get(0);
+            Function *called = _context->getProgram().getFunction(id.getSymbol(), _context);
+            if (called == NULL) {
+                throw ParserException(fmt("Called function %s is not declared",
+                        id.getTag().c_str()));
+            }
+            int inArgs = called->getInputParametersCount();
+            int inArgsActual = node.childrenCount() - 1;
+            if (inArgsActual != inArgs) {
+                throw ParserException(fmt("Function %s is declared with %d input parameters but %d are passed",
+                        id.getTag().c_str(), inArgs, inArgsActual));
+            }
+            for (int i = node.childrenCount() - 1; i > 0; --i) {
+                IrInstruction argument = instruction(IR_ARG);
+                argument.a = lowerExpression(node.get(i), code);
+                code.push_back(argument);
+            }
+            IrInstruction call = instruction(IR_CALL);
+            call.dst = IrOperand::reg(target(dst));
+            call.label = inArgsActual;
+            call.name = id.getTagRef();
+            code.push_back(call);
+            return call.dst;
+        }
+        default:
+            assert(!"not an expression");
+            return IrOperand::none();
+    }
+}
+
+// only the top operation of the chain is put to dst
+template <class Ref>
+IrOperand IrBuilder<Ref>::lowerChain(Ref node, Code &code, int dst) {
+    std::vector<Ref> spine;
+    IrOperand a = lowerExpression(collectSpine(node, spine), code);
+    for (size_t k = spine.size(); k-- > 0;) {
+        const BinaryOperator *op = findBinaryOperator(spine[k].getTagRef());
+        assert(op != NULL);
+        IrOperand b = lowerExpression(spine[k].get(1), code);
+        IrOp irOp = getOp(op);
+        if ((irOp == IR_DIV || irOp == IR_MOD) && b.isImm()) {
+            b = add(code, IR_MOV, _function.addTemporary(), b);
+        }
+        a = add(code, irOp, k == 0 ? target(dst) : _function.addTemporary(), a, b);
+    }
+    return a;
+}
+
+template <class Ref>
+void IrBuilder<Ref>::lowerBranch(Ref bexpression, bool whenTrue, int label, Code &code) {
+    ASSERT_KIND(NODE_BEXPRESSION, bexpression);
+    if (bexpression.childrenCount() == 1 && bexpression.get(0).childrenCount() == 1) {
+        lowerAtomBranch(bexpression.get(0).get(0), whenTrue, label, code);
+    } else {
+        IrOperand value = lowerBexpression(bexpression, code);
+        branch(code, whenTrue ? IR_NOT_EQUAL : IR_EQUAL, value, IrOperand::imm(0), label);
+    }
+}
+
+template <class Ref>
+void IrBuilder<Ref>::lowerAtomBranch(Ref batom, bool whenTrue, int label, Code &code) {
+    ASSERT_KIND(NODE_BATOM, batom);
+    Ref atom = batom.get(0);
+    NodeKind kind = atom.getKind();
+    if (isCmp(kind)) {
+        IrOperand a = lowerExpression(atom.get(0), code);
+        IrOperand b = lowerExpression(atom.get(1), code);
+        IrCond cond = getCond(kind);
+        branch(code, whenTrue ? cond : negateCond(cond), a, b, label);
+    } else if (kind == NODE_NOT) {
+        lowerAtomBranch(atom.get(0), !whenTrue, label, code);
+    } else if (kind == NODE_BEXPRESSION) {
+        lowerBranch(atom, whenTrue, label, code);
+    } else if ((kind == NODE_TRUE) == whenTrue) {
+        assert(kind == NODE_TRUE || kind == NODE_FALSE);
+        jump(code, label);
+    }
+}
+
+/*
+ * As the stack machine computes them: a conjunction is true if its last
+ * atom equals the conjunction of the ones before, a disjunction if the sum
+ * is not 0.
+ */
+template <class Ref>
+IrOperand IrBuilder<Ref>::lowerBexpression(Ref node, Code &code) {
+    IrOperand disjunction;
+    for (int i = 0; i < node.childrenCount(); ++i) {
+        Ref bdisj = i == 0 ? node.get(0) : node.get(i).get(0);
+        ASSERT_KIND(NODE_BDISJ, bdisj);
+
+        IrOperand conjunction = lowerAtom(bdisj.get(0), code);
+        for (int j = 1; j < bdisj.childrenCount(); ++j) {
+            ASSERT_KIND(NODE_BCONJ_REST, bdisj.get(j));
+            IrOperand atom = lowerAtom(bdisj.get(j).get(0), code);
+            conjunction = add(code, IR_SET, _function.addTemporary(),
+                    atom, conjunction, IR_EQUAL);
+        }
+
+        if (i == 0) {
+            disjunction = conjunction;
+        } else {
+            IrOperand sum = add(code, IR_ADD, _function.addTemporary(),
+                    conjunction, disjunction);
+            disjunction = add(code, IR_SET, _function.addTemporary(),
+                    sum, IrOperand::imm(0), IR_NOT_EQUAL);
+        }
+    }
+    return disjunction;
+}
+
+template <class Ref>
+IrOperand IrBuilder<Ref>::lowerAtom(Ref batom, Code &code) {
+    ASSERT_KIND(NODE_BATOM, batom);
+    Ref atom = batom.get(0);
+    NodeKind kind = atom.getKind();
+    if (isCmp(kind)) {
+        IrOperand a = lowerExpression(atom.get(0), code);
+        IrOperand b = lowerExpression(atom.get(1), code);
+        return add(code, IR_SET, _function.addTemporary(), a, b, getCond(kind));
+    } else if (kind == NODE_NOT) {
+        IrOperand value = lowerAtom(atom.get(0), code);
+        return add(code, IR_SET, _function.addTemporary(),
+                value, IrOperand::imm(0), IR_EQUAL);
+    } else if (kind == NODE_BEXPRESSION) {
+        return lowerBexpression(atom, code);
+    }
+    assert(kind == NODE_TRUE || kind == NODE_FALSE);
+    return IrOperand::imm(kind == NODE_TRUE ? 1 : 0);
+}
+
+}
+
+template <class Ref>
+void generateBodyWithRegisters(Ref node, Function *context, CodeBuffer &code) {
+    IrFunction function(node.get(1).getTagRef(), context->getEndMarker());
+    IrBuilder<Ref>(context, function).lower(node);
+    RegisterAllocator allocator(function);
+    emitFunction(function, allocator, code);
+}
+
+template void generateBodyWithRegisters(NodePtr node, Function *context, CodeBuffer &code);
+template void generateBodyWithRegisters(FlatRef node, Function *context, CodeBuffer &code);
@@ -0,0 +1,40 @@
+#include <algorithm>
+#include "LineIndex.h"
+#include "SimdScan.h"
+
+LineIndex::LineIndex() :
+_line_starts(1, 0),
+_size(0) {
+}
+
+void LineIndex::clear() {
+    _line_starts.assign(1, 0);
+    _size = 0;
+}
+
+void LineIndex::append(const char *data, size_t length) {
+    size_t pos = 0;
+    while ((pos = SimdScan::findNewline(data, pos, length)) < length) {
+        pos++;
+        _line_starts.push_back(_size + pos);
+    }
+    _size += length;
+}
+
+size_t LineIndex::getSize() const {
+    return _size;
+}
+
+int LineIndex::getLineNumber(size_t offset) const {
+    // number of lines started at or before offset
+    return std::upper_bound(_line_starts.begin(), _line_starts.end(), offset)
+            - _line_starts.begin();
+}
+
+int LineIndex::getLinePosition(size_t offset) const {
+    return offset - _line_starts[getLineNumber(offset) - 1] + 1;
+}
+
+size_t LineIndex::getMemoryUsage() const {
+    return _line_starts.capacity() * sizeof(size_t);
+}
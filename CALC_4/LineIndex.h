@@ -0,0 +1,44 @@
+#ifndef LINEINDEX_H
+#define	LINEINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Offsets of the line starts of the input. Positions are kept as byte
+ * offsets everywhere; line and position are found here by binary search
+ * only when somebody asks (error message, token dump).
+ *
+ * Input is indexed block by block with append() as it is read, or all at
+ * once with update() before the first query if it is contiguous.
+ */
+class LineIndex {
+private:
+    // offset of the first symbol of every line; the first line starts at 0
+    std::vector<size_t> _line_starts;
+    // number of bytes indexed
+    size_t _size;
+public:
+    LineIndex();
+
+    void clear();
+    // indexes the next block of the input
+    void append(const char *data, size_t length);
+
+    // indexes the rest of contiguous input of given size
+    void update(const char *data, size_t size) {
+        if (_size < size) {
+            append(data + _size, size - _size);
+        }
+    }
+
+    size_t getSize() const;
+
+    // line and position of the symbol at offset, both starting from 1
+    int getLineNumber(size_t offset) const;
+    int getLinePosition(size_t offset) const;
+
+    size_t getMemoryUsage() const;
+};
+
+#endif	/* LINEINDEX_H */
@@ -1,53 +1,26 @@
 #include "LocatableStream.h"
-#define DEBUG_LOG_OFF
-#include "Logger.h"
 
 using std::string;
 
-LocatableStream::LocatableStream(string filename) :
-BufferedStream(filename),
-_lineNumber(1),
-_linePosition(1) {
+LocatableStream::LocatableStream(string filename,
+        size_t bufferSize, size_t lookbehind) :
+BufferedStream(filename, bufferSize, lookbehind) {
 
 }
 
-LocatableStream::LocatableStream(int fd) :
-BufferedStream(fd),
-_lineNumber(1),
-_linePosition(1) {
+LocatableStream::LocatableStream(int fd, size_t bufferSize, size_t lookbehind) :
+BufferedStream(fd, bufferSize, lookbehind) {
 
 }
 
-int LocatableStream::get() {
-    int symbol = BufferedStream::get();
-    DEBUG(fmt("get() %d (%c)", symbol, symbol));
-
-    if (symbol == '\n') {
-        saveState();
-        _lineNumber++;
-        _linePosition = 1;
-    } else if (symbol == 0) {
-        // if EOF do nothing
-    } else {
-        saveState();
-        _linePosition++;
-    }
-
-    DEBUG(fmt("(%d,%d)", _lineNumber, _linePosition));
-
-    return symbol;
-}
-
-void LocatableStream::unget() {
-    BufferedStream::unget();
-    restoreState();
-}
+// EOF doesn't move the offset, so the last symbol is right before it
 
 int LocatableStream::getLineNumber() const {
-    return _savedLineNumber;
+    size_t offset = getOffset();
+    return getLineNumber(offset > 0 ? offset - 1 : 0);
 }
 
 int LocatableStream::getLinePosition() const {
-    return _savedLinePosition;
+    size_t offset = getOffset();
+    return getLinePosition(offset > 0 ? offset - 1 : 0);
 }
-
@@ -2,36 +2,20 @@
 #define	LOCATABLESTREAM_H
 #include "BufferedStream.h"
 
+/**
+ * BufferedStream which knows the line and position of the last symbol.
+ * Kept for compatibility; CharStream does the same without virtual calls.
+ */
 class LocatableStream : public BufferedStream {
-private:
-    int _lineNumber;
-    int _linePosition;
-    int _savedLineNumber;
-    int _savedLinePosition;
-    int _savedSavedLineNumber;
-    int _savedSavedLinePosition;
-
-    void saveState() {
-        _savedSavedLineNumber = _savedLineNumber;
-        _savedSavedLinePosition = _savedLinePosition;
-
-        _savedLineNumber = _lineNumber;
-        _savedLinePosition = _linePosition;
-    }
-
-    void restoreState() {
-        _lineNumber = _savedLineNumber;
-        _linePosition = _savedLinePosition;
-        
-        _savedLineNumber = _savedSavedLineNumber;
-        _savedLinePosition = _savedSavedLinePosition;
-    }
 public:
 
-    LocatableStream(std::string filename);
-    LocatableStream(int fd);
-    int get();
-    void unget();
+    LocatableStream(std::string filename,
+            size_t bufferSize = BUF_SIZE, size_t lookbehind = LOOKBEHIND);
+    LocatableStream(int fd,
+            size_t bufferSize = BUF_SIZE, size_t lookbehind = LOOKBEHIND);
+
+    using BufferedStream::getLineNumber;
+    using BufferedStream::getLinePosition;
     int getLineNumber() const;
     int getLinePosition() const;
 };
@@ -2,6 +2,12 @@
 #include <string>
 #include <stdarg.h>
 #include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Logger.h"
 
@@ -10,11 +16,260 @@ using std::ostream;
 using std::cerr;
 using std::endl;
 
+namespace {
+
+struct Record {
+    const char *level;
+    const char *file;
+    const char *function;
+    int line;
+    string msg;
+};
+
+/*
+ * Messages of one thread. Only the owner advances tail and only the
+ * writer advances head, so release/acquire on them is enough; msg strings
+ * of the slots are reused.
+ */
+struct LogRing {
+    std::vector<Record> records;
+    size_t mask;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    // messages discarded by DROP since the writer looked last
+    std::atomic<size_t> dropped;
+    // the owner thread has exited, the ring is freed once drained
+    std::atomic<bool> retired;
+
+    LogRing(size_t capacity) :
+    records(capacity),
+    mask(capacity - 1),
+    head(0),
+    tail(0),
+    dropped(0),
+    retired(false) {
+    }
+};
+
+class AsyncSink {
+private:
+    // guards rings and start/stop
+    std::mutex _mutex;
+    std::vector<std::shared_ptr<LogRing> > _rings;
+    std::thread _writer;
+    ostream *_stream;
+    Logger::OverflowPolicy _policy;
+    size_t _capacity;
+    std::atomic<bool> _running;
+    // rings of an earlier start are not used after a restart
+    std::atomic<unsigned long> _generation;
+    std::atomic<unsigned long> _flush_requested;
+    std::atomic<unsigned long> _flush_done;
+
+    std::shared_ptr<LogRing> addRing();
+    size_t drain(string &batch);
+    void run();
+public:
+
+    AsyncSink() :
+    _stream(NULL),
+    _policy(Logger::BLOCK),
+    _capacity(0),
+    _running(false),
+    _generation(0),
+    _flush_requested(0),
+    _flush_done(0) {
+    }
+
+    bool isRunning() const {
+        return _running.load(std::memory_order_acquire);
+    }
+
+    void start(ostream *stream, Logger::OverflowPolicy policy, size_t capacity);
+    void stop();
+    void flush();
+    // false if the sink is not running and the message should be written now
+    bool push(const string &msg, const char *level, const char *file, const char *function, int line);
+};
+
+// owner's reference to its ring; marks the ring retired when the thread exits
+struct RingHolder {
+    std::shared_ptr<LogRing> ring;
+    unsigned long generation;
+
+    RingHolder() : generation(0) {
+    }
+
+    ~RingHolder() {
+        if (ring) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+AsyncSink _sink;
+thread_local RingHolder _localRing;
+
+void appendRecord(string &batch, const Record &record) {
+    char line[16];
+    snprintf(line, sizeof (line), "%d", record.line);
+    batch += record.level;
+    batch += ' ';
+    batch += record.file;
+    batch += ':';
+    batch += record.function;
+    batch += ':';
+    batch += line;
+    batch += ' ';
+    batch += record.msg;
+    batch += '\n';
+}
+
+void stopAtExit() {
+    _sink.stop();
+}
+
+}
+
+void AsyncSink::start(ostream *stream, Logger::OverflowPolicy policy, size_t capacity) {
+    static bool stopRegistered = (atexit(stopAtExit) == 0);
+    (void) stopRegistered;
+
+    stop();
+    std::lock_guard<std::mutex> guard(_mutex);
+    _stream = stream;
+    _policy = policy;
+    _capacity = 1;
+    while (_capacity < capacity) {
+        _capacity <<= 1;
+    }
+    _generation.fetch_add(1, std::memory_order_relaxed);
+    _running.store(true, std::memory_order_release);
+    _writer = std::thread(&AsyncSink::run, this);
+}
+
+/*
+ * The writer drains the rings once more and exits. Messages logged by
+ * other threads while stopping may be lost, so stop when they are done.
+ */
+void AsyncSink::stop() {
+    if (!_running.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    _writer.join();
+    std::lock_guard<std::mutex> guard(_mutex);
+    _rings.clear();
+}
+
+void AsyncSink::flush() {
+    unsigned long request = _flush_requested.fetch_add(1, std::memory_order_acq_rel) + 1;
+    while (_flush_done.load(std::memory_order_acquire) < request && isRunning()) {
+        std::this_thread::yield();
+    }
+}
+
+std::shared_ptr<LogRing> AsyncSink::addRing() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    std::shared_ptr<LogRing> ring(new LogRing(_capacity));
+    _rings.push_back(ring);
+    return ring;
+}
+
+bool AsyncSink::push(const string &msg, const char *level, const char *file, const char *function, int line) {
+    if (!isRunning()) {
+        return false;
+    }
+    unsigned long generation = _generation.load(std::memory_order_relaxed);
+    if (_localRing.generation != generation) {
+        if (_localRing.ring) {
+            _localRing.ring->retired.store(true, std::memory_order_release);
+        }
+        _localRing.ring = addRing();
+        _localRing.generation = generation;
+    }
+    LogRing &ring = *_localRing.ring;
+
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    while (tail - ring.head.load(std::memory_order_acquire) > ring.mask) {
+        if (_policy == Logger::DROP) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (!isRunning()) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    Record &record = ring.records[tail & ring.mask];
+    record.level = level;
+    record.file = file;
+    record.function = function;
+    record.line = line;
+    record.msg = msg;
+    ring.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// appends the published records of all rings to batch; returns their count
+size_t AsyncSink::drain(string &batch) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    size_t count = 0;
+    for (size_t i = 0; i < _rings.size();) {
+        LogRing &ring = *_rings[i];
+        bool retired = ring.retired.load(std::memory_order_acquire);
+        size_t head = ring.head.load(std::memory_order_relaxed);
+        size_t tail = ring.tail.load(std::memory_order_acquire);
+        count += tail - head;
+        for (; head != tail; ++head) {
+            appendRecord(batch, ring.records[head & ring.mask]);
+        }
+        ring.head.store(tail, std::memory_order_release);
+
+        size_t dropped = ring.dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped != 0) {
+            batch += fmt("WARN %s:%s:%d %lu messages dropped\n",
+                    __FILE__, __FUNCTION__, __LINE__, (unsigned long) dropped);
+        }
+
+        if (retired) {
+            _rings.erase(_rings.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+    return count;
+}
+
+void AsyncSink::run() {
+    string batch;
+    for (;;) {
+        bool stopping = !isRunning();
+        unsigned long request = _flush_requested.load(std::memory_order_acquire);
+        size_t count = drain(batch);
+        if (!batch.empty()) {
+            _stream->write(batch.data(), batch.size());
+            _stream->flush();
+            batch.clear();
+        }
+        _flush_done.store(request, std::memory_order_release);
+        if (stopping) {
+            break;
+        }
+        if (count == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
 Logger Logger::_logger;
 std::ostream * Logger::_stream = &cerr;
 Logger::ReportingLevel Logger::_level = Logger::ERROR;
 
-void Logger::log(string msg, string level, string file, string function, int line) {
+void Logger::log(const string &msg, const char *level, const char *file, const char *function, int line) {
+    if (_sink.push(msg, level, file, function, line)) {
+        return;
+    }
     (*_stream) << level << " "
             << file << ':'
             << function << ':' << line << " "
@@ -29,19 +284,30 @@ void Logger::setLevel(Logger::ReportingLevel level) {
     _level = level;
 }
 
-void Logger::debug(string msg, string file, string function, int line) {
-    if (_level <= Logger::DEBUG)
-        Logger::log(msg, "DEBUG", file, function, line);
+void Logger::startAsync(OverflowPolicy policy, size_t capacity) {
+    _sink.start(_stream, policy, capacity);
+}
+
+void Logger::stopAsync() {
+    _sink.stop();
+}
+
+void Logger::flush() {
+    if (_sink.isRunning()) {
+        _sink.flush();
+    }
+}
+
+void Logger::debug(const string &msg, const char *file, const char *function, int line) {
+    Logger::log(msg, "DEBUG", file, function, line);
 }
 
-void Logger::warn(string msg, string file, string function, int line) {
-    if (_level <= Logger::WARN)
-        Logger::log(msg, "WARN", file, function, line);
+void Logger::warn(const string &msg, const char *file, const char *function, int line) {
+    Logger::log(msg, "WARN", file, function, line);
 }
 
-void Logger::error(string msg, string file, string function, int line) {
-    if (_level <= Logger::ERROR)
-        Logger::log(msg, "ERROR", file, function, line);
+void Logger::error(const string &msg, const char *file, const char *function, int line) {
+    Logger::log(msg, "ERROR", file, function, line);
 }
 
 string fmt(const char *fmt, ...) {
@@ -53,7 +319,7 @@ string fmt(const char *fmt, ...) {
     va_end(ap);
 
     string str(c_str);
-    delete[] c_str;
+    free(c_str);
     return str;
 }
 
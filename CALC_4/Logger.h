@@ -5,17 +5,42 @@
 #include <ostream>
 #include <iostream>
 
+/*
+ * Levels below LOG_MIN_LEVEL are compiled out: DEBUG(...) and TRACE expand
+ * to an empty statement and their arguments are never evaluated. Enabled
+ * levels cost one branch on the run-time level before any argument
+ * (e.g. fmt(...)) is evaluated. DEBUG_LOG_OFF is kept as a shorthand.
+ */
+#ifndef LOG_MIN_LEVEL
 #ifdef DEBUG_LOG_OFF
-#define DEBUG(msg)
-#define TRACE
+#define LOG_MIN_LEVEL 1 // Logger::WARN
 #else
-#define DEBUG(msg) Logger::debug(msg, __FILE__, __FUNCTION__, __LINE__)
+#define LOG_MIN_LEVEL 0 // Logger::DEBUG
+#endif
+#endif
+
+#define LOG_AT(level, method, msg) do { \
+        if (Logger::isEnabled(level)) { \
+            Logger::method(msg, __FILE__, __FUNCTION__, __LINE__); \
+        } \
+    } while (0)
+
+#if LOG_MIN_LEVEL > 0
+#define DEBUG(msg) do {} while (0)
+#else
+#define DEBUG(msg) LOG_AT(Logger::DEBUG, debug, msg)
+#endif
 #define TRACE DEBUG("")
+
+#if LOG_MIN_LEVEL > 1
+#define WARN(msg) do {} while (0)
+#else
+#define WARN(msg) LOG_AT(Logger::WARN, warn, msg)
 #endif
 
-#define WARN(msg)  Logger::warn (msg, __FILE__, __FUNCTION__, __LINE__)
-#define ERROR(msg) Logger::error(msg, __FILE__,  __FUNCTION__,__LINE__)
-#define CRITICAL(msg) do {Logger::error(msg, __FILE__,  __FUNCTION__, __LINE__); exit(1);} while (0)
+#define ERROR(msg) LOG_AT(Logger::ERROR, error, msg)
+#define CRITICAL(msg) do {ERROR(msg); Logger::flush(); exit(1);} while (0)
+
 #define LOG_MSG(msg) fmt("%s:%s:%d %s", __FILE__, __FUNCTION__ , __LINE__, msg)
 #define LOG_MSG_C(msg) fmt("%s:%s:%d %s", __FILE__, __FUNCTION__ , __LINE__, msg).c_str()
 
@@ -29,21 +54,45 @@ public:
         ERROR,
         SILENT
     };
+
+    // what a thread does when its buffer of the asynchronous sink is full
+    enum OverflowPolicy {
+        DROP, // the message is counted and discarded
+        BLOCK // the thread waits for the writer
+    };
 private:
     static Logger _logger;
 
     static std::ostream *_stream;
     static Logger::ReportingLevel _level;
 
-    static void log(std::string msg, std::string level, std::string file, std::string function, int line);
+    static void log(const std::string &msg, const char *level, const char *file, const char *function, int line);
 public:
 
     static void setStream(std::ostream *stream);
     static void setLevel(Logger::ReportingLevel level);
 
-    static void debug(std::string msg, std::string file, std::string function, int line);
-    static void warn(std::string msg, std::string file, std::string function, int line);
-    static void error(std::string msg, std::string file, std::string function, int line);
+    /*
+     * Asynchronous sink: each thread puts messages into its own ring of
+     * capacity records (rounded up to a power of 2) and a background
+     * thread writes them to the stream in batches. Order is kept within
+     * a thread only. Until startAsync() and after stopAsync() messages
+     * are written synchronously. stopAsync() is also called at exit.
+     */
+    static void startAsync(OverflowPolicy policy = BLOCK, size_t capacity = 4096);
+    static void stopAsync();
+    // waits until the messages logged so far are written; no-op if synchronous
+    static void flush();
+
+    // true if messages of the level are compiled in and reported
+    static bool isEnabled(Logger::ReportingLevel level) {
+        return level >= LOG_MIN_LEVEL && level >= _level;
+    }
+
+    // the messages are written regardless of the level, check isEnabled()
+    static void debug(const std::string &msg, const char *file, const char *function, int line);
+    static void warn(const std::string &msg, const char *file, const char *function, int line);
+    static void error(const std::string &msg, const char *file, const char *function, int line);
 };
 
 std::string fmt(const char *fmt, ...);
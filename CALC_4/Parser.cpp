@@ -1,47 +1,352 @@
 #include "Parser.h"
+#include "frozen_map.h"
 #include <cstdio>
+#include <atomic>
+#include <exception>
+#include <thread>
 
-std::string buildXMLTree(Node *root, int level) {
+namespace {
+
+constexpr frozen_map<NodeKind, const char *, NODE_KIND_COUNT> _nodeKindNames = {{
+    {NODE_TYPE, "type"},
+    {NODE_ID, "id"},
+    {NODE_FUNCARGS, "funcargs"},
+    {NODE_FUNCARG, "funarg"},
+    {NODE_STATEMENTS, "statements"},
+    {NODE_FUNCDEF, "funcdef"},
+    {NODE_PROGRAM, "program"},
+    {NODE_READ, "read"},
+    {NODE_RETURN, "return"},
+    {NODE_PRINT, "print"},
+    {NODE_NEGATION, "negation"},
+    {NODE_BINARY, "binary"},
+    {NODE_INTEGER, "integer"},
+    {NODE_ASSIGNMENT, "assignment"},
+    {NODE_DECLARATION, "declaration"},
+    {NODE_BATOM, "batom"},
+    {NODE_BCONJ_REST, "bConj"},
+    {NODE_BDISJ, "bdisj"},
+    {NODE_BDISJ_REST, "bDisj"},
+    {NODE_BEXPRESSION, "bexpression"},
+    {NODE_IF, "if"},
+    {NODE_FOR, "for"},
+    {NODE_WHILE, "while"},
+    {NODE_FUNCALL, "funcall"},
+    {NODE_FUNCALLARG, "funcallarg"},
+    {NODE_BCONJ, "bconj"},
+    {NODE_CMP_LESS, "cmpless"},
+    {NODE_CMP_GREATER, "cmpgreater"},
+    {NODE_CMP_LESS_OR_EQUAL, "cmplessorequal"},
+    {NODE_CMP_GREATER_OR_EQUAL, "cmpgreaterorequal"},
+    {NODE_CMP_EQUAL, "cmpequal"},
+    {NODE_CMP_NOT_EQUAL, "cmpnotequal"},
+    {NODE_TRUE, "true"},
+    {NODE_FALSE, "false"},
+    {NODE_NOT, "not"},
+}};
+static_assert(_nodeKindNames.isDense(), "node kinds must be listed in order");
 
-    std::string xml;
-    std::string indent;
+}
+
+const char *getNodeKindName(NodeKind kind) {
+    return _nodeKindNames[kind];
+}
 
-    for (int i = 0; i < level; ++i) {
-        indent += "  ";
+/*
+ * A new operator needs only its line here (and its token in Tokenizer).
+ */
+static const BinaryOperator binaryOperators[] = {
+    {Tokenizer::T_PLUS, "+", 1, "addl"},
+    {Tokenizer::T_MINUS, "-", 1, "subl"},
+    {Tokenizer::T_MULT, "*", 2, "imull"},
+    {Tokenizer::T_DIV, "/", 2, "idivl"},
+    {Tokenizer::T_MOD, "%", 2, "idivl"},
+};
+
+static const size_t BINARY_OPERATOR_COUNT =
+        sizeof (binaryOperators) / sizeof (binaryOperators[0]);
+
+const BinaryOperator *findBinaryOperator(Tokenizer::ValueType token) {
+    for (size_t i = 0; i < BINARY_OPERATOR_COUNT; ++i) {
+        if (binaryOperators[i].token == token) {
+            return &binaryOperators[i];
+        }
     }
+    return NULL;
+}
 
-    xml += indent;
-    xml += root->XMLStart();
-    xml += "\n";
+const BinaryOperator *findBinaryOperator(StringRef name) {
+    for (size_t i = 0; i < BINARY_OPERATOR_COUNT; ++i) {
+        if (name == binaryOperators[i].name) {
+            return &binaryOperators[i];
+        }
+    }
+    return NULL;
+}
+
+bool parseInteger(StringRef literal, int &value) {
+    bool negative = !literal.empty() && literal[0] == '-';
+    size_t start = negative ? 1 : 0;
+    unsigned base = literal.length() > start + 1 && literal[start] == '0' ? 8 : 10;
+    unsigned result = 0;
+    for (size_t i = start; i < literal.length(); ++i) {
+        unsigned digit = literal[i] - '0';
+        if (digit >= base) {
+            return false;
+        }
+        result = result * base + digit;
+    }
+    value = (int) (negative ? 0u - result : result);
+    return literal.length() > start;
+}
 
-    for(int i = 0; i < root->childrenCount(); ++i) {
-        xml += buildXMLTree(root->get(i), level + 1);
+namespace {
+
+// deeper tags are not indented more, so the XML of a long chain is not
+// quadratic in its length
+static const int MAX_INDENT_LEVEL = 32;
+
+// XML of the tree appended to one string
+template <class Ref>
+class XMLBuilder : public NodeVisitor<Ref> {
+private:
+    std::string _xml;
+    int _level;
+
+    void indent() {
+        _xml.append(2 * std::min(_level, MAX_INDENT_LEVEL), ' ');
     }
 
-    std::string end = root->XMLEnd();
+    // a leaf with a tag is one line, e.g. <id>a</id>
+    static bool isLeaf(Ref node) {
+        return node.getTagRef().length() != 0 && node.childrenCount() == 0;
+    }
 
-    if (end.length() != 0) {
-        xml += indent;
-        xml += root->XMLEnd();
-        xml += "\n";
+    void open(Ref node) {
+        StringRef tag = node.getTagRef();
+        const char *XMLTag = getNodeKindName(node.getKind());
+        indent();
+        _xml += "<";
+        _xml += XMLTag;
+        _xml += ">";
+        _xml.append(tag.data(), tag.length());
+        if (isLeaf(node)) {
+            _xml += "</";
+            _xml += XMLTag;
+            _xml += ">";
+        }
+        _xml += "\n";
+        ++_level;
     }
 
-    return xml;
+    void close(Ref node) {
+        --_level;
+        if (!isLeaf(node)) {
+            indent();
+            _xml += "</";
+            _xml += getNodeKindName(node.getKind());
+            _xml += ">\n";
+        }
+    }
+
+public:
+
+    explicit XMLBuilder(int level) : _level(level) {
+    }
+
+    const std::string &getXML() const {
+        return _xml;
+    }
+
+    void visitNode(Ref node) {
+        open(node);
+        this->visitChildren(node);
+        close(node);
+    }
+
+    // the spine is opened from the top before the leftmost operand
+    void visitBinary(Ref node) {
+        std::vector<Ref> spine;
+        Ref leftmost = collectSpine(node, spine);
+        for (size_t k = 0; k < spine.size(); ++k) {
+            open(spine[k]);
+        }
+        this->visit(leftmost);
+        for (size_t k = spine.size(); k-- > 0;) {
+            this->visit(spine[k].get(1));
+            close(spine[k]);
+        }
+    }
+};
+
+}
+
+template <class Ref>
+std::string buildXMLTree(Ref root, int level) {
+    XMLBuilder<Ref> builder(level);
+    builder.visit(root);
+    return builder.getXML();
+}
+
+// no visitor: it is run on every FlatTree, and a visitor costs a virtual
+// call per node. The first child is followed with the loop, as the left
+// spine of a chain is as deep as the chain is long; the other children
+// nest only as deep as --max-nesting allows
+template <class Ref>
+size_t countNodes(Ref root) {
+    size_t count = 1;
+    while (root.childrenCount() != 0) {
+        for (int i = 1; i < root.childrenCount(); ++i) {
+            count += countNodes(root.get(i));
+        }
+        root = root.get(0);
+        ++count;
+    }
+    return count;
 }
 
-std::map<std::string, Function *> Program::_functions;
-std::map<std::string, bool> Program::_declarationMask;
-int _max_marker_counter = 0;
-std::string getNextMarker() {
-	std::string marker = fmt(".M%03d", _max_marker_counter);
-	_max_marker_counter = _max_marker_counter + 1;
-	return marker;
-}   
+template std::string buildXMLTree(NodePtr root, int level);
+template std::string buildXMLTree(FlatRef root, int level);
+template size_t countNodes(NodePtr root);
+template size_t countNodes(FlatRef root);
+
+std::string buildXMLTree(Node *root, int level) {
+    return buildXMLTree(NodePtr(root), level);
+}
+
+size_t countNodes(Node *root) {
+    return countNodes(NodePtr(root));
+}
+
+/*
+ * Breadth-first, so that the children of every node are added together.
+ */
+FlatTree::FlatTree(Node *root) {
+    size_t count = countNodes(NodePtr(root));
+    std::vector<Node *> sources;
+    sources.reserve(count);
+    _nodes.reserve(count);
+
+    sources.push_back(root);
+    FlatNode flat = {root->getKind(), 0, 0, 0, 0, root->getSymbol()};
+    _nodes.push_back(flat);
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        Node *node = sources[i];
+        StringRef tag = node->getTagRef();
+
+        FlatNode &target = _nodes[i];
+        assert(node->childrenCount() < (1 << 24));
+        target.children_count = node->childrenCount();
+        target.first_child = _nodes.size();
+        target.tag_offset = _text.length();
+        target.tag_length = tag.length();
+        _text.append(tag.data(), tag.length());
+
+        for (int j = 0; j < node->childrenCount(); ++j) {
+            Node *child = node->get(j);
+            FlatNode flatChild = {child->getKind(), 0, 0, 0, 0, child->getSymbol()};
+            sources.push_back(child);
+            _nodes.push_back(flatChild);
+        }
+    }
+}
+
+namespace {
+
+// definitions of a program shared by the threads of generateProgramParallel()
+template <class Ref>
+struct FunctionJobs {
+    std::vector<Ref> nodes;
+    std::vector<Function *> contexts;
+    std::vector<CodeBuffer> codes;
+    std::vector<std::exception_ptr> errors;
+    // the first function not taken by a thread yet
+    std::atomic<size_t> next;
+};
+
+template <class Ref>
+void runFunctionJobs(FunctionJobs<Ref> *jobs) {
+    for (size_t i = jobs->next++; i < jobs->nodes.size(); i = jobs->next++) {
+        try {
+            FuncdefNode::generateBody(jobs->nodes[i], jobs->contexts[i], jobs->codes[i]);
+        } catch (...) {
+            jobs->errors[i] = std::current_exception();
+        }
+    }
+}
+
+}
+
+/*
+ * All the functions are added to the program first, in order, so the
+ * bodies only read the program and each other's interfaces. Every body
+ * is generated into a CodeBuffer of its own by the first free thread,
+ * and the buffers are joined in the program order. Errors are the same
+ * as of generateProgram(): the first one in the program order is thrown.
+ */
+template <class Ref>
+void generateProgramParallel(Ref root, Program &program, CodeBuffer &code, int jobs) {
+    ASSERT_KIND(NODE_PROGRAM, root);
+    assert(jobs > 0);
+    program.setLocalMarkers(true);
+
+    FunctionJobs<Ref> functions;
+    // a function that can not be added stops the program there
+    std::exception_ptr declarationError;
+    for (int i = 0; i < root.childrenCount() && !declarationError; ++i) {
+        Ref child = root.get(i);
+        ASSERT_KIND(NODE_FUNCDEF, child);
+        try {
+            Function *context = FuncdefNode::declare(child, program);
+            if (context != NULL) {
+                functions.nodes.push_back(child);
+                functions.contexts.push_back(context);
+            }
+        } catch (...) {
+            declarationError = std::current_exception();
+        }
+    }
+
+    size_t count = functions.nodes.size();
+    std::vector<CodeBuffer> codes(count);
+    functions.codes.swap(codes);
+    functions.errors.resize(count);
+    functions.next = 0;
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < jobs && (size_t) t < count; ++t) {
+        workers.push_back(std::thread(runFunctionJobs<Ref>, &functions));
+    }
+    runFunctionJobs(&functions);
+    for (size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (functions.errors[i]) {
+            std::rethrow_exception(functions.errors[i]);
+        }
+    }
+    if (declarationError) {
+        std::rethrow_exception(declarationError);
+    }
+
+    ProgramNode::generateHeader(code);
+    for (size_t i = 0; i < count; ++i) {
+        code.splice(functions.codes[i]);
+    }
+}
 
+template void generateProgramParallel(NodePtr root, Program &program, CodeBuffer &code, int jobs);
+template void generateProgramParallel(FlatRef root, Program &program, CodeBuffer &code, int jobs);
 
 int main2() {
-    Node *pn = new ProgramNode();
-    pn->addChild(new IdNode("abc"));
+    Arena arena;
+    Node *pn = new (arena) ProgramNode();
+    SymbolPool symbols;
+    StringRef name("abc", 3);
+    pn->addChild(new (arena) IdNode(name, symbols.intern(name)), arena);
     ::printf("%s", buildXMLTree(pn).c_str());
     return 0;
 }
@@ -2,20 +2,21 @@
 #define PARSER_H
 
 #include <cassert>
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include "Tokenizer.h"
+#include "TokenBuffer.h"
+#include "CodeBuffer.h"
+#include "Arena.h"
 #include "Logger.h"
+#include "SymbolPool.h"
+#include "SymbolMap.h"
 
-#include <map>
 #include <list>
 #include <algorithm>
 
-#define ASSERT_TYPE(X,Y) assert(dynamic_cast<X>(Y) != NULL)
-
-std::string getNextMarker();
-
 class ParserException : public std::exception {
 	private:
 		std::string _msg;
@@ -31,71 +32,68 @@ class ParserException : public std::exception {
 			return _msg.c_str();
 		}
 };
+class Program;
+
+/*
+ * Variables and functions are looked up by their Symbol (see SymbolPool);
+ * names are kept only for the messages and the assembly.
+ */
 class Function {
 	private:
+		Program *_program;
 		std::string _type;
 		std::string _name;
-		std::map<std::string, std::string> _types;
-		std::map<std::string, int> _offsets;
-
+		// offsets from %ebp: parameters above it, local variables below
+		SymbolMap<int> _offsets;
+		int _parameters_count;
+
+		// position of the definition or declaration in the program
+		int _index;
+		// markers taken in the function's own namespace
+		int _marker_counter;
 		std::string _endMarker;
 
 		int _max_parameters_offset;
 		int _max_local_variable_offset;
 
-		bool isVariableUnique(std::string id) {
+		bool isVariableUnique(Symbol id) {
 			TRACE;
-			return (_offsets.find(id) == _offsets.end());
+			return !_offsets.contains(id);
 		}
 	public:
-		Function(std::string type, std::string name):
-			_type(type),
-			_name(name),
-			// 4 bytes for return address
-			// 4 bytes for the saved ebp
-			_max_parameters_offset(8),
-			_max_local_variable_offset(-4)
-	{
-		TRACE;
-		_endMarker = getNextMarker();
-	}
+		// markers of the function are taken from the program
+		Function(Program &program, std::string type, std::string name);
 
-		void addParameter(std::string type, std::string id) {
+		void addParameter(Symbol id, StringRef name) {
 			TRACE;
 			if (!isVariableUnique(id)) {
-				throw ParserException(fmt("Variable is already defined: %s", id.c_str()));
+				throw ParserException(fmt("Variable is already defined: %s", name.str().c_str()));
 			}
-			_types.insert(std::make_pair<std::string, std::string> (id, type));
-			// set offset!
-			_offsets.insert(std::make_pair<std::string, int>(id, _max_parameters_offset));
+			_offsets[id] = _max_parameters_offset;
 			_max_parameters_offset += 4;
+			_parameters_count += 1;
 		}
 
-		void addLocalVariable(std::string type, std::string id) {
+		void addLocalVariable(Symbol id, StringRef name) {
 			TRACE;
 
 			if (!isVariableUnique(id)) {
-				throw ParserException(fmt("Variable is already defined: %s", id.c_str()));
+				throw ParserException(fmt("Variable is already defined: %s", name.str().c_str()));
 			}
-			_types.insert(std::make_pair<std::string, std::string> (id, type));
-			// set offset!
-			_offsets.insert(std::make_pair<std::string, int>(id, _max_local_variable_offset));
+			_offsets[id] = _max_local_variable_offset;
 			_max_local_variable_offset -= 4;
 		}
 
-		int getVariableOffset(std::string id) {
+		int getVariableOffset(Symbol id, StringRef name) const {
 			TRACE;
 
-			if (_types.find(id) == _types.end() &&
-					_offsets.find(id) == _offsets.end()) {
+			const int *offset = _offsets.find(id);
+			if (offset == NULL) {
 				throw ParserException(
 						fmt("Variable %s is not defined",
-							id.c_str()));
+							name.str().c_str()));
 			}
-			assert(_types.find(id) != _types.end());
-			assert(_offsets.find(id) != _offsets.end());
-
-			return _offsets[id];
+			return *offset;
 		}
 
 		std::string getType() const {
@@ -108,19 +106,9 @@ class Function {
 			return _name;
 		}
 
-		int getInputParametersCount() {
+		int getInputParametersCount() const {
 			TRACE;
-
-			int count = 0;
-			for (std::map<std::string, int>::iterator it = _offsets.begin();
-					it != _offsets.end(); ++it) {
-				std::string id = it->first;
-				int offset = it->second;
-				if (offset > 0) {
-					count = count + 1;
-				}
-			}
-			return count;
+			return _parameters_count;
 		}
 
 		bool isEqualInterface(Function *other) {
@@ -137,29 +125,74 @@ class Function {
 			return _endMarker;
 		}
 
+		std::string getNextMarker();
+
+		int getIndex() const {
+			return _index;
+		}
+
+		Program &getProgram() const {
+			return *_program;
+		}
 };
 
 /**
- * Static program class saves all the declared functions (as well as declarations)
+ * Program class saves all the declared functions (as well as declarations)
+ * and numbers the markers of the generated code, so one Program is one
+ * compilation: programs share nothing and may be generated on different
+ * threads at the same time.
  * Functions should be allocated on the heap and memory should not be deleted from outside
  * I.e. this class is very tightly coupled with the Function class.
+ * Functions are keyed by the symbols of their names, so all of them must
+ * come from one SymbolPool until clear().
  * WARNING: after adding function or declaration getFunction!
  */
 class Program {
 	private:
-		static std::map<std::string, Function *> _functions;
+		SymbolMap<Function *> _functions;
 		// true if the function is declaration; false otherwise
-		static std::map<std::string, bool> _declarationMask;
+		SymbolMap<bool> _declarationMask;
 		// counter for function internal marks
+		int _marker_counter;
+		// functions are numbered in the order they are added; the number of
+		// the first definition or declaration of each name
+		int _funcdef_count;
+		SymbolMap<int> _first_index;
+		// markers are numbered in the namespace of every function
+		bool _local_markers;
+		// bodies are generated by generateBodyWithRegisters()
+		bool _register_allocation;
+
+		void addIndex(Symbol id) {
+			if (!_first_index.contains(id)) {
+				_first_index[id] = _funcdef_count;
+			}
+			_funcdef_count += 1;
+		}
+
+		Program(const Program &);
+		Program &operator=(const Program &);
 	public:
 
-		static void addDeclaration(std::string id, Function *function) {
+		Program() :
+			_marker_counter(0),
+			_funcdef_count(0),
+			_local_markers(false),
+			_register_allocation(false) {
+		}
+
+		~Program() {
+			clear();
+		}
+
+		void addDeclaration(Symbol id, Function *function) {
 			TRACE;
-			if (_declarationMask.find(id) != _declarationMask.end()) {
+			addIndex(id);
+			if (_declarationMask.contains(id)) {
 
 				Function *saved = _functions[id];
 				if (saved->isEqualInterface(function) == false) {
-					throw ParserException(fmt("Function %s is already declared with the other interface", id.c_str()));
+					throw ParserException(fmt("Function %s is already declared with the other interface", function->getName().c_str()));
 				}
 
 				bool savedDeclaration = _declarationMask[id];
@@ -179,16 +212,17 @@ class Program {
 			}
 		}
 
-		static void addFunction(std::string id, Function *function) {
+		void addFunction(Symbol id, Function *function) {
 			TRACE;
+			addIndex(id);
 			// if the function is already declared -- ok;
 			// should check that the amount of arguments is the same
 			// and that their types are equal
-			if (_declarationMask.find(id) != _declarationMask.end()) {
+			if (_declarationMask.contains(id)) {
 				Function *saved = _functions[id];
 
 				if (saved->isEqualInterface(function) == false) {
-					throw ParserException(fmt("Function %s is already declared with the other interface", id.c_str()));
+					throw ParserException(fmt("Function %s is already declared with the other interface", function->getName().c_str()));
 				}
 				bool savedDeclaration = _declarationMask[id];
 				if (savedDeclaration) {
@@ -198,7 +232,7 @@ class Program {
 					_declarationMask[id] = false;
 				} else {
 					// can have function defined multiple times
-					throw ParserException(fmt("Function %s is already defined", id.c_str()));
+					throw ParserException(fmt("Function %s is already defined", function->getName().c_str()));
 				}
 			} else {
 				_functions[id] = function;
@@ -206,819 +240,1123 @@ class Program {
 			}
 		}
 
-		static Function *getFunction(std::string id) {
+		// forgets all the functions and markers, e.g. to generate the code once more;
+		// markers are numbered for the whole program again
+		void clear() {
+			for (size_t i = 0; i < _functions.getCapacity(); ++i) {
+				if (_functions.getKey(i) != NO_SYMBOL) {
+					delete _functions.getValue(i);
+				}
+			}
+			_functions.clear();
+			_declarationMask.clear();
+			_marker_counter = 0;
+			_funcdef_count = 0;
+			_first_index.clear();
+			_local_markers = false;
+			_register_allocation = false;
+		}
+
+		Function *getFunction(Symbol id) {
 			TRACE;
 
-			if (_functions.find(id) != _functions.end()) {
-				return _functions[id];
-			} else {
+			Function **function = _functions.find(id);
+			return function != NULL ? *function : NULL;
+		}
+
+		// as seen from the body of caller: only the functions added before
+		// it or by it, even if all of them are added before the bodies
+		// are generated (see generateProgramParallel())
+		Function *getFunction(Symbol id, const Function *caller) {
+			TRACE;
+
+			const int *index = _first_index.find(id);
+			if (index == NULL || *index > caller->getIndex()) {
 				return NULL;
 			}
+			return getFunction(id);
+		}
+
+		// number of functions added so far, i.e. the index of the next one
+		int getFunctionCount() const {
+			return _funcdef_count;
+		}
+
+		// .M000, .M001, ... for the whole program
+		std::string getNextMarker() {
+			return fmt(".M%03d", _marker_counter++);
+		}
+
+		// with true markers of the functions added later are numbered per
+		// function (.F<index>.M000, ...), so they do not depend on the
+		// order the functions are generated in
+		void setLocalMarkers(bool local) {
+			_local_markers = local;
+		}
+
+		bool hasLocalMarkers() const {
+			return _local_markers;
+		}
+
+		void setRegisterAllocation(bool allocate) {
+			_register_allocation = allocate;
+		}
+
+		bool hasRegisterAllocation() const {
+			return _register_allocation;
 		}
 };
 
+inline Function::Function(Program &program, std::string type, std::string name):
+	_program(&program),
+	_type(type),
+	_name(name),
+	_parameters_count(0),
+	_index(program.getFunctionCount()),
+	_marker_counter(0),
+	// 4 bytes for return address
+	// 4 bytes for the saved ebp
+	_max_parameters_offset(8),
+	_max_local_variable_offset(-4)
+{
+	TRACE;
+	_endMarker = getNextMarker();
+}
+
+inline std::string Function::getNextMarker() {
+	if (_program->hasLocalMarkers()) {
+		return fmt(".F%d.M%03d", _index, _marker_counter++);
+	}
+	return _program->getNextMarker();
+}
+
+/*
+ * Kind of a syntax tree node, one per Node class. Generators check their
+ * children with ASSERT_KIND and generateNode() dispatches on the kind.
+ */
+enum NodeKind {
+	NODE_TYPE,
+	NODE_ID,
+	NODE_FUNCARGS,
+	NODE_FUNCARG,
+	NODE_STATEMENTS,
+	NODE_FUNCDEF,
+	NODE_PROGRAM,
+	NODE_READ,
+	NODE_RETURN,
+	NODE_PRINT,
+	NODE_NEGATION,
+	NODE_BINARY,
+	NODE_INTEGER,
+	NODE_ASSIGNMENT,
+	NODE_DECLARATION,
+	NODE_BATOM,
+	NODE_BCONJ_REST,
+	NODE_BDISJ,
+	NODE_BDISJ_REST,
+	NODE_BEXPRESSION,
+	NODE_IF,
+	NODE_FOR,
+	NODE_WHILE,
+	NODE_FUNCALL,
+	NODE_FUNCALLARG,
+	NODE_BCONJ,
+	NODE_CMP_LESS,
+	NODE_CMP_GREATER,
+	NODE_CMP_LESS_OR_EQUAL,
+	NODE_CMP_GREATER_OR_EQUAL,
+	NODE_CMP_EQUAL,
+	NODE_CMP_NOT_EQUAL,
+	NODE_TRUE,
+	NODE_FALSE,
+	NODE_NOT,
+	NODE_KIND_COUNT
+};
+
+// XML element of the kind
+const char *getNodeKindName(NodeKind kind);
+
+#define ASSERT_KIND(K,X) assert((X).getKind() == (K))
+
+inline bool isExpressionKind(NodeKind kind) {
+	return kind == NODE_BINARY || kind == NODE_NEGATION
+		|| kind == NODE_INTEGER || kind == NODE_ID || kind == NODE_FUNCALL;
+}
+
+#define ASSERT_EXPRESSION(X) assert(isExpressionKind((X).getKind()))
+
+/*
+ * Binary operators of the expressions, see binaryOperators in Parser.cpp.
+ * All of them are left-associative; higher precedence binds tighter.
+ * instruction computes the result in place of the left operand, except
+ * for / and % (see ExpressionGenerator).
+ */
+struct BinaryOperator {
+	Tokenizer::ValueType token;
+	const char *name;
+	int precedence;
+	const char *instruction;
+
+	bool isDivision() const {
+		return token == Tokenizer::T_DIV || token == Tokenizer::T_MOD;
+	}
+};
+
+// NULL if the token or the name is not a binary operator
+const BinaryOperator *findBinaryOperator(Tokenizer::ValueType token);
+const BinaryOperator *findBinaryOperator(StringRef name);
+
+/*
+ * Operators of one precedence make a left-deep chain: a + b - c is
+ * (a + b) - c, so the left spine of a chain is as deep as the chain is
+ * long and is walked with a loop rather than by recursion. The binary
+ * nodes of the spine are appended to spine from the top one down and the
+ * leftmost operand is returned; the order of the recursion is the
+ * leftmost operand, then spine from the back with the right operand and
+ * the operation of each node. Ref is NodePtr or FlatRef.
+ */
+template <class Ref>
+Ref collectSpine(Ref chain, std::vector<Ref> &spine) {
+	for (; chain.getKind() == NODE_BINARY; chain = chain.get(0)) {
+		spine.push_back(chain);
+	}
+	return chain;
+}
+
+// value of an integer literal as the assembler reads it: octal if it
+// starts with 0, wrapped to 32 bits; false if it is not a number there.
+// Folded constants may be negative, so a leading minus is taken too
+bool parseInteger(StringRef literal, int &value);
+
 class Node;
+class NodePtr;
+class FlatRef;
+
+template <class Ref>
+std::string buildXMLTree(Ref root, int level = 0);
 std::string buildXMLTree(Node *root, int level = 0);
+template <class Ref>
+size_t countNodes(Ref root);
+size_t countNodes(Node *root);
+
+// code of a statement or an expression and its subtree in a function;
+// Ref is NodePtr or FlatRef
+template <class Ref>
+void generateNode(Ref node, Function *context, CodeBuffer &code);
+// code of an expression that leaves its value in %eax
+template <class Ref>
+void generateExpression(Ref node, Function *context, CodeBuffer &code);
+// code of the whole program; its functions are added to program
+template <class Ref>
+void generateProgram(Ref root, Program &program, CodeBuffer &code);
+// the same with the function bodies generated on jobs threads; markers
+// are numbered per function, so the code is the same for any jobs
+template <class Ref>
+void generateProgramParallel(Ref root, Program &program, CodeBuffer &code, int jobs);
+// code of a function definition through the IR with its variables and
+// temporaries in registers (see IrBuilder.cpp and RegisterAllocator)
+template <class Ref>
+void generateBodyWithRegisters(Ref node, Function *context, CodeBuffer &code);
+// replaces the constant expressions and conditions of the tree with their
+// values (see ConstantFolding.cpp); new nodes are allocated in arena
+void foldConstants(Node *root, Arena &arena);
 
 
 #define PARSER_EXPECTED(expected) \
 	ParserException(\
 			fmt("Failed on %d:%d: expected %s", \
-				_tokenizer->getLineNumber(), \
-				_tokenizer->getLinePosition(), \
-				_tokenizer->getTokenDescription(expected).c_str()))
+				getLineNumber(), \
+				getLinePosition(), \
+				Tokenizer::getTokenDescription(expected).c_str()))
 
 #define PARSER_ILLEGAL \
 	ParserException(\
 			fmt("Failed on %d:%d: illegal token %s", \
-				_tokenizer->getLineNumber(), \
-				_tokenizer->getLinePosition(), \
-				_tokenizer->getTokenDescription(_tokenizer->getToken()).c_str()))
-
+				getLineNumber(), \
+				getLinePosition(), \
+				Tokenizer::getTokenDescription(getToken()).c_str()))
+
+/*
+ * Nodes, their tags and child arrays are allocated in the Arena of the
+ * Parser (new (arena) IfNode()) and are freed with it, never one by one.
+ *
+ * The classes only build the tree: code is generated by their static
+ * generate(Ref node, ...) templates, which read the tree through NodePtr
+ * or through FlatRef (see FlatTree), so both give the same assembly.
+ */
 class Node {
 	private:
-		std::string _tag;
-		std::vector<Node*> _children;
-
-		virtual std::string _getDefaultXMLTag() const = 0;
+		NodeKind _kind;
+		unsigned _children_count;
+		unsigned _children_capacity;
+		// of the name for ids
+		Symbol _symbol;
+		StringRef _tag;
+		Node **_children;
 	public:
-		typedef std::vector<Node *>::iterator node_iterator;
+		typedef Node **node_iterator;
+
+		static void *operator new(size_t size, Arena &arena) {
+			return arena.allocate(size);
+		}
 
-		Node(std::string tag = "") :
-			_tag(tag) {
+		// only if a constructor throws; the memory stays in the arena
+		static void operator delete(void *, Arena &) {
+		}
+
+		// tag must be owned by the arena, the SymbolPool or be static
+		Node(NodeKind kind, StringRef tag = StringRef(), Symbol symbol = NO_SYMBOL) :
+			_kind(kind),
+			_children_count(0),
+			_children_capacity(0),
+			_symbol(symbol),
+			_tag(tag),
+			_children(NULL) {
 			}
 
+		NodeKind getKind() const {
+			return _kind;
+		}
+
 		std::string getTag() const {
+			return _tag.str();
+		}
+
+		StringRef getTagRef() const {
 			return _tag;
 		}
 
-		void addChild(Node *node) {
-			_children.push_back(node);
+		Symbol getSymbol() const {
+			return _symbol;
+		}
+
+		void addChild(Node *node, Arena &arena) {
+			if (_children_count == _children_capacity) {
+				unsigned capacity = _children_capacity ? 2 * _children_capacity : 2;
+				Node **children = arena.allocateArray<Node *>(capacity);
+				std::copy(_children, _children + _children_count, children);
+				_children = children;
+				_children_capacity = capacity;
+			}
+			_children[_children_count++] = node;
 		}
 
 		node_iterator begin() {
-			return _children.begin();
+			return _children;
 		}
 
 		node_iterator end() {
-			return _children.end();
+			return _children + _children_count;
 		}
 
 		int childrenCount() const {
-			return _children.size();
+			return _children_count;
 		}
 
 		Node *get(int index) const {
 			return _children[index];
 		}
 
+		void set(int index, Node *node) {
+			_children[index] = node;
+		}
+
 		void clear() {
-			_children.clear();
+			_children_count = 0;
 		}
+};
 
-		virtual ~Node() {
-			for (Node::node_iterator it = this->begin();
-					it != this->end(); ++it) {
-				Node *node = *it;
-				delete node;
-			}
+// Node * as a value with the interface of FlatRef
+class NodePtr {
+	private:
+		Node *_node;
+	public:
+		explicit NodePtr(Node *node) : _node(node) {
 		}
 
-		virtual std::string XMLStart() const {
-			std::string XMLTag = _getDefaultXMLTag(),
-				tag = getTag(),
-				xml;
+		NodeKind getKind() const {
+			return _node->getKind();
+		}
 
-			if (tag.length() == 0) {
-				xml = "<" + XMLTag + ">";
-			} else {
-				xml = "<" + XMLTag + ">" + tag + "</" + XMLTag + ">";
-			}
+		std::string getTag() const {
+			return _node->getTag();
+		}
 
-			return xml;
+		StringRef getTagRef() const {
+			return _node->getTagRef();
 		}
 
-		virtual std::string XMLEnd() const {
-			std::string XMLTag = _getDefaultXMLTag(),
-				tag = getTag(),
-				xml;
+		Symbol getSymbol() const {
+			return _node->getSymbol();
+		}
 
-			if (tag.length() == 0) {
-				xml = "</" + XMLTag + ">";
-			} else {
-				xml = "";
-			}
+		int childrenCount() const {
+			return _node->childrenCount();
+		}
 
-			return xml;
+		NodePtr get(int index) const {
+			return NodePtr(_node->get(index));
 		}
 
-		virtual std::string generate(Function *context) {
-			return "<" + _getDefaultXMLTag() + ">\n"; 
+		Node *getNode() const {
+			return _node;
 		}
 };
 
-
-class TypeNode: public Node {
+/*
+ * The syntax tree copied into one array. Nodes are stored level by
+ * level, so the children of a node are next to each other and a node
+ * keeps only the index of the first one and their count. Tags of all
+ * the nodes are kept in one string; a node has its offset and length.
+ *
+ * 20 bytes per node instead of 40 bytes plus the child array for Node.
+ */
+class FlatTree {
+	public:
+		struct FlatNode {
+			unsigned kind : 8;
+			unsigned children_count : 24;
+			unsigned first_child;
+			unsigned tag_offset;
+			unsigned tag_length;
+			Symbol symbol;
+		};
 	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "type";
-		}
+		std::vector<FlatNode> _nodes;
+		std::string _text;
+
+		FlatTree(const FlatTree &);
+		FlatTree &operator=(const FlatTree &);
 	public:
-		TypeNode(std::string tag): Node(tag) {}
-};
+		explicit FlatTree(Node *root);
 
+		size_t size() const {
+			return _nodes.size();
+		}
 
-class IdNode: public Node {
-	public:
-		IdNode(std::string id):
-			Node(id) {}
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "id";
+		const FlatNode &node(size_t index) const {
+			return _nodes[index];
 		}
-	public:
-		virtual std::string generate(Function *context) {
-			TRACE;
 
-			assert(context != NULL);
-			assert(childrenCount() == 0);
+		StringRef getTagRef(size_t index) const {
+			const FlatNode &node = _nodes[index];
+			return StringRef(_text.data() + node.tag_offset, node.tag_length);
+		}
 
-			std::string id = getTag();
-			int offset = context->getVariableOffset(id);
-			std::string code;
-			code += fmt(
-					"# id %s\n"
-					"    pushl %d(%%ebp)\n",
-					id.c_str(), offset);
-			return code;
+		// memory taken by the nodes and the tags
+		size_t getBytesUsed() const {
+			return _nodes.capacity() * sizeof (FlatNode) + _text.capacity();
 		}
 
+		FlatRef getRoot() const;
 };
 
-class FuncargsNode: public Node {
+// node of a FlatTree; the tree must outlive it
+class FlatRef {
 	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "funcargs";
+		const FlatTree *_tree;
+		unsigned _index;
+	public:
+		FlatRef(const FlatTree *tree, unsigned index) :
+			_tree(tree),
+			_index(index) {
 		}
-};
 
-class FuncargNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "funarg";
+		NodeKind getKind() const {
+			return static_cast<NodeKind> (_tree->node(_index).kind);
 		}
-};
 
+		std::string getTag() const {
+			return _tree->getTagRef(_index).str();
+		}
 
-class StatementsNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "statements";
+		StringRef getTagRef() const {
+			return _tree->getTagRef(_index);
 		}
-	public:
-		virtual std::string generate(Function *context) {
-			TRACE;
 
-			std::string code;
-			assert(context != NULL);
-			for (int i = 0; i < childrenCount(); ++i) {
-				code += get(i)->generate(context);
-			}
-			return code;
+		Symbol getSymbol() const {
+			return _tree->node(_index).symbol;
 		}
-};
 
-class FuncdefNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "funcdef";
+		int childrenCount() const {
+			return _tree->node(_index).children_count;
+		}
+
+		FlatRef get(int index) const {
+			return FlatRef(_tree, _tree->node(_index).first_child + index);
 		}
+};
 
+inline FlatRef FlatTree::getRoot() const {
+	return FlatRef(this, 0);
+}
+
+/*
+ * Base of a pass over the syntax tree: visit() calls the visitXxx method
+ * of the node's kind. Every visitXxx calls visitNode, which visits the
+ * children, so a pass overrides only the kinds it is interested in and
+ * calls visitChildren() where it has to go deeper. Ref is NodePtr or
+ * FlatRef, so a pass runs on both trees. A pass that goes through
+ * expressions loops over the left spine of a chain in visitBinary instead
+ * (see collectSpine and XMLBuilder).
+ */
+template <class Ref>
+class NodeVisitor {
 	public:
-		virtual std::string generate(Function *context_outer) {
-			TRACE;
+		virtual ~NodeVisitor() {
+		}
+
+		void visit(Ref node) {
+			switch (node.getKind()) {
+				case NODE_TYPE:
+					visitType(node);
+					break;
+				case NODE_ID:
+					visitId(node);
+					break;
+				case NODE_FUNCARGS:
+					visitFuncargs(node);
+					break;
+				case NODE_FUNCARG:
+					visitFuncarg(node);
+					break;
+				case NODE_STATEMENTS:
+					visitStatements(node);
+					break;
+				case NODE_FUNCDEF:
+					visitFuncdef(node);
+					break;
+				case NODE_PROGRAM:
+					visitProgram(node);
+					break;
+				case NODE_READ:
+					visitRead(node);
+					break;
+				case NODE_RETURN:
+					visitReturn(node);
+					break;
+				case NODE_PRINT:
+					visitPrint(node);
+					break;
+				case NODE_NEGATION:
+					visitNegation(node);
+					break;
+				case NODE_BINARY:
+					visitBinary(node);
+					break;
+				case NODE_INTEGER:
+					visitInteger(node);
+					break;
+				case NODE_ASSIGNMENT:
+					visitAssignment(node);
+					break;
+				case NODE_DECLARATION:
+					visitDeclaration(node);
+					break;
+				case NODE_BATOM:
+					visitBAtom(node);
+					break;
+				case NODE_BCONJ_REST:
+					visitBConjRest(node);
+					break;
+				case NODE_BDISJ:
+					visitBdisj(node);
+					break;
+				case NODE_BDISJ_REST:
+					visitBDisjRest(node);
+					break;
+				case NODE_BEXPRESSION:
+					visitBexpression(node);
+					break;
+				case NODE_IF:
+					visitIf(node);
+					break;
+				case NODE_FOR:
+					visitFor(node);
+					break;
+				case NODE_WHILE:
+					visitWhile(node);
+					break;
+				case NODE_FUNCALL:
+					visitFuncall(node);
+					break;
+				case NODE_FUNCALLARG:
+					visitFuncallarg(node);
+					break;
+				case NODE_BCONJ:
+					visitBconj(node);
+					break;
+				case NODE_CMP_LESS:
+					visitCmpLess(node);
+					break;
+				case NODE_CMP_GREATER:
+					visitCmpGreater(node);
+					break;
+				case NODE_CMP_LESS_OR_EQUAL:
+					visitCmpLessOrEqual(node);
+					break;
+				case NODE_CMP_GREATER_OR_EQUAL:
+					visitCmpGreaterOrEqual(node);
+					break;
+				case NODE_CMP_EQUAL:
+					visitCmpEqual(node);
+					break;
+				case NODE_CMP_NOT_EQUAL:
+					visitCmpNotEqual(node);
+					break;
+				case NODE_TRUE:
+					visitTrue(node);
+					break;
+				case NODE_FALSE:
+					visitFalse(node);
+					break;
+				case NODE_NOT:
+					visitNot(node);
+					break;
+				default:
+					assert(false);
+			}
+		}
 
-			assert(context_outer == NULL);
-			// 0 type_int -- return type (by now int only)
-			ASSERT_TYPE(TypeNode*, get(0));
-			std::string type = get(0)->getTag();
-			assert("int" == type);
-			// 1 id
-			ASSERT_TYPE(IdNode*, get(1));
-			std::string id = get(1)->getTag();
+		void visitChildren(Ref node) {
+			for (int i = 0; i < node.childrenCount(); ++i) {
+				visit(node.get(i));
+			}
+		}
 
-			Function *context = new Function(type, id);
+		virtual void visitNode(Ref node) {
+			visitChildren(node);
+		}
 
-			// 2 funcargs -> funcarg*
-			ASSERT_TYPE(FuncargsNode*, get(2));
-			for(int i = 0; i < get(2)->childrenCount(); ++i) {
-				Node *child = get(2)->get(i);
-				ASSERT_TYPE(FuncargNode*, child);
-				ASSERT_TYPE(TypeNode*, child->get(0));
-				ASSERT_TYPE(IdNode*, child->get(1));
-				std::string type = child->get(0)->getTag();
-				assert("int" == type);
-				std::string id = child->get(1)->getTag();
+		virtual void visitType(Ref node) {
+			visitNode(node);
+		}
 
-				context->addParameter(type, id);
-			}
+		virtual void visitId(Ref node) {
+			visitNode(node);
+		}
 
-			// 3 statements or none if it was a function declaration
-			if (childrenCount() == 4) {
-				ASSERT_TYPE(StatementsNode*, get(3));
-				Program::addFunction(id, context);
-
-				std::string code;
-				code += fmt(
-						".globl %s\n"
-						"%s:\n"
-						"    pushl %%ebp\n"
-						"    movl %%esp, %%ebp\n",
-						id.c_str(), id.c_str());
-
-				code += get(3)->generate(context);
-
-				code += fmt(
-						"# epilogue\n"
-						"%s:\n"
-						"    movl %%ebp, %%esp\n"
-						"    popl %%ebp\n"
-						"    ret\n",
-						context->getEndMarker().c_str());
-				return code;
-			} else {
-				// declaration produces no code but saves meta-information
-				Program::addDeclaration(id, context);
-				return "";
-			}
+		virtual void visitFuncargs(Ref node) {
+			visitNode(node);
 		}
-};
 
-class ProgramNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "program";
+		virtual void visitFuncarg(Ref node) {
+			visitNode(node);
 		}
 
-		virtual std::string generate(Function *context) {
-			TRACE;
+		virtual void visitStatements(Ref node) {
+			visitNode(node);
+		}
 
-			assert(context == NULL);
+		virtual void visitFuncdef(Ref node) {
+			visitNode(node);
+		}
 
-			std::string code;
-			code += fmt(
-					".READFORMAT:\n"
-					"    .string \"%%d\"\n"
-					".PRINTFORMAT:\n"
-					"    .string \"%%d\\n\"\n"
-					);
+		virtual void visitProgram(Ref node) {
+			visitNode(node);
+		}
 
-			for(node_iterator it = this->begin();
-					it != this->end(); ++it) {
-				Node *child = *it;
-				ASSERT_TYPE(FuncdefNode*, child);
-				code += child->generate(NULL);
-			}
+		virtual void visitRead(Ref node) {
+			visitNode(node);
+		}
 
-			return code;
+		virtual void visitReturn(Ref node) {
+			visitNode(node);
 		}
-};
 
+		virtual void visitPrint(Ref node) {
+			visitNode(node);
+		}
 
+		virtual void visitNegation(Ref node) {
+			visitNode(node);
+		}
 
-class ReadNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "read";
+		virtual void visitBinary(Ref node) {
+			visitNode(node);
 		}
-	public:
-		virtual std::string generate(Function *context) {
-			TRACE;
 
-			assert(context != NULL);
+		virtual void visitInteger(Ref node) {
+			visitNode(node);
+		}
 
-			ASSERT_TYPE(IdNode*, get(0));
-			std::string id = get(0)->getTag();
+		virtual void visitAssignment(Ref node) {
+			visitNode(node);
+		}
 
-			int offset = context->getVariableOffset(id);
+		virtual void visitDeclaration(Ref node) {
+			visitNode(node);
+		}
 
-			std::string code;
-			code += fmt(
-					"# read %s\n"
-					"    leal %d(%%ebp), %%eax\n"
-					"    pushl %%eax\n"
-					"    pushl $.READFORMAT\n"
-					"    call scanf\n"
-					"    addl $8, %%esp\n",
-					id.c_str(), offset);
+		virtual void visitBAtom(Ref node) {
+			visitNode(node);
+		}
 
+		virtual void visitBConjRest(Ref node) {
+			visitNode(node);
+		}
 
-			return code;
+		virtual void visitBdisj(Ref node) {
+			visitNode(node);
 		}
-};
 
+		virtual void visitBDisjRest(Ref node) {
+			visitNode(node);
+		}
 
-class AtomNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "atom";
+		virtual void visitBexpression(Ref node) {
+			visitNode(node);
 		}
-	public:
-		virtual std::string generate(Function *context) {
-			TRACE;
 
-			assert(context != NULL);
-			assert(childrenCount() == 1);
+		virtual void visitIf(Ref node) {
+			visitNode(node);
+		}
 
-			std::string code;
-			code += fmt(
-					"# atom\n"
-					);
-			code += get(0)->generate(context);
+		virtual void visitFor(Ref node) {
+			visitNode(node);
+		}
 
-			return code;
+		virtual void visitWhile(Ref node) {
+			visitNode(node);
 		}
-};
 
-class multNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "mult";
+		virtual void visitFuncall(Ref node) {
+			visitNode(node);
 		}
-	public:
-		virtual std::string generate(Function *context) {
-			TRACE;
 
-			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
+		virtual void visitFuncallarg(Ref node) {
+			visitNode(node);
+		}
 
-			std::string code;
-			code += fmt(
-					"# multNode\n"
-					);
-			if (childrenCount() == 1) {
-				ASSERT_TYPE(AtomNode*, get(0));
-				code += get(0)->generate(context);
-			} else {
-				ASSERT_TYPE(AtomNode*, get(0));
-				code += get(0)->generate(context);
-				// MultMultNode, ModMultNode, DivMultNode
-				code += get(1)->generate(context);
-			}
+		virtual void visitBconj(Ref node) {
+			visitNode(node);
+		}
 
+		virtual void visitCmpLess(Ref node) {
+			visitNode(node);
+		}
 
-			return code;
+		virtual void visitCmpGreater(Ref node) {
+			visitNode(node);
 		}
-};
 
+		virtual void visitCmpLessOrEqual(Ref node) {
+			visitNode(node);
+		}
 
-class termNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "term";
+		virtual void visitCmpGreaterOrEqual(Ref node) {
+			visitNode(node);
 		}
-	public:
-		virtual std::string generate(Function *context) {
-			TRACE;
 
-			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
+		virtual void visitCmpEqual(Ref node) {
+			visitNode(node);
+		}
 
-			std::string code;
-			code += fmt(
-					"# termNode\n"
-					);
-			if (childrenCount() == 1) {
-				ASSERT_TYPE(multNode*, get(0));
-				code += get(0)->generate(context);
-			} else {
-				ASSERT_TYPE(multNode*, get(0));
-				code += get(0)->generate(context);
-				// MultMultNode, ModMultNode, DivMultNode
-				code += get(1)->generate(context);
-			}
+		virtual void visitCmpNotEqual(Ref node) {
+			visitNode(node);
+		}
 
-			return code;
+		virtual void visitTrue(Ref node) {
+			visitNode(node);
 		}
-};
 
-class ExpressionNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "expression";
+		virtual void visitFalse(Ref node) {
+			visitNode(node);
 		}
+
+		virtual void visitNot(Ref node) {
+			visitNode(node);
+		}
+};
+
+class TypeNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		TypeNode(StringRef tag): Node(NODE_TYPE, tag) {}
+};
+
+
+class IdNode: public Node {
+	public:
+		// name is kept by the SymbolPool of the tokens
+		IdNode(StringRef name, Symbol symbol):
+			Node(NODE_ID, name, symbol) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-
-			std::string code;
-			code += fmt(
-					"# expression\n"
-					);
-			if (childrenCount() == 1) {
-				ASSERT_TYPE(termNode*, get(0));
-				code += get(0)->generate(context);
-			} else {
-				ASSERT_TYPE(termNode*, get(0));
-				code += get(0)->generate(context);
-				// PlusTermNode or MinusTermNode
-				code += get(1)->generate(context);
-			} 
+			assert(node.childrenCount() == 0);
 
-			return code;
+			StringRef id = node.getTagRef();
+			int offset = context->getVariableOffset(node.getSymbol(), id);
+			code.format(
+					"# id %.*s\n"
+					"    pushl %d(%%ebp)\n",
+					(int) id.length(), id.data(), offset);
 		}
+
 };
 
-class ReturnNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "return";
-		}
+class FuncargsNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		FuncargsNode(): Node(NODE_FUNCARGS) {}
+};
+
+class FuncargNode: public Node {
+	public:
+		FuncargNode(): Node(NODE_FUNCARG) {}
+};
+
+
+class StatementsNode: public Node {
+	public:
+		StatementsNode(): Node(NODE_STATEMENTS) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 1);
-			ASSERT_TYPE(ExpressionNode*, get(0));
+			for (int i = 0; i < node.childrenCount(); ++i) {
+				generateNode(node.get(i), context, code);
+			}
+		}
+};
 
-			std::string code;
-			code += fmt(
-					"# return\n"
-					);
-			code += get(0)->generate(context);
-			// the result of the expression on the top of the stack
-			// no need to move anything
+class FuncdefNode: public Node {
+	public:
+		FuncdefNode(): Node(NODE_FUNCDEF) {}
 
-			code += fmt(
-					"    popl %%eax\n"
-					"    jmp %s\n",
-					context->getEndMarker().c_str());
+		template <class Ref>
+		static void generate(Ref node, Program &program, CodeBuffer &code) {
+			TRACE;
 
-			return code;
+			Function *context = declare(node, program);
+			if (context != NULL) {
+				generateBody(node, context, code);
+			}
 		}
-};
 
-class PrintNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "print";
+		// adds the function to the program; returns it if the node is
+		// a definition, NULL for a declaration
+		template <class Ref>
+		static Function *declare(Ref node, Program &program) {
+			TRACE;
+
+			// 0 type_int -- return type (by now int only)
+			ASSERT_KIND(NODE_TYPE, node.get(0));
+			std::string type = node.get(0).getTag();
+			assert("int" == type);
+			// 1 id
+			ASSERT_KIND(NODE_ID, node.get(1));
+			std::string id = node.get(1).getTag();
+			Symbol symbol = node.get(1).getSymbol();
+
+			Function *context = new Function(program, type, id);
+
+			// 2 funcargs -> funcarg*
+			ASSERT_KIND(NODE_FUNCARGS, node.get(2));
+			for(int i = 0; i < node.get(2).childrenCount(); ++i) {
+				Ref child = node.get(2).get(i);
+				ASSERT_KIND(NODE_FUNCARG, child);
+				ASSERT_KIND(NODE_TYPE, child.get(0));
+				ASSERT_KIND(NODE_ID, child.get(1));
+				std::string type = child.get(0).getTag();
+				assert("int" == type);
+				context->addParameter(child.get(1).getSymbol(),
+						child.get(1).getTagRef());
+			}
+
+			// 3 statements or none if it was a function declaration
+			if (node.childrenCount() == 4) {
+				program.addFunction(symbol, context);
+				return context;
+			} else {
+				// declaration produces no code but saves meta-information
+				program.addDeclaration(symbol, context);
+				return NULL;
+			}
 		}
-	public:
-		virtual std::string generate(Function *context) {
+
+		// code of a definition added by declare()
+		template <class Ref>
+		static void generateBody(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
-			assert(context != NULL);
-			assert(childrenCount() == 1);
-			ASSERT_TYPE(ExpressionNode*, get(0));
+			assert(node.childrenCount() == 4);
+			ASSERT_KIND(NODE_STATEMENTS, node.get(3));
+			if (context->getProgram().hasRegisterAllocation()) {
+				generateBodyWithRegisters(node, context, code);
+				return;
+			}
+			std::string id = context->getName();
 
-			std::string code;
-			code += fmt(
-					"# print\n"
-					);
-			code += get(0)->generate(context);
-			// the result of the expression on the top of the stack
-			// no need to move anything
-			code += fmt(
-					"    pushl $.PRINTFORMAT\n"
-					"    call printf\n"
-					"    subl $8, %%esp\n"
-					);
+			code.format(
+					".globl %s\n"
+					"%s:\n"
+					"    pushl %%ebp\n"
+					"    movl %%esp, %%ebp\n",
+					id.c_str(), id.c_str());
 
-			return code;
+			generateNode(node.get(3), context, code);
+
+			code.format(
+					"# epilogue\n"
+					"%s:\n"
+					"    movl %%ebp, %%esp\n"
+					"    popl %%ebp\n"
+					"    ret\n",
+					context->getEndMarker().c_str());
 		}
 };
 
-class NegationNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "negation";
-		}
+class ProgramNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		ProgramNode(): Node(NODE_PROGRAM) {}
+
+		template <class Ref>
+		static void generate(Ref node, Program &program, CodeBuffer &code) {
 			TRACE;
 
-			assert(context != NULL);
-			assert((childrenCount() == 1));
-			ASSERT_TYPE(AtomNode*, get(0));
+			generateHeader(code);
 
-			std::string code;
-			code += fmt(
-					"# negation\n"
-					);
-			code += get(0)->generate(context);
-			code += fmt(
-					"    popl %%eax\n"
-					"    imull $-1, %%eax\n"
-					"    pushl %%eax\n"
-					);
+			for (int i = 0; i < node.childrenCount(); ++i) {
+				Ref child = node.get(i);
+				ASSERT_KIND(NODE_FUNCDEF, child);
+				FuncdefNode::generate(child, program, code);
+			}
+		}
 
-			return code;
+		// formats for scanf and printf, before the functions
+		static void generateHeader(CodeBuffer &code) {
+			code.format(
+					".READFORMAT:\n"
+					"    .string \"%%d\"\n"
+					".PRINTFORMAT:\n"
+					"    .string \"%%d\\n\"\n"
+					);
 		}
 };
 
-class PlusTermNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "plusterm";
-		}
+
+
+class ReadNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		ReadNode(): Node(NODE_READ) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-			ASSERT_TYPE(termNode*, get(0));
 
-			std::string code;
-			code += fmt(
-					"# plusterm\n"
-					);
-			code += get(0)->generate(context);
-			code += fmt(
-					"    popl %%eax\n"
-					"    popl %%ecx\n"
-					"    addl %%eax, %%ecx\n"
-					"    pushl %%ecx\n"
-					);
+			ASSERT_KIND(NODE_ID, node.get(0));
+			StringRef id = node.get(0).getTagRef();
 
-			if (childrenCount() == 2) {
-				code += get(1)->generate(context);
-			}
+			int offset = context->getVariableOffset(node.get(0).getSymbol(), id);
+
+			code.format(
+					"# read %.*s\n"
+					"    leal %d(%%ebp), %%eax\n"
+					"    pushl %%eax\n"
+					"    pushl $.READFORMAT\n"
+					"    call scanf\n"
+					"    addl $8, %%esp\n",
+					(int) id.length(), id.data(), offset);
 
-			return code;
 		}
 };
 
-class MinusTermNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "minusterm";
-		}
+
+class ReturnNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		ReturnNode(): Node(NODE_RETURN) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-			ASSERT_TYPE(termNode*, get(0));
+			assert(node.childrenCount() == 1);
+			ASSERT_EXPRESSION(node.get(0));
 
-			std::string code;
-			code += fmt(
-					"# minusterm\n"
-					);
-			code += get(0)->generate(context);
-			code += fmt(
-					"    popl %%eax\n"
-					"    popl %%ecx\n"
-					"    subl %%eax, %%ecx\n"
-					"    pushl %%ecx\n"
+			code.format(
+					"# return\n"
 					);
-
-			if (childrenCount() == 2) {
-				code += get(1)->generate(context);
-			}
-
-			return code;
+			generateExpression(node.get(0), context, code);
+			code.format(
+					"    jmp %s\n",
+					context->getEndMarker().c_str());
 		}
 };
 
-class MultMultNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "multmult";
-		}
+class PrintNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		PrintNode(): Node(NODE_PRINT) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-			ASSERT_TYPE(AtomNode*, get(0));
+			assert(node.childrenCount() == 1);
+			ASSERT_EXPRESSION(node.get(0));
 
-			std::string code;
-			code += fmt(
-					"# multmult\n"
+			code.format(
+					"# print\n"
 					);
-			code += get(0)->generate(context);
-			code += fmt(
-					"    popl %%eax\n"
-					"    popl %%ecx\n"
-					"    imull %%eax, %%ecx\n"
-					"    pushl %%ecx\n"
+			generateExpression(node.get(0), context, code);
+			code.format(
+					"    pushl %%eax\n"
+					"    pushl $.PRINTFORMAT\n"
+					"    call printf\n"
+					"    subl $8, %%esp\n"
 					);
-
-			if (childrenCount() == 2) {
-				code += get(1)->generate(context);
-			}
-
-			return code;
 		}
 };
 
-class ModMultNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "modmult";
-		}
+class NegationNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		NegationNode(): Node(NODE_NEGATION) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-			ASSERT_TYPE(AtomNode*, get(0));
+			assert((node.childrenCount() == 1));
+			ASSERT_EXPRESSION(node.get(0));
 
-			std::string code;
-			code += fmt(
-					"# modmult\n"
-					);
-			code += get(0)->generate(context);
-			code += fmt(
-					"    popl %%ecx\n"
-					"    popl %%eax\n"
-					"    movl %%eax, %%edx\n"
-					"    sarl $31, %%edx\n"
-					"    idivl %%ecx\n"
-					"    pushl %%edx\n"
+			generateExpression(node, context, code);
+			code.format(
+					"    pushl %%eax\n"
 					);
-
-			if (childrenCount() == 2) {
-				code += get(1)->generate(context);
-			}
-
-			return code;
 		}
 };
 
-class DivMultNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "divmult";
-		}
+/*
+ * Left operand, right operand and the operator name from binaryOperators
+ * as the tag.
+ */
+class BinaryNode: public Node {
 	public:
-		virtual std::string generate(Function *context) {
+		BinaryNode(const BinaryOperator *op):
+			Node(NODE_BINARY, StringRef(op->name, strlen(op->name))) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-			ASSERT_TYPE(AtomNode*, get(0));
+			assert(node.childrenCount() == 2);
+			ASSERT_EXPRESSION(node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			std::string code;
-			code += fmt(
-					"# divmult\n"
-					);
-			code += get(0)->generate(context);
-			code += fmt(
-					"    popl %%ecx\n"
-					"    popl %%eax\n"
-					"    movl %%eax, %%edx\n"
-					"    sarl $31, %%edx\n"
-					"    idivl %%ecx\n"
+			generateExpression(node, context, code);
+			code.format(
 					"    pushl %%eax\n"
 					);
-
-			if (childrenCount() == 2) {
-				code += get(1)->generate(context);
-			}
-
-			return code;
 		}
 };
 
 class IntegerNode: public Node {
 	public:
-		IntegerNode(std::string integer): Node(integer) {}
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "integer";
-		}
-	public:
-		virtual std::string generate(Function *context) {
+		IntegerNode(StringRef integer): Node(NODE_INTEGER, integer) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			std::string code;
-			code = fmt(
+			code.format(
 					"    pushl $%s\n",
-					getTag().c_str()
+					node.getTag().c_str()
 					);
-
-			return code;
 		}
 };
 
 class AssignmentNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "assignment";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		AssignmentNode(): Node(NODE_ASSIGNMENT) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
 
-			ASSERT_TYPE(IdNode*, get(0));
-			ASSERT_TYPE(ExpressionNode*, get(1));
+			ASSERT_KIND(NODE_ID, node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			std::string id = get(0)->getTag();
-			int offset = context->getVariableOffset(id);
+			StringRef id = node.get(0).getTagRef();
+			int offset = context->getVariableOffset(node.get(0).getSymbol(), id);
 
-			std::string code;
-			code += get(1)->generate(context);
-			code += fmt(
-					"# saving result of expression to %s\n"
-					"    popl %%eax\n"
+			generateExpression(node.get(1), context, code);
+			code.format(
+					"# saving result of expression to %.*s\n"
 					"    movl %%eax, %d(%%ebp)\n",
-					id.c_str(), offset);
-
-			return code;
+					(int) id.length(), id.data(), offset);
 		}
 };
 
 class DeclarationNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "declaration";
-		}
 	public:
-		std::string generate(Function *context) {
+		DeclarationNode(): Node(NODE_DECLARATION) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
 
-			ASSERT_TYPE(TypeNode*, get(0));
-			ASSERT_TYPE(IdNode*, get(1));
+			ASSERT_KIND(NODE_TYPE, node.get(0));
+			ASSERT_KIND(NODE_ID, node.get(1));
 
-			std::string type = get(0)->getTag();
-			std::string id = get(1)->getTag();
+			StringRef type = node.get(0).getTagRef();
+			StringRef id = node.get(1).getTagRef();
+			Symbol symbol = node.get(1).getSymbol();
 
-			context->addLocalVariable(type, id);
+			context->addLocalVariable(symbol, id);
 
-			int offset = context->getVariableOffset(id);
+			int offset = context->getVariableOffset(symbol, id);
 
-			std::string code;
-			code += fmt(
-					"# declaration %s %s offset %d\n"
+			code.format(
+					"# declaration %.*s %.*s offset %d\n"
 					"    subl $4, %%esp\n",
-					type.c_str(), id.c_str(), offset);
-
-			return code;
+					(int) type.length(), type.data(),
+					(int) id.length(), id.data(), offset);
 		}
 };
 
 class BAtomNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "batom";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		BAtomNode(): Node(NODE_BATOM) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 1);
+			assert(node.childrenCount() == 1);
 
-			std::string code;
-			code += fmt(
+			code.format(
 					"# batom\n"
 					);
 
-			code += get(0)->generate(context);
-			return code;
+			generateNode(node.get(0), context, code);
 		}
 };
 
 class BConjNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "bConj";
-		}
-	public: 
-		virtual std::string generate(Function *context) {
+	public:
+		BConjNode(): Node(NODE_BCONJ_REST) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 1 || childrenCount() == 2);
-			ASSERT_TYPE(BAtomNode*, get(0));
-			if (childrenCount() == 2) {
-				ASSERT_TYPE(BConjNode*, get(1));
-			}   
+			assert(node.childrenCount() == 1);
+			ASSERT_KIND(NODE_BATOM, node.get(0));
 
-			std::string code;
 
-			code += fmt(
+			code.format(
 					"# BConjNode\n"
 					);
-			code += get(0)->generate(context);
+			generateNode(node.get(0), context, code);
 
-			std::string ifElseMarker = getNextMarker();
-			std::string endifMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string endifMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    popl %%ecx\n"
 					"    subl %%ecx, %%eax\n"
@@ -1033,12 +1371,6 @@ class BConjNode: public Node {
 					endifMarker.c_str(),
 					ifElseMarker.c_str(),
 					endifMarker.c_str());
-
-			if (childrenCount() == 2) {
-				code += get(1)->generate(context);
-			}
-
-			return code;
 		}
 
 };
@@ -1046,362 +1378,278 @@ class BConjNode: public Node {
 
 
 class BdisjNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "bdisj";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		BdisjNode(): Node(NODE_BDISJ) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-			std::string code;
-			code += fmt(
+			assert(node.childrenCount() >= 1);
+			code.format(
 					"# BdisjNode\n"
 					);
-			if (childrenCount() == 1) {
-				ASSERT_TYPE(BAtomNode*, get(0));
-				code += get(0)->generate(context);
-			} else {
-				ASSERT_TYPE(BAtomNode*, get(0));
-				ASSERT_TYPE(BConjNode*, get(1));
-				code += get(0)->generate(context);
-				code += get(1)->generate(context);
-			} 
-			return code; 
+			ASSERT_KIND(NODE_BATOM, node.get(0));
+			generateNode(node.get(0), context, code);
+			// BConjNode for each operator
+			for (int i = 1; i < node.childrenCount(); ++i) {
+				ASSERT_KIND(NODE_BCONJ_REST, node.get(i));
+				generateNode(node.get(i), context, code);
+			}
 		}
 };
 
 
 class BDisjNode: public Node {
-	private:;
-			virtual std::string _getDefaultXMLTag() const {
-				return "bDisj";
-			}
-	public: 
-			virtual std::string generate(Function *context) {
-				TRACE;
+	public:
+		BDisjNode(): Node(NODE_BDISJ_REST) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
+			TRACE;
 
-				assert(context != NULL);
-				assert(childrenCount() == 1 || childrenCount() == 2);
-				ASSERT_TYPE(BdisjNode*, get(0));
-				if (childrenCount() == 2) {
-					ASSERT_TYPE(BDisjNode*, get(1));
-				}   
-
-				std::string code;
-
-				code += fmt(
-						"# BDisjNode\n"
-						);
-				code += get(0)->generate(context);
-
-				std::string ifElseMarker = getNextMarker();
-				std::string endifMarker = getNextMarker();
-				code += fmt(
-						"    popl %%eax\n"
-						"    popl %%ecx\n"
-						"    addl %%ecx, %%eax\n"
-						"    cmpl $0, %%eax\n"
-						"    je %s\n"
-						"    pushl $1\n"
-						"    jmp %s\n"
-						"%s:\n"
-						"    pushl $0\n"
-						"%s:\n",
-						ifElseMarker.c_str(),
-						endifMarker.c_str(),
-						ifElseMarker.c_str(),
-						endifMarker.c_str());
-
-				if (childrenCount() == 2) {
-					code += get(1)->generate(context);
-				}
+			assert(context != NULL);
+			assert(node.childrenCount() == 1);
+			ASSERT_KIND(NODE_BDISJ, node.get(0));
 
-				return code;
-			}
+
+			code.format(
+					"# BDisjNode\n"
+					);
+			generateNode(node.get(0), context, code);
+
+			std::string ifElseMarker = context->getNextMarker();
+			std::string endifMarker = context->getNextMarker();
+			code.format(
+					"    popl %%eax\n"
+					"    popl %%ecx\n"
+					"    addl %%ecx, %%eax\n"
+					"    cmpl $0, %%eax\n"
+					"    je %s\n"
+					"    pushl $1\n"
+					"    jmp %s\n"
+					"%s:\n"
+					"    pushl $0\n"
+					"%s:\n",
+					ifElseMarker.c_str(),
+					endifMarker.c_str(),
+					ifElseMarker.c_str(),
+					endifMarker.c_str());
+		}
 };
 
 
 class BexpressionNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "bexpression";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		BexpressionNode(): Node(NODE_BEXPRESSION) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert((childrenCount() == 1) || (childrenCount() == 2));
-			std::string code;
-			code += fmt(
+			assert(node.childrenCount() >= 1);
+			code.format(
 					"# bexpression\n"
 					);
-			if (childrenCount() == 1) {
-				ASSERT_TYPE(BdisjNode*, get(0));
-				code += get(0)->generate(context);
-			} else {
-				ASSERT_TYPE(BdisjNode*, get(0));
-				ASSERT_TYPE(BDisjNode*, get(1));
-				code += get(0)->generate(context);
-				code += get(1)->generate(context);
+			ASSERT_KIND(NODE_BDISJ, node.get(0));
+			generateNode(node.get(0), context, code);
+			// BDisjNode for each operator
+			for (int i = 1; i < node.childrenCount(); ++i) {
+				ASSERT_KIND(NODE_BDISJ_REST, node.get(i));
+				generateNode(node.get(i), context, code);
 			}
-
-			return code;
 		}
 };
 
 class IfNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "if";
-		}
-	public: 
-		virtual std::string generate(Function *context) {
+	public:
+		IfNode(): Node(NODE_IF) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 2 || childrenCount() == 3);
-			ASSERT_TYPE(BexpressionNode*, get(0));
-			ASSERT_TYPE(StatementsNode*, get(1));
-			if (childrenCount() == 3) {
-				ASSERT_TYPE(StatementsNode*, get(2));
+			assert(node.childrenCount() == 2 || node.childrenCount() == 3);
+			ASSERT_KIND(NODE_BEXPRESSION, node.get(0));
+			ASSERT_KIND(NODE_STATEMENTS, node.get(1));
+			if (node.childrenCount() == 3) {
+				ASSERT_KIND(NODE_STATEMENTS, node.get(2));
 			}   
 
-			std::string ifThenCode;
-			std::string ifElseCode;
-			if (childrenCount() == 2) {
-				ifThenCode = get(1)->generate(context);
+			// branches are generated before the condition (marker
+			// numbering) but placed after it
+			CodeBuffer ifThenCode;
+			CodeBuffer ifElseCode;
+			if (node.childrenCount() == 2) {
+				generateNode(node.get(1), context, ifThenCode);
 			} else{
-				ifThenCode = get(1)->generate(context);
-				ifElseCode = get(2)->generate(context);
+				generateNode(node.get(1), context, ifThenCode);
+				generateNode(node.get(2), context, ifElseCode);
 			}
 
-
-
-			std::string code;
-
-			code += fmt(
+			code.format(
 					"# if\n"
 					);
 
-			code += get(0)->generate(context);
+			generateNode(node.get(0), context, code);
 
-			std::string ifElseMarker = getNextMarker();
-			std::string endifMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string endifMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    cmpl $0, %%eax\n"
-					"    je %s\n"
-					"%s"
+					"    je %s\n",
+					ifElseMarker.c_str());
+			code.splice(ifThenCode);
+			code.format(
 					"    jmp %s\n"
-					"%s:\n"
-					"%s"
 					"%s:\n",
-					ifElseMarker.c_str(),
-					ifThenCode.c_str(),
 					endifMarker.c_str(),
-					ifElseMarker.c_str(),
-					ifElseCode.c_str(),
+					ifElseMarker.c_str());
+			code.splice(ifElseCode);
+			code.format(
+					"%s:\n",
 					endifMarker.c_str());
-
-			return code;
 		}
 
 };
 
 class ForNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "for";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		ForNode(): Node(NODE_FOR) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 4);
-			ASSERT_TYPE(AssignmentNode*, get(0));
-			ASSERT_TYPE(BexpressionNode*, get(1));
-			ASSERT_TYPE(AssignmentNode*, get(2));
-			ASSERT_TYPE(StatementsNode*, get(3));
+			assert(node.childrenCount() == 4);
+			ASSERT_KIND(NODE_ASSIGNMENT, node.get(0));
+			ASSERT_KIND(NODE_BEXPRESSION, node.get(1));
+			ASSERT_KIND(NODE_ASSIGNMENT, node.get(2));
+			ASSERT_KIND(NODE_STATEMENTS, node.get(3));
 
 			std::string 
-					startMarker		= getNextMarker(),
-					condMarker		= getNextMarker(),
-					assignment1Code	= get(0)->generate(context),
-					assignment2Code	= get(2)->generate(context),
-					bexprCode		= get(1)->generate(context),
-					statementsCode	= get(3)->generate(context);
+					startMarker		= context->getNextMarker(),
+					condMarker		= context->getNextMarker();
 
-			std::string code;
-
-			code = fmt(
+			code.format(
 					"# for\n"
-					"%s"
+					);
+			generateNode(node.get(0), context, code);
+
+			// generated before the statements but placed after them
+			CodeBuffer assignment2Code;
+			CodeBuffer bexprCode;
+			generateNode(node.get(2), context, assignment2Code);
+			generateNode(node.get(1), context, bexprCode);
+
+			code.format(
 					"    jmp %s\n"
-					"%s:\n"
-					"%s"
-					"%s"
-					"%s:\n"
-					"%s"
+					"%s:\n",
+					condMarker.c_str(),
+					startMarker.c_str());
+			generateNode(node.get(3), context, code);
+			code.splice(assignment2Code);
+			code.format(
+					"%s:\n",
+					condMarker.c_str());
+			code.splice(bexprCode);
+			code.format(
 					"    popl %%eax\n"
 					"    cmpl $0, %%eax\n"
-					"    jne %s\n"
-					,
-					assignment1Code.c_str(),
-					condMarker.c_str(),
-					startMarker.c_str(),
-					statementsCode.c_str(),
-					assignment2Code.c_str(),
-					condMarker.c_str(),
-					bexprCode.c_str(),
-					startMarker.c_str()
-					);
-			return code;
+					"    jne %s\n",
+					startMarker.c_str());
 		}
 };
 
 class WhileNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "while";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		WhileNode(): Node(NODE_WHILE) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
-			assert(childrenCount() == 2);
-			ASSERT_TYPE(BexpressionNode*, get(0));
-			ASSERT_TYPE(StatementsNode*, get(1));
-			std::string code;
-			std::string startMarker = getNextMarker();
-			std::string condMarker = getNextMarker();
+			assert(node.childrenCount() == 2);
+			ASSERT_KIND(NODE_BEXPRESSION, node.get(0));
+			ASSERT_KIND(NODE_STATEMENTS, node.get(1));
+			std::string startMarker = context->getNextMarker();
+			std::string condMarker = context->getNextMarker();
 
-			std::string bexprCode = get(0)->generate(context);
-			std::string statementsCode = get(1)->generate(context);
+			// generated before the statements but placed after them
+			CodeBuffer bexprCode;
+			generateNode(node.get(0), context, bexprCode);
 
-			code = fmt(
+			code.format(
 					"# while\n"
 					"    jmp %s\n"
-					"%s:\n"
-					"%s"
-					"%s:\n"
-					"%s"
+					"%s:\n",
+					condMarker.c_str(),
+					startMarker.c_str());
+			generateNode(node.get(1), context, code);
+			code.format(
+					"%s:\n",
+					condMarker.c_str());
+			code.splice(bexprCode);
+			code.format(
 					"    popl %%eax\n"
 					"    cmpl $0, %%eax\n"
-					"    jne %s\n"
-					,
-					condMarker.c_str(),
-					startMarker.c_str(),
-					statementsCode.c_str(),
-					condMarker.c_str(),
-					bexprCode.c_str(),
-					startMarker.c_str()
-					);
-
-			return code;
+					"    jne %s\n",
+					startMarker.c_str());
 		}
 };
 
 class FuncallNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "funcall";
-		}
 	public:
-		std::string generate(Function *context) {
+		FuncallNode(): Node(NODE_FUNCALL) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
-			assert(childrenCount() >= 1);
-			ASSERT_TYPE(IdNode*, get(0));
-			for (int i = 1; i < childrenCount(); ++i) {
-				ASSERT_TYPE(ExpressionNode*, get(i));
-			}
-
-			std::string id;
-			id = get(0)->getTag();
-
-			Function *calledFunction = Program::getFunction(id);
-			if (calledFunction == NULL) {
-				throw ParserException(fmt("Called function %s is not declared",
-							id.c_str()));
-			}
-			int inArgs = calledFunction->getInputParametersCount();
-			int inArgsActual = childrenCount() - 1;
-
-			if (inArgsActual != inArgs) {
-				throw ParserException(fmt("Function %s is declared with %d input parameters but %d are passed",
-							id.c_str(), inArgs, inArgsActual));
+			assert(node.childrenCount() >= 1);
+			ASSERT_KIND(NODE_ID, node.get(0));
+			for (int i = 1; i < node.childrenCount(); ++i) {
+				ASSERT_EXPRESSION(node.get(i));
 			}
 
-			std::string code;
-			code += fmt(
-					"# funcall\n"
+			generateExpression(node, context, code);
+			code.format(
+					"    pushl %%eax\n"
 					);
-			for (int i = childrenCount() - 1; i > 0; --i) {
-				code += get(i)->generate(context);
-			}
-
-			code += fmt(
-					"    call %s\n"
-					"    addl $%d, %%esp\n"
-					"    pushl %%eax\n",
-					id.c_str(), 4 * inArgsActual);
-
-			return code;
 		}
 };
 
 class FuncallargNode: public Node {
-	private:
-		std::string _getDefaultXMLTag() const {
-			return "funcallarg";
-		}
+	public:
+		FuncallargNode(): Node(NODE_FUNCALLARG) {}
 };
 
 class BconjNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "bconj";
-		}
-};
-
-class CmpNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "--- auxiliary cmp node ---";
-		}
+	public:
+		BconjNode(): Node(NODE_BCONJ) {}
 };
 
 class CmpLessNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "cmpless";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		CmpLessNode(): Node(NODE_CMP_LESS) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			std::string code;
-			code += fmt(
+			code.format(
 					"# cmp less\n"
 					);
 
-			ASSERT_TYPE(ExpressionNode*, get(0));
-			ASSERT_TYPE(ExpressionNode*, get(1));
+			ASSERT_EXPRESSION(node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			code += get(0)->generate(context);
-			code += get(1)->generate(context);
+			generateNode(node.get(0), context, code);
+			generateNode(node.get(1), context, code);
 
 			// take 2 values from
 			// stack; if true -- pushl $1
 			// else -- pushl $0
-			std::string ifElseMarker = getNextMarker();
-			std::string ifendMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string ifendMarker = context->getNextMarker();
+			code.format(
 					"    popl %%ecx\n"
 					"    popl %%eax\n"
 					"    cmpl %%ecx, %%eax\n"
@@ -1415,38 +1663,33 @@ class CmpLessNode: public Node {
 					ifendMarker.c_str(),
 					ifElseMarker.c_str(),
 					ifendMarker.c_str());
-
-			return code;
 		}
 };
 
 class CmpGreaterNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "cmpgreater";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		CmpGreaterNode(): Node(NODE_CMP_GREATER) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			std::string code;
-			code += fmt(
+			code.format(
 					"# cmp greater\n"
 					);
 
-			ASSERT_TYPE(ExpressionNode*, get(0));
-			ASSERT_TYPE(ExpressionNode*, get(1));
+			ASSERT_EXPRESSION(node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			code += get(0)->generate(context);
-			code += get(1)->generate(context);
+			generateNode(node.get(0), context, code);
+			generateNode(node.get(1), context, code);
 
 			// take 2 values from
 			// stack; if true -- pushl $1
 			// else -- pushl $0
-			std::string ifElseMarker = getNextMarker();
-			std::string ifendMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string ifendMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    popl %%ecx\n"
 					"    cmpl %%ecx, %%eax\n"
@@ -1460,38 +1703,33 @@ class CmpGreaterNode: public Node {
 					ifendMarker.c_str(),
 					ifElseMarker.c_str(),
 					ifendMarker.c_str());
-
-			return code;
 		}
 };
 
 class CmpLessOrEqualNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "cmplessorequal";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		CmpLessOrEqualNode(): Node(NODE_CMP_LESS_OR_EQUAL) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			std::string code;
-			code += fmt(
+			code.format(
 					"# cmp less or equal\n"
 					);
 
-			ASSERT_TYPE(ExpressionNode*, get(0));
-			ASSERT_TYPE(ExpressionNode*, get(1));
+			ASSERT_EXPRESSION(node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			code += get(0)->generate(context);
-			code += get(1)->generate(context);
+			generateNode(node.get(0), context, code);
+			generateNode(node.get(1), context, code);
 
 			// take 2 values from
 			// stack; if true -- pushl $1
 			// else -- pushl $0
-			std::string ifElseMarker = getNextMarker();
-			std::string ifendMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string ifendMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    popl %%ecx\n"
 					"    cmpl %%ecx, %%eax\n"
@@ -1505,38 +1743,33 @@ class CmpLessOrEqualNode: public Node {
 					ifendMarker.c_str(),
 					ifElseMarker.c_str(),
 					ifendMarker.c_str());
-
-			return code;
 		}
 };
 
 class CmpGreaterOrEqualNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "cmpgreaterorequal";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		CmpGreaterOrEqualNode(): Node(NODE_CMP_GREATER_OR_EQUAL) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			std::string code;
-			code += fmt(
+			code.format(
 					"# cmp greater or equal\n"
 					);
 
-			ASSERT_TYPE(ExpressionNode*, get(0));
-			ASSERT_TYPE(ExpressionNode*, get(1));
+			ASSERT_EXPRESSION(node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			code += get(0)->generate(context);
-			code += get(1)->generate(context);
+			generateNode(node.get(0), context, code);
+			generateNode(node.get(1), context, code);
 
 			// take 2 values from
 			// stack; if true -- pushl $1
 			// else -- pushl $0
-			std::string ifElseMarker = getNextMarker();
-			std::string ifendMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string ifendMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    popl %%ecx\n"
 					"    cmpl %%ecx, %%eax\n"
@@ -1550,38 +1783,33 @@ class CmpGreaterOrEqualNode: public Node {
 					ifendMarker.c_str(),
 					ifElseMarker.c_str(),
 					ifendMarker.c_str());
-
-			return code;
 		}
 };
 
 class CmpEqualNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "cmpequal";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		CmpEqualNode(): Node(NODE_CMP_EQUAL) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			std::string code;
-			code += fmt(
+			code.format(
 					"# cmp equal\n"
 					);
 
-			ASSERT_TYPE(ExpressionNode*, get(0));
-			ASSERT_TYPE(ExpressionNode*, get(1));
+			ASSERT_EXPRESSION(node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			code += get(0)->generate(context);
-			code += get(1)->generate(context);
+			generateNode(node.get(0), context, code);
+			generateNode(node.get(1), context, code);
 
 			// take 2 values from
 			// stack; if true -- pushl $1
 			// else -- pushl $0
-			std::string ifElseMarker = getNextMarker();
-			std::string ifendMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string ifendMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    popl %%ecx\n"
 					"    cmpl %%ecx, %%eax\n"
@@ -1595,38 +1823,33 @@ class CmpEqualNode: public Node {
 					ifendMarker.c_str(),
 					ifElseMarker.c_str(),
 					ifendMarker.c_str());
-
-			return code;
 		}
 };
 
 class CmpNotEqualNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "cmpnotequal";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		CmpNotEqualNode(): Node(NODE_CMP_NOT_EQUAL) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			std::string code;
-			code += fmt(
+			code.format(
 					"# cmp not equal\n"
 					);
 
-			ASSERT_TYPE(ExpressionNode*, get(0));
-			ASSERT_TYPE(ExpressionNode*, get(1));
+			ASSERT_EXPRESSION(node.get(0));
+			ASSERT_EXPRESSION(node.get(1));
 
-			code += get(0)->generate(context);
-			code += get(1)->generate(context);
+			generateNode(node.get(0), context, code);
+			generateNode(node.get(1), context, code);
 
 			// take 2 values from
 			// stack; if true -- pushl $1
 			// else -- pushl $0
-			std::string ifElseMarker = getNextMarker();
-			std::string ifendMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string ifendMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    popl %%ecx\n"
 					"    cmpl %%ecx, %%eax\n"
@@ -1640,76 +1863,63 @@ class CmpNotEqualNode: public Node {
 					ifendMarker.c_str(),
 					ifElseMarker.c_str(),
 					ifendMarker.c_str());
-
-			return code;
 		}
 };
 
 class TrueNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "true";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		TrueNode(): Node(NODE_TRUE) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 0);
+			assert(node.childrenCount() == 0);
 
-			std::string code;
-			code += fmt(
+			code.format(
 					"# true\n"
 					"    pushl $1\n"
 					);
-			return code;
 		}
 };
 
 class FalseNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "false";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		FalseNode(): Node(NODE_FALSE) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 0);
+			assert(node.childrenCount() == 0);
 
-			std::string code;
-			code += fmt(
+			code.format(
 					"# false\n"
 					"    pushl $0\n"
 					);
-			return code;
 		}
 };
 
 class NotNode: public Node {
-	private:
-		virtual std::string _getDefaultXMLTag() const {
-			return "not";
-		}
 	public:
-		virtual std::string generate(Function *context) {
+		NotNode(): Node(NODE_NOT) {}
+		template <class Ref>
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
 			TRACE;
 
 			assert(context != NULL);
-			assert(childrenCount() == 1);
-			ASSERT_TYPE(BAtomNode*, get(0));
+			assert(node.childrenCount() == 1);
+			ASSERT_KIND(NODE_BATOM, node.get(0));
 
-			std::string code;
-			code += fmt (
+			code.format(
 					"# not\n"
 					);
 
-			code += get(0)->generate(context);
+			generateNode(node.get(0), context, code);
 
-			std::string ifElseMarker = getNextMarker();
-			std::string endifMarker = getNextMarker();
-			code += fmt(
+			std::string ifElseMarker = context->getNextMarker();
+			std::string endifMarker = context->getNextMarker();
+			code.format(
 					"    popl %%eax\n"
 					"    cmpl $0, %%eax\n"
 					"    je %s\n"
@@ -1722,57 +1932,756 @@ class NotNode: public Node {
 					endifMarker.c_str(),
 					ifElseMarker.c_str(),
 					endifMarker.c_str());
-			return code;
 		}
 };
 
 
+/*
+ * Code of an expression tree with the temporaries in registers instead of
+ * the stack. The tree is labelled first with the Sethi-Ullman numbers
+ * (registers a subtree needs), and a binary node evaluates first the child
+ * that needs more, unless one of them calls a function: calls are made in
+ * the order of the source. A temporary is pushed only when all the six
+ * registers are taken; the ones a call clobbers (%eax, %ecx, %edx) are
+ * pushed around it. %ebx, %esi and %edi are saved around the expression
+ * if it uses them.
+ *
+ * The labelling walks the tree in the order of the stack machine (the
+ * arguments of a call from the last one) and looks up the variables and
+ * functions, so the errors are the same.
+ */
+template <class Ref>
+class ExpressionGenerator {
+	private:
+		enum Register {
+			EAX,
+			ECX,
+			EDX,
+			EBX,
+			ESI,
+			EDI,
+			REGISTER_COUNT
+		};
+
+		// of every node in the order of labelling
+		struct Label {
+			// registers for the value; 0 for an operand used in place
+			int need;
+			// nodes in the subtree
+			int size;
+			bool call;
+			// of a variable
+			int offset;
+		};
+
+		// a binary node of a chain while its left operand is generated
+		struct Operation {
+			const BinaryOperator *op;
+			Ref rightNode;
+			int rightIndex;
+			// the right value is generated after the left one
+			bool leftFirst;
+			int right;
+			// the right value is on the top of the stack
+			bool onStack;
+			std::string source;
+		};
+
+		Function *_context;
+		CodeBuffer *_code;
+		std::vector<Label> _labels;
+		// stacks of the chains being walked, shared by the nested ones
+		std::vector<Ref> _spine;
+		std::vector<Operation> _operations;
+		bool _used[REGISTER_COUNT];
+		bool _saved[REGISTER_COUNT];
+
+		ExpressionGenerator(Function *context):
+			_context(context),
+			_code(NULL) {
+			std::fill(_used, _used + REGISTER_COUNT, false);
+			std::fill(_saved, _saved + REGISTER_COUNT, false);
+		}
+
+		static const char *getName(int reg) {
+			static const char *names[REGISTER_COUNT] = {
+				"%eax", "%ecx", "%edx", "%ebx", "%esi", "%edi"
+			};
+			return names[reg];
+		}
+
+		static bool isLeaf(Ref node) {
+			return node.getKind() == NODE_ID || node.getKind() == NODE_INTEGER;
+		}
+
+		// $N or offset(%ebp)
+		std::string getOperand(Ref node, int index) const {
+			if (node.getKind() == NODE_INTEGER) {
+				return "$" + node.getTag();
+			}
+			return fmt("%d(%%ebp)", _labels[index].offset);
+		}
+
+		int getFreeCount() const {
+			return std::count(_used, _used + REGISTER_COUNT, false);
+		}
+
+		// a free register, -1 if there is none
+		int allocate(bool division = false) {
+			for (int reg = division ? ECX : EAX; reg < REGISTER_COUNT; ++reg) {
+				if (!_used[reg] && (!division || reg != EDX)) {
+					_used[reg] = true;
+					_saved[reg] = _saved[reg] || reg >= EBX;
+					return reg;
+				}
+			}
+			return -1;
+		}
+
+		void release(int reg) {
+			_used[reg] = false;
+		}
+
+		int label(Ref node);
+		int labelChain(Ref node);
+		int generate(Ref node, int index);
+		int generateBinary(Ref node, int index);
+		int finishBinary(Operation &operation, int left);
+		int generateCall(Ref node, int index);
+		void divide(const BinaryOperator *op, int left, int &right,
+				bool &onStack, std::string &source);
+
+	public:
+		// the value of node in %eax
+		static void generate(Ref node, Function *context, CodeBuffer &code) {
+			TRACE;
+
+			ExpressionGenerator generator(context);
+			generator.label(node);
+
+			CodeBuffer body;
+			generator._code = &body;
+			int result = generator.generate(node, 0);
+			if (result != EAX) {
+				body.format("    movl %s, %%eax\n", getName(result));
+			}
+
+			code.format(
+					"# expression, %d registers\n",
+					generator._labels[0].need);
+			for (int reg = EBX; reg < REGISTER_COUNT; ++reg) {
+				if (generator._saved[reg]) {
+					code.format("    pushl %s\n", getName(reg));
+				}
+			}
+			code.splice(body);
+			for (int reg = REGISTER_COUNT - 1; reg >= EBX; --reg) {
+				if (generator._saved[reg]) {
+					code.format("    popl %s\n", getName(reg));
+				}
+			}
+		}
+};
+
+template <class Ref>
+int ExpressionGenerator<Ref>::label(Ref node) {
+	if (node.getKind() == NODE_BINARY) {
+		return labelChain(node);
+	}
+	int index = _labels.size();
+	_labels.push_back(Label());
+	Label label = {1, 1, false, 0};
+
+	switch (node.getKind()) {
+		case NODE_ID:
+			label.offset = _context->getVariableOffset(node.getSymbol(),
+					node.getTagRef());
+			break;
+		case NODE_INTEGER:
+			break;
+		case NODE_NEGATION: {
+			int child = this->label(node.get(0));
+			label.need = _labels[child].need;
+			label.call = _labels[child].call;
+			break;
+		}
+		case NODE_FUNCALL: {
+			ASSERT_KIND(NODE_ID, node.get(0));
+			std::string id = node.get(0).getTag();
+			Function *calledFunction = _context->getProgram().getFunction(node.get(0).getSymbol(), _context);
+			if (calledFunction == NULL) {
+				throw ParserException(fmt("Called function %s is not declared",
+							id.c_str()));
+			}
+			int inArgs = calledFunction->getInputParametersCount();
+			int inArgsActual = node.childrenCount() - 1;
+
+			if (inArgsActual != inArgs) {
+				throw ParserException(fmt("Function %s is declared with %d input parameters but %d are passed",
+							id.c_str(), inArgs, inArgsActual));
+			}
+			// arguments are pushed from the last one
+			for (int i = node.childrenCount() - 1; i > 0; --i) {
+				int argument = this->label(node.get(i));
+				label.need = std::max(label.need, _labels[argument].need);
+			}
+			label.call = true;
+			break;
+		}
+		default:
+			assert(!"not an expression");
+			break;
+	}
+
+	label.size = _labels.size() - index;
+	_labels[index] = label;
+	return index;
+}
+
+// the labels of the spine come first, from the top, as in generateBinary
+template <class Ref>
+int ExpressionGenerator<Ref>::labelChain(Ref node) {
+	size_t base = _spine.size();
+	Ref leftmost = collectSpine(node, _spine);
+	size_t length = _spine.size() - base;
+	int top = _labels.size();
+	_labels.insert(_labels.end(), length, Label());
+	int left = label(leftmost);
+	for (size_t k = length; k-- > 0;) {
+		Ref binary = _spine[base + k];
+		const BinaryOperator *op = findBinaryOperator(binary.getTagRef());
+		assert(op != NULL);
+		int index = top + k;
+		int right = label(binary.get(1));
+		int leftNeed = _labels[left].need;
+		// the right operand may be a variable or a constant in place,
+		// except a constant divisor
+		int rightNeed = _labels[right].need;
+		if (binary.get(1).getKind() == NODE_ID
+				|| (binary.get(1).getKind() == NODE_INTEGER && !op->isDivision())) {
+			rightNeed = 0;
+		}
+		Label label = {1, 1, false, 0};
+		label.need = leftNeed == rightNeed ? leftNeed + 1 : std::max(leftNeed, rightNeed);
+		label.call = _labels[left].call || _labels[right].call;
+		label.size = _labels.size() - index;
+		_labels[index] = label;
+		left = index;
+	}
+	_spine.erase(_spine.begin() + base, _spine.end());
+	return top;
+}
+
+// the register with the value; at least one register must be free
+template <class Ref>
+int ExpressionGenerator<Ref>::generate(Ref node, int index) {
+	switch (node.getKind()) {
+		case NODE_ID:
+		case NODE_INTEGER: {
+			int reg = allocate();
+			_code->format("    movl %s, %s\n",
+					getOperand(node, index).c_str(), getName(reg));
+			return reg;
+		}
+		case NODE_NEGATION: {
+			int reg = generate(node.get(0), index + 1);
+			_code->format("    negl %s\n", getName(reg));
+			return reg;
+		}
+		case NODE_BINARY:
+			return generateBinary(node, index);
+		default:
+			return generateCall(node, index);
+	}
+}
+
+// going down the spine, the right operands that need more registers are
+// generated first; coming back up, the rest of each operation
+template <class Ref>
+int ExpressionGenerator<Ref>::generateBinary(Ref node, int index) {
+	size_t base = _operations.size();
+	size_t spineBase = _spine.size();
+	Ref leftmost = collectSpine(node, _spine);
+	size_t length = _spine.size() - spineBase;
+	for (size_t k = 0; k < length; ++k, ++index) {
+		node = _spine[spineBase + k];
+		const BinaryOperator *op = findBinaryOperator(node.getTagRef());
+		Ref rightNode = node.get(1);
+		int leftIndex = index + 1;
+		int rightIndex = leftIndex + _labels[leftIndex].size;
+		const Label &leftLabel = _labels[leftIndex];
+		const Label &rightLabel = _labels[rightIndex];
+		Operation operation = {op, rightNode, rightIndex, false, -1, false, std::string()};
+
+		if (rightNode.getKind() == NODE_ID
+				|| (rightNode.getKind() == NODE_INTEGER && !op->isDivision())) {
+			operation.source = getOperand(rightNode, rightIndex);
+		} else if (!leftLabel.call && !rightLabel.call && rightLabel.need > leftLabel.need) {
+			operation.right = generate(rightNode, rightIndex);
+			if (getFreeCount() == 0) {
+				_code->format("    pushl %s\n", getName(operation.right));
+				release(operation.right);
+				operation.right = -1;
+				operation.onStack = true;
+			}
+		} else {
+			operation.leftFirst = true;
+		}
+		_operations.push_back(operation);
+	}
+	_spine.erase(_spine.begin() + spineBase, _spine.end());
+
+	int left = generate(leftmost, index);
+	for (size_t k = _operations.size(); k-- > base;) {
+		// a copy: the right operand may push chains of its own
+		Operation operation = _operations[k];
+		left = finishBinary(operation, left);
+	}
+	_operations.erase(_operations.begin() + base, _operations.end());
+	return left;
+}
+
+// the operation on the value of its left operand
+template <class Ref>
+int ExpressionGenerator<Ref>::finishBinary(Operation &operation, int left) {
+	const BinaryOperator *op = operation.op;
+	int &right = operation.right;
+	bool &onStack = operation.onStack;
+	std::string &source = operation.source;
+
+	if (operation.leftFirst) {
+		if (getFreeCount() == 0) {
+			// the left value waits on the stack and swaps with the right one
+			_code->format("    pushl %s\n", getName(left));
+			release(left);
+			left = generate(operation.rightNode, operation.rightIndex);
+			_code->format("    xchgl (%%esp), %s\n", getName(left));
+			onStack = true;
+		} else {
+			right = generate(operation.rightNode, operation.rightIndex);
+		}
+	}
+	if (right != -1) {
+		source = getName(right);
+	} else if (onStack) {
+		source = "(%esp)";
+	}
+
+	if (op->isDivision()) {
+		divide(op, left, right, onStack, source);
+	} else {
+		_code->format("    %s %s, %s\n",
+				op->instruction, source.c_str(), getName(left));
+	}
+
+	if (right != -1) {
+		release(right);
+	}
+	if (onStack) {
+		_code->format("    addl $4, %%esp\n");
+	}
+	return left;
+}
+
+/*
+ * idivl takes the dividend in %edx:%eax, so the values kept there are
+ * pushed for the time of the division.
+ */
+template <class Ref>
+void ExpressionGenerator<Ref>::divide(const BinaryOperator *op, int left,
+		int &right, bool &onStack, std::string &source) {
+	if (right == EAX || right == EDX) {
+		int reg = allocate(true);
+		if (reg != -1) {
+			_code->format("    movl %s, %s\n", getName(right), getName(reg));
+		} else {
+			_code->format("    pushl %s\n", getName(right));
+			onStack = true;
+		}
+		release(right);
+		right = reg;
+		source = reg != -1 ? getName(reg) : "(%esp)";
+	}
+
+	bool saveEax = left != EAX && _used[EAX];
+	bool saveEdx = left != EDX && _used[EDX];
+	if (saveEax) {
+		_code->format("    pushl %%eax\n");
+	}
+	if (saveEdx) {
+		_code->format("    pushl %%edx\n");
+	}
+	if (onStack) {
+		source = fmt("%d(%%esp)", 4 * (saveEax + saveEdx));
+	}
+	if (left != EAX) {
+		_code->format("    movl %s, %%eax\n", getName(left));
+	}
+	_code->format(
+			"    cltd\n"
+			"    idivl %s\n",
+			source.c_str());
+	int result = op->token == Tokenizer::T_DIV ? EAX : EDX;
+	if (left != result) {
+		_code->format("    movl %s, %s\n", getName(result), getName(left));
+	}
+	if (saveEdx) {
+		_code->format("    popl %%edx\n");
+	}
+	if (saveEax) {
+		_code->format("    popl %%eax\n");
+	}
+}
+
+template <class Ref>
+int ExpressionGenerator<Ref>::generateCall(Ref node, int index) {
+	// a call keeps only %ebx, %esi and %edi
+	bool pushed[EBX];
+	for (int reg = EAX; reg < EBX; ++reg) {
+		pushed[reg] = _used[reg];
+		if (pushed[reg]) {
+			_code->format("    pushl %s\n", getName(reg));
+			release(reg);
+		}
+	}
+
+	int argumentIndex = index + 1;
+	for (int i = node.childrenCount() - 1; i > 0; --i) {
+		Ref argument = node.get(i);
+		if (isLeaf(argument)) {
+			_code->format("    pushl %s\n",
+					getOperand(argument, argumentIndex).c_str());
+		} else {
+			int reg = generate(argument, argumentIndex);
+			_code->format("    pushl %s\n", getName(reg));
+			release(reg);
+		}
+		argumentIndex += _labels[argumentIndex].size;
+	}
+
+	std::string id = node.get(0).getTag();
+	int inArgs = node.childrenCount() - 1;
+	_code->format("    call %s\n", id.c_str());
+	if (inArgs > 0) {
+		_code->format("    addl $%d, %%esp\n", 4 * inArgs);
+	}
+
+	for (int reg = EAX; reg < EBX; ++reg) {
+		_used[reg] = pushed[reg];
+	}
+	int result = allocate();
+	if (result != EAX) {
+		_code->format("    movl %%eax, %s\n", getName(result));
+	}
+	for (int reg = EBX - 1; reg >= EAX; --reg) {
+		if (pushed[reg]) {
+			_code->format("    popl %s\n", getName(reg));
+		}
+	}
+	return result;
+}
+
+template <class Ref>
+void generateExpression(Ref node, Function *context, CodeBuffer &code) {
+	ASSERT_EXPRESSION(node);
+	switch (node.getKind()) {
+		case NODE_ID: {
+			StringRef id = node.getTagRef();
+			int offset = context->getVariableOffset(node.getSymbol(), id);
+			code.format(
+					"# id %.*s\n"
+					"    movl %d(%%ebp), %%eax\n",
+					(int) id.length(), id.data(), offset);
+			break;
+		}
+		case NODE_INTEGER:
+			code.format(
+					"    movl $%s, %%eax\n",
+					node.getTag().c_str());
+			break;
+		default:
+			ExpressionGenerator<Ref>::generate(node, context, code);
+			break;
+	}
+}
+
+template <class Ref>
+void generateNode(Ref node, Function *context, CodeBuffer &code) {
+	switch (node.getKind()) {
+		case NODE_ID:
+			IdNode::generate(node, context, code);
+			break;
+		case NODE_STATEMENTS:
+			StatementsNode::generate(node, context, code);
+			break;
+		case NODE_READ:
+			ReadNode::generate(node, context, code);
+			break;
+		case NODE_RETURN:
+			ReturnNode::generate(node, context, code);
+			break;
+		case NODE_PRINT:
+			PrintNode::generate(node, context, code);
+			break;
+		case NODE_NEGATION:
+			NegationNode::generate(node, context, code);
+			break;
+		case NODE_BINARY:
+			BinaryNode::generate(node, context, code);
+			break;
+		case NODE_INTEGER:
+			IntegerNode::generate(node, context, code);
+			break;
+		case NODE_ASSIGNMENT:
+			AssignmentNode::generate(node, context, code);
+			break;
+		case NODE_DECLARATION:
+			DeclarationNode::generate(node, context, code);
+			break;
+		case NODE_BATOM:
+			BAtomNode::generate(node, context, code);
+			break;
+		case NODE_BCONJ_REST:
+			BConjNode::generate(node, context, code);
+			break;
+		case NODE_BDISJ:
+			BdisjNode::generate(node, context, code);
+			break;
+		case NODE_BDISJ_REST:
+			BDisjNode::generate(node, context, code);
+			break;
+		case NODE_BEXPRESSION:
+			BexpressionNode::generate(node, context, code);
+			break;
+		case NODE_IF:
+			IfNode::generate(node, context, code);
+			break;
+		case NODE_FOR:
+			ForNode::generate(node, context, code);
+			break;
+		case NODE_WHILE:
+			WhileNode::generate(node, context, code);
+			break;
+		case NODE_FUNCALL:
+			FuncallNode::generate(node, context, code);
+			break;
+		case NODE_CMP_LESS:
+			CmpLessNode::generate(node, context, code);
+			break;
+		case NODE_CMP_GREATER:
+			CmpGreaterNode::generate(node, context, code);
+			break;
+		case NODE_CMP_LESS_OR_EQUAL:
+			CmpLessOrEqualNode::generate(node, context, code);
+			break;
+		case NODE_CMP_GREATER_OR_EQUAL:
+			CmpGreaterOrEqualNode::generate(node, context, code);
+			break;
+		case NODE_CMP_EQUAL:
+			CmpEqualNode::generate(node, context, code);
+			break;
+		case NODE_CMP_NOT_EQUAL:
+			CmpNotEqualNode::generate(node, context, code);
+			break;
+		case NODE_TRUE:
+			TrueNode::generate(node, context, code);
+			break;
+		case NODE_FALSE:
+			FalseNode::generate(node, context, code);
+			break;
+		case NODE_NOT:
+			NotNode::generate(node, context, code);
+			break;
+		default:
+			code.format("<%s>\n", getNodeKindName(node.getKind()));
+			break;
+	}
+}
+
+template <class Ref>
+void generateProgram(Ref root, Program &program, CodeBuffer &code) {
+	ASSERT_KIND(NODE_PROGRAM, root);
+	ProgramNode::generate(root, program, code);
+}
+
 class Parser {
 	private:
-		Tokenizer *_tokenizer;
+		// tokens of the whole input; _index is the current one
+		TokenBuffer _own_tokens;
+		const TokenBuffer *_tokens;
+		size_t _index;
+		// owns the syntax tree
+		Arena _arena;
 		Node *_root;
+		// depth of nested blocks, brackets and unary operators
+		int _nesting;
+		int _max_nesting;
+
+		/*
+		 * Counts one level of nesting while a recursive parse function
+		 * runs. Deeper input is rejected before it overflows the stack
+		 * here or in the passes, which recurse as deep as the tree except
+		 * for the left spines of operator chains.
+		 */
+		class NestingGuard {
+			private:
+				Parser &_parser;
+			public:
+				NestingGuard(Parser &parser) : _parser(parser) {
+					if (_parser._nesting == _parser._max_nesting) {
+						throw ParserException(
+								fmt("Failed on %d:%d: nesting is deeper than %d",
+									_parser.getLineNumber(),
+									_parser.getLinePosition(),
+									_parser._max_nesting));
+					}
+					++_parser._nesting;
+				}
+
+				~NestingGuard() {
+					--_parser._nesting;
+				}
+		};
+
+		void nextToken() {
+			// the last token is EOF, stay on it
+			if (_index + 1 < _tokens->size()) {
+				++_index;
+			}
+		}
+
+		Tokenizer::ValueType getToken() const {
+			return _tokens->getType(_index);
+		}
+
+		// n-th token after the current one
+		Tokenizer::ValueType peekToken(size_t n = 1) const {
+			size_t index = std::min(_index + n, _tokens->size() - 1);
+			return _tokens->getType(index);
+		}
+
+		std::string getTag() const {
+			return _tokens->getTag(_index);
+		}
+
+		// tag of the current token for a node
+		StringRef copyTag() {
+			return _arena.copy(_tokens->getTagRef(_index));
+		}
+
+		// id node of the current token; the name stays in the SymbolPool
+		Node *newIdNode() {
+			Symbol symbol = _tokens->getSymbol(_index);
+			return new (_arena) IdNode(_tokens->getSymbols().getName(symbol), symbol);
+		}
+
+		int getLineNumber() const {
+			return _tokens->getLineNumber(_index);
+		}
+
+		int getLinePosition() const {
+			return _tokens->getLinePosition(_index);
+		}
+
+		// for backtracking: save getPosition() and return with setPosition()
+		size_t getPosition() const {
+			return _index;
+		}
+
+		void setPosition(size_t index) {
+			assert(index < _tokens->size());
+			_index = index;
+		}
 
 		bool match(Tokenizer::ValueType type) {
-			if (_tokenizer->getToken() == type) {
-				DEBUG(fmt("Matched %s", _tokenizer->getTag().c_str()));
+			if (getToken() == type) {
+				DEBUG(fmt("Matched %.*s", (int) _tokens->getLength(_index),
+							_tokens->getTagRef(_index).data()));
 				return true;
 			}
 			return false;
 		}
 
+		void parse() {
+			assert(_tokens->size() > 0);
+			assert(_tokens->getType(_tokens->size() - 1) == Tokenizer::T_EOF);
+
+			_index = 0;
+			_nesting = 0;
+			parseProgram(&_root);
+
+			if (!match(Tokenizer::T_EOF)) {
+				throw PARSER_EXPECTED(Tokenizer::T_EOF);
+			}
+		}
+
 	public:
 		std::string getXMLTree() {
 			return ::buildXMLTree(_root);
 		}
 
-		std::string generate() {
-			return _root->generate(NULL);
+		// nodes in the syntax tree
+		size_t getNodeCount() const {
+			return ::countNodes(_root);
+		}
+
+		// memory of the syntax tree
+		const Arena &getArena() const {
+			return _arena;
+		}
+
+		// for the passes that add nodes to the tree
+		Arena &getArena() {
+			return _arena;
 		}
 
-		Parser(Tokenizer *tokenizer):
-			_tokenizer(tokenizer) {
+		Node *getRoot() const {
+			return _root;
+		}
+
+		// enough for any real program; the stack would take a few times more
+		const static int DEFAULT_MAX_NESTING = 4000;
+
+		template <class Stream>
+		Parser(BasicTokenizer<Stream> *tokenizer,
+				int maxNesting = DEFAULT_MAX_NESTING):
+			_tokens(&_own_tokens),
+			_index(0),
+			_root(NULL),
+			_nesting(0),
+			_max_nesting(maxNesting) {
 				TRACE;
-				assert(_tokenizer != NULL);
+				assert(tokenizer != NULL);
+
+				tokenizer->tokenizeAll(_own_tokens);
+				parse();
+			}
 
-				_tokenizer->nextToken();
-				parseProgram(&_root);
+		// tokens must outlive the parser
+		Parser(const TokenBuffer *tokens,
+				int maxNesting = DEFAULT_MAX_NESTING):
+			_tokens(tokens),
+			_index(0),
+			_root(NULL),
+			_nesting(0),
+			_max_nesting(maxNesting) {
+				TRACE;
+				assert(tokens != NULL);
 
-				if (!match(Tokenizer::T_EOF)) {
-					throw PARSER_EXPECTED(Tokenizer::T_EOF);
-				}
+				parse();
 			}
 
+
 		void parseProgram(Node **node) {
 			TRACE;
-			*node = new ProgramNode();
+			*node = new (_arena) ProgramNode();
 			parseFuncdefs(*node);
 		}
 
 		void parseFuncdefs(Node *node) {
 			TRACE;
-			if (match(Tokenizer::T_DEF)) {
+			while (match(Tokenizer::T_DEF)) {
 				parseFuncdef(node);
-				parseFuncdefs(node);
 			}
 			// eps is ok
 		}
@@ -1780,34 +2689,34 @@ class Parser {
 		void parseFuncdef(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_DEF)) {
-				_tokenizer->nextToken();
+				nextToken();
 
-				Node *node_funcdef = new FuncdefNode();
+				Node *node_funcdef = new (_arena) FuncdefNode();
 				parseType(node_funcdef);
 				parseId(node_funcdef);
 
-				Node *node_funcargs = new FuncargsNode();
+				Node *node_funcargs = new (_arena) FuncargsNode();
 				parseFunargs(node_funcargs);
-				node_funcdef->addChild(node_funcargs);
+				node_funcdef->addChild(node_funcargs, _arena);
 
 				if (match(Tokenizer::T_ENDDEF)) {
 					// with no body; just declaration
-					_tokenizer->nextToken();
-					node->addChild(node_funcdef);
+					nextToken();
+					node->addChild(node_funcdef, _arena);
 				} else if (match(Tokenizer::T_COLON)) {
 					// with body;
-					_tokenizer->nextToken();
+					nextToken();
 
-					Node *node_statements = new StatementsNode();
+					Node *node_statements = new (_arena) StatementsNode();
 					parseStatements(node_statements);
-					node_funcdef->addChild(node_statements);
+					node_funcdef->addChild(node_statements, _arena);
 
 					if (!match(Tokenizer::T_ENDDEF)) {
 						throw PARSER_EXPECTED(Tokenizer::T_ENDDEF);
 					}
-					_tokenizer->nextToken();
+					nextToken();
 
-					node->addChild(node_funcdef);
+					node->addChild(node_funcdef, _arena);
 				} else {
 					throw PARSER_ILLEGAL;
 				}
@@ -1819,8 +2728,8 @@ class Parser {
 		void parseType(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_TYPE_INT)) {
-				node->addChild(new TypeNode("int"));
-				_tokenizer->nextToken();
+				node->addChild(new (_arena) TypeNode(StringRef("int", 3)), _arena);
+				nextToken();
 			} else {
 				throw PARSER_ILLEGAL;
 			}
@@ -1829,8 +2738,8 @@ class Parser {
 		void parseId(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_ID)) {
-				node->addChild(new IdNode(_tokenizer->getTag()));
-				_tokenizer->nextToken();
+				node->addChild(newIdNode(), _arena);
+				nextToken();
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_ID);
 			}
@@ -1840,10 +2749,10 @@ class Parser {
 			TRACE;
 
 			if (match(Tokenizer::T_TYPE_INT)) {
-				Node *node_funcarg = new FuncargNode();
+				Node *node_funcarg = new (_arena) FuncargNode();
 				parseType(node_funcarg);
 				parseId(node_funcarg);
-				node->addChild(node_funcarg);
+				node->addChild(node_funcarg, _arena);
 				parseFunargsrest(node);
 			}
 			// eps
@@ -1852,64 +2761,61 @@ class Parser {
 		void parseFunargsrest(Node *node) {
 			TRACE;
 
-			if (match(Tokenizer::T_COMMA)) {
-				_tokenizer->nextToken();
-				Node *node_funcarg = new FuncargNode();
+			while (match(Tokenizer::T_COMMA)) {
+				nextToken();
+				Node *node_funcarg = new (_arena) FuncargNode();
 				parseType(node_funcarg);
 				parseId(node_funcarg);
-				node->addChild(node_funcarg);
-				parseFunargsrest(node);
+				node->addChild(node_funcarg, _arena);
 			}
 			// eps
 		}
 
 		void parseStatements(Node *node) {
 			TRACE;
-
-			if (match(Tokenizer::T_FOR)) {
-				parseFor(node);
-				parseStatements(node);
-			} else if (match(Tokenizer::T_WHILE)) {
-				parseWhile(node);
-				parseStatements(node);
-			} else if (match(Tokenizer::T_IF)) {
-				parseIf(node);
-				parseStatements(node);
-			} else if (match(Tokenizer::T_ID)) {
-				parseAssignment(node);
-				if (!match(Tokenizer::T_SEMICOLON)) {
-					throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
-				}
-				_tokenizer->nextToken();
-				parseStatements(node);
-			} else if (match(Tokenizer::T_TYPE_INT)) {
-				parseDeclaration(node);
-				if (!match(Tokenizer::T_SEMICOLON)) {
-					throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
-				}
-				_tokenizer->nextToken();
-				parseStatements(node);
-			} else if (match(Tokenizer::T_RETURN)) {
-				parseReturn(node);
-				if (!match(Tokenizer::T_SEMICOLON)) {
-					throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
-				}
-				_tokenizer->nextToken();
-				parseStatements(node);
-			} else if (match(Tokenizer::T_PRINT)) {
-				parsePrint(node);
-				if (!match(Tokenizer::T_SEMICOLON)) {
-					throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
-				}
-				_tokenizer->nextToken();
-				parseStatements(node);
-			} else if (match(Tokenizer::T_READ)) {
-				parseRead(node);
-				if (!match(Tokenizer::T_SEMICOLON)) {
-					throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
+			NestingGuard guard(*this);
+
+			// one statement per iteration; blocks only nest
+			for (;;) {
+				if (match(Tokenizer::T_FOR)) {
+					parseFor(node);
+				} else if (match(Tokenizer::T_WHILE)) {
+					parseWhile(node);
+				} else if (match(Tokenizer::T_IF)) {
+					parseIf(node);
+				} else if (match(Tokenizer::T_ID)) {
+					parseAssignment(node);
+					if (!match(Tokenizer::T_SEMICOLON)) {
+						throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
+					}
+					nextToken();
+				} else if (match(Tokenizer::T_TYPE_INT)) {
+					parseDeclaration(node);
+					if (!match(Tokenizer::T_SEMICOLON)) {
+						throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
+					}
+					nextToken();
+				} else if (match(Tokenizer::T_RETURN)) {
+					parseReturn(node);
+					if (!match(Tokenizer::T_SEMICOLON)) {
+						throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
+					}
+					nextToken();
+				} else if (match(Tokenizer::T_PRINT)) {
+					parsePrint(node);
+					if (!match(Tokenizer::T_SEMICOLON)) {
+						throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
+					}
+					nextToken();
+				} else if (match(Tokenizer::T_READ)) {
+					parseRead(node);
+					if (!match(Tokenizer::T_SEMICOLON)) {
+						throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
+					}
+					nextToken();
+				} else {
+					break;
 				}
-				_tokenizer->nextToken();
-				parseStatements(node);
 			}
 			// eps
 		}
@@ -1917,10 +2823,10 @@ class Parser {
 		void parseDeclaration(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_TYPE_INT)) {
-				Node *node_declaration = new DeclarationNode();
+				Node *node_declaration = new (_arena) DeclarationNode();
 				parseType(node_declaration);
 				parseId(node_declaration);
-				node->addChild(node_declaration);
+				node->addChild(node_declaration, _arena);
 			} else {
 				throw PARSER_ILLEGAL;
 			}
@@ -1929,10 +2835,10 @@ class Parser {
 		void parseReturn(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_RETURN)) {
-				_tokenizer->nextToken();
-				Node *node_return = new ReturnNode();
+				nextToken();
+				Node *node_return = new (_arena) ReturnNode();
 				parseExpression(node_return);
-				node->addChild(node_return);
+				node->addChild(node_return, _arena);
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_RETURN);
 			}
@@ -1941,10 +2847,10 @@ class Parser {
 		void parsePrint(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_PRINT)) {
-				_tokenizer->nextToken();
-				Node *node_print = new PrintNode();
+				nextToken();
+				Node *node_print = new (_arena) PrintNode();
 				parseExpression(node_print);
-				node->addChild(node_print);
+				node->addChild(node_print, _arena);
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_PRINT);
 			}
@@ -1953,10 +2859,10 @@ class Parser {
 		void parseRead(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_READ)) {
-				_tokenizer->nextToken();
-				Node *node_read = new ReadNode();
+				nextToken();
+				Node *node_read = new (_arena) ReadNode();
 				parseId(node_read);
-				node->addChild(node_read);
+				node->addChild(node_read, _arena);
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_READ);
 			}
@@ -1965,14 +2871,14 @@ class Parser {
 		void parseAssignment(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_ID)) {
-				Node *node_assignment = new AssignmentNode();
+				Node *node_assignment = new (_arena) AssignmentNode();
 				parseId(node_assignment);
 				if (!match(Tokenizer::T_ASSIGNMENT)) {
 					throw PARSER_EXPECTED(Tokenizer::T_ASSIGNMENT);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 				parseExpression(node_assignment);
-				node->addChild(node_assignment);
+				node->addChild(node_assignment, _arena);
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_ID);
 			}
@@ -1982,37 +2888,37 @@ class Parser {
 			TRACE;
 
 			if (match(Tokenizer::T_FOR)) {
-				_tokenizer->nextToken();
+				nextToken();
 
-				Node *node_for = new ForNode();
+				Node *node_for = new (_arena) ForNode();
 
 				parseAssignment(node_for);
 				if (!match(Tokenizer::T_SEMICOLON)) {
 					throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 				
 				parseBexpression(node_for);
 				if (!match(Tokenizer::T_SEMICOLON)) {
 					throw PARSER_EXPECTED(Tokenizer::T_SEMICOLON);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 				
 				parseAssignment(node_for);
 				if (!match(Tokenizer::T_DO)) {
 					throw PARSER_EXPECTED(Tokenizer::T_DO);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 				
-				Node *node_statements = new StatementsNode();
+				Node *node_statements = new (_arena) StatementsNode();
 				parseStatements(node_statements);
-				node_for->addChild(node_statements);
+				node_for->addChild(node_statements, _arena);
 				if (!match(Tokenizer::T_DONE)) {
 					throw PARSER_EXPECTED(Tokenizer::T_DONE);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 
-				node->addChild(node_for);
+				node->addChild(node_for, _arena);
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_FOR);
 			}
@@ -2020,28 +2926,28 @@ class Parser {
 		void parseWhile(Node *node) {
 			TRACE;
 			if (match(Tokenizer::T_WHILE)) {
-				_tokenizer->nextToken();
+				nextToken();
 
-				Node *node_while = new WhileNode();
+				Node *node_while = new (_arena) WhileNode();
 				// parseBexpression
 				parseBexpression(node_while);
 				// match do
 				if (!match(Tokenizer::T_DO)) {
 					throw PARSER_EXPECTED(Tokenizer::T_DO);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 
 				// parseStatements
-				Node *node_statements = new StatementsNode();
+				Node *node_statements = new (_arena) StatementsNode();
 				parseStatements(node_statements);
-				node_while->addChild(node_statements);
+				node_while->addChild(node_statements, _arena);
 				// match done
 				if (!match(Tokenizer::T_DONE)) {
 					throw PARSER_EXPECTED(Tokenizer::T_DONE);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 
-				node->addChild(node_while);
+				node->addChild(node_while, _arena);
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_WHILE);
 			}
@@ -2050,8 +2956,8 @@ class Parser {
 		void parseIf(Node *node) { // TODO:
 			TRACE;
 			if (match(Tokenizer::T_IF)) {
-				_tokenizer->nextToken();
-				Node *node_if = new IfNode();
+				nextToken();
+				Node *node_if = new (_arena) IfNode();
 				// parseBexpression
 				parseBexpression(node_if);
 
@@ -2059,35 +2965,35 @@ class Parser {
 				if (!match(Tokenizer::T_THEN)) {
 					throw PARSER_EXPECTED(Tokenizer::T_THEN);
 				}
-				_tokenizer->nextToken();
+				nextToken();
 
-				Node *node_then_statements = new StatementsNode();
+				Node *node_then_statements = new (_arena) StatementsNode();
 				// parseStatements
 				parseStatements(node_then_statements);
-				node_if->addChild(node_then_statements);
+				node_if->addChild(node_then_statements, _arena);
 
-				Node *node_else_statements = new StatementsNode();
+				Node *node_else_statements = new (_arena) StatementsNode();
 				if (match(Tokenizer::T_ELSE)) {
 					// else if T_ELSE -> parseStatements, match T_FI
-					_tokenizer->nextToken();
+					nextToken();
 					parseStatements(node_else_statements);
 
 					if (!match(Tokenizer::T_FI)) {
 						throw PARSER_EXPECTED(Tokenizer::T_FI);
 					}
-					_tokenizer->nextToken();
+					nextToken();
 
-					node_if->addChild(node_else_statements);
+					node_if->addChild(node_else_statements, _arena);
 				} else if (match(Tokenizer::T_FI)) {
 					// if T_FI -> return
-					_tokenizer->nextToken();
-					node_if->addChild(node_else_statements);
+					nextToken();
+					node_if->addChild(node_else_statements, _arena);
 				} else {
 					// else throw ILLEGAL
 					throw PARSER_ILLEGAL;
 				}
 
-				node->addChild(node_if);
+				node->addChild(node_if, _arena);
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_IF);
 			}
@@ -2116,19 +3022,19 @@ class Parser {
 			return result;
 		}
 
-		void parseFuncall(Node *node) {
+		Node *parseFuncall() {
 			TRACE;
 
 			if (match(Tokenizer::T_OPENING_CBRACKET)) {
-				_tokenizer->nextToken();
-				Node *node_funcall = new FuncallNode();
+				nextToken();
+				Node *node_funcall = new (_arena) FuncallNode();
 				parseId(node_funcall);
 				parseFuncallargs(node_funcall);
 				if (!match(Tokenizer::T_CLOSING_CBRACKET)) {
 					throw PARSER_EXPECTED(Tokenizer::T_CLOSING_CBRACKET);
 				}
-				_tokenizer->nextToken();
-				node->addChild(node_funcall);
+				nextToken();
+				return node_funcall;
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_OPENING_CBRACKET);
 			}
@@ -2147,10 +3053,9 @@ class Parser {
 		void parseFuncallargsrest(Node *node) {
 			TRACE;
 
-			if (match(Tokenizer::T_COMMA)) {
-				_tokenizer->nextToken();
+			while (match(Tokenizer::T_COMMA)) {
+				nextToken();
 				parseExpression(node);
-				parseFuncallargsrest(node);
 			}
 			// eps
 		}
@@ -2159,12 +3064,12 @@ class Parser {
 			TRACE;
 
 			if (isbAtomStart()) {
-				Node *node_bexpression = new BexpressionNode();
+				Node *node_bexpression = new (_arena) BexpressionNode();
 				parsebdisj(node_bexpression);
 				if (match(Tokenizer::T_OR)) {
 					parsebDisj(node_bexpression);
 				}
-				node->addChild(node_bexpression);
+				node->addChild(node_bexpression, _arena);
 			} else {
 				throw PARSER_ILLEGAL;
 			}
@@ -2175,44 +3080,44 @@ class Parser {
 			TRACE;
 
 			if (isbAtomStart()) {
-				Node *node_bdisj = new BdisjNode();
+				Node *node_bdisj = new (_arena) BdisjNode();
 				parsebAtom(node_bdisj);
 				if (match(Tokenizer::T_AND)) {
 					parsebConj(node_bdisj);
 				}
-				node->addChild(node_bdisj);
+				node->addChild(node_bdisj, _arena);
 			} else {
 				throw PARSER_ILLEGAL;
 			}
 		}
 
+		// the whole chain of "or"s is added to node
 		void parsebDisj(Node *node) {
 			TRACE;
 
 			if (match(Tokenizer::T_OR)) {
-				_tokenizer->nextToken();
-				Node *node_bDisj = new BDisjNode();
-				parsebdisj(node_bDisj);
-				if (match(Tokenizer::T_OR)) {
-					parsebDisj(node_bDisj);
-				}
-				node->addChild(node_bDisj);
+				do {
+					nextToken();
+					Node *node_bDisj = new (_arena) BDisjNode();
+					parsebdisj(node_bDisj);
+					node->addChild(node_bDisj, _arena);
+				} while (match(Tokenizer::T_OR));
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_OR);
 			}
 		}
 
+		// the whole chain of "and"s is added to node
 		void parsebConj(Node *node) {
 			TRACE;
 
 			if (match(Tokenizer::T_AND)) {
-				_tokenizer->nextToken();
-				Node *node_bConj = new BConjNode();
-				parsebAtom(node_bConj);
-				if (match(Tokenizer::T_AND)) {
-					parsebConj(node_bConj);
-				}
-				node->addChild(node_bConj);
+				do {
+					nextToken();
+					Node *node_bConj = new (_arena) BConjNode();
+					parsebAtom(node_bConj);
+					node->addChild(node_bConj, _arena);
+				} while (match(Tokenizer::T_AND));
 			} else {
 				throw PARSER_EXPECTED(Tokenizer::T_OR);
 			}
@@ -2221,37 +3126,38 @@ class Parser {
 
 		void parsebAtom(Node *node) {
 			TRACE;
+			NestingGuard guard(*this);
 
 			if (isbAtomStart()) {
-				Node *node_batom = new BAtomNode();
+				Node *node_batom = new (_arena) BAtomNode();
 
 				if (isAtomStart()) {
 					parseCmp(node_batom);
 				} else if (match(Tokenizer::T_NOT)) {
-					_tokenizer->nextToken();
-					Node *node_not = new NotNode();
+					nextToken();
+					Node *node_not = new (_arena) NotNode();
 					parsebAtom(node_not);
-					node_batom->addChild(node_not);
+					node_batom->addChild(node_not, _arena);
 				} else if (match(Tokenizer::T_OPENING_SBRACKET)) {
-					_tokenizer->nextToken();
+					nextToken();
 					parseBexpression(node_batom);
 					if (!match(Tokenizer::T_CLOSING_SBRACKET)) {
 						throw PARSER_EXPECTED(Tokenizer::T_CLOSING_SBRACKET);
 					}
-					_tokenizer->nextToken();
+					nextToken();
 				} else if (match(Tokenizer::T_TRUE)) {
-					_tokenizer->nextToken();
-					Node *node_true = new TrueNode();
-					node_batom->addChild(node_true);
+					nextToken();
+					Node *node_true = new (_arena) TrueNode();
+					node_batom->addChild(node_true, _arena);
 				} else if (match(Tokenizer::T_FALSE)) {
-					_tokenizer->nextToken();
-					Node *node_false = new FalseNode();
-					node_batom->addChild(node_false);
+					nextToken();
+					Node *node_false = new (_arena) FalseNode();
+					node_batom->addChild(node_false, _arena);
 				} else {
 					throw PARSER_ILLEGAL;
 				}
 
-				node->addChild(node_batom);
+				node->addChild(node_batom, _arena);
 			} else {
 				throw PARSER_ILLEGAL;
 			}
@@ -2262,32 +3168,28 @@ class Parser {
 			TRACE;
 
 			if (isAtomStart()) {
-				Node *node_cmp_aux = new CmpNode();
+				Node *node_left = parseBinary(0);
 				Node *node_cmp = NULL;
-				parseExpression(node_cmp_aux);
 				if (match(Tokenizer::T_LESS)) {
-					node_cmp = new CmpLessNode();
+					node_cmp = new (_arena) CmpLessNode();
 				} else if (match(Tokenizer::T_LESS_OR_EQUAL)) {
-					node_cmp = new CmpLessOrEqualNode();
+					node_cmp = new (_arena) CmpLessOrEqualNode();
 				} else if (match(Tokenizer::T_GREATER)) {
-					node_cmp = new CmpGreaterNode();
+					node_cmp = new (_arena) CmpGreaterNode();
 				} else if (match(Tokenizer::T_GREATER_OR_EQUAL)) {
-					node_cmp = new CmpGreaterOrEqualNode();
+					node_cmp = new (_arena) CmpGreaterOrEqualNode();
 				} else if (match(Tokenizer::T_EQUAL)) {
-					node_cmp = new CmpEqualNode();
+					node_cmp = new (_arena) CmpEqualNode();
 				} else if (match(Tokenizer::T_NOT_EQUAL)) {
-					node_cmp = new CmpNotEqualNode();
+					node_cmp = new (_arena) CmpNotEqualNode();
 				} else {
 					throw PARSER_ILLEGAL;
 				}
-				_tokenizer->nextToken();
+				nextToken();
 
-				node_cmp->addChild(node_cmp_aux->get(0));
-				// we don't want children to die :) (~Node() deletes children)
-				node_cmp_aux->clear();
-				delete node_cmp_aux;
+				node_cmp->addChild(node_left, _arena);
 				parseExpression(node_cmp);
-				node->addChild(node_cmp);
+				node->addChild(node_cmp, _arena);
 			} else {
 				throw PARSER_ILLEGAL;
 			}
@@ -2296,144 +3198,66 @@ class Parser {
 		void parseExpression(Node *node) {
 			TRACE;
 			if (isAtomStart()) {
-				Node *node_expression = new ExpressionNode();
-				parseterm(node_expression);
-				if (match(Tokenizer::T_PLUS)) {
-					parseTerm(node_expression);
-				} else if (match(Tokenizer::T_MINUS)) {
-					parseTerm(node_expression);
-				}
-				node->addChild(node_expression);
-			} else {
-				throw PARSER_ILLEGAL;
-			}
-		}
-
-		void parseterm(Node *node) {
-			TRACE;
-
-			if (isAtomStart()) {
-				Node *node_term = new termNode();
-				parsemult(node_term);
-				if (match(Tokenizer::T_MULT)
-						|| match(Tokenizer::T_MOD)
-						|| match(Tokenizer::T_DIV)) {
-					parseMult(node_term);
-				}
-				node->addChild(node_term);
-			} else {
-				throw PARSER_ILLEGAL;
-			}
-		}
-
-		void parsemult(Node *node) {
-			TRACE;
-
-			if (isAtomStart()) {
-				Node *node_mult = new multNode();
-				parseAtom(node_mult);
-				if (match(Tokenizer::T_MULT)
-						|| match(Tokenizer::T_MOD)
-						|| match(Tokenizer::T_DIV)) {
-					parseMult(node_mult);
-				}
-				node->addChild(node_mult);
-			} else {
-				throw PARSER_ILLEGAL;
-			}
-		}
-
-		void parseTerm(Node *node) {
-			TRACE;
-			if (match(Tokenizer::T_PLUS)
-					|| match(Tokenizer::T_MINUS)) {
-				Node *node_Term = NULL;
-
-				if (match(Tokenizer::T_PLUS)) {
-					node_Term = new PlusTermNode();
-				} else if (match(Tokenizer::T_MINUS)) {
-					node_Term = new MinusTermNode();
-				} else {
-					assert(false);
-				}
-				_tokenizer->nextToken();
-
-				parseterm(node_Term);
-				if (match(Tokenizer::T_PLUS)
-						|| match(Tokenizer::T_MINUS)) {
-					parseTerm(node_Term);
-				}
-
-				node->addChild(node_Term);
+				node->addChild(parseBinary(0), _arena);
 			} else {
 				throw PARSER_ILLEGAL;
 			}
 		}
 
-		void parseMult(Node *node) {
+		/*
+		 * Precedence climbing: an expression of the operators with
+		 * precedence of at least minPrecedence. It recurses once per
+		 * precedence level; operators of one level are taken in a loop.
+		 */
+		Node *parseBinary(int minPrecedence) {
 			TRACE;
 
-			if (match(Tokenizer::T_MULT)
-					|| match(Tokenizer::T_MOD)
-					|| match(Tokenizer::T_DIV)) {
-				Node *node_Mult = NULL;
-
-				if (match(Tokenizer::T_MULT)) {
-					node_Mult = new MultMultNode();
-				} else if (match(Tokenizer::T_MOD)) {
-					node_Mult = new ModMultNode();
-				} else if (match(Tokenizer::T_DIV)) {
-					node_Mult = new DivMultNode();
-				} else {
-					assert(false);
-				}
-				_tokenizer->nextToken();
-
-				parseAtom(node_Mult);
-				if (match(Tokenizer::T_MULT)
-						|| match(Tokenizer::T_MOD)
-						|| match(Tokenizer::T_DIV)){
-					parseMult(node_Mult);
-				}
-
-				node->addChild(node_Mult);
-			} else {
-				throw PARSER_ILLEGAL;
+			Node *left = parseAtom();
+			const BinaryOperator *op;
+			while ((op = findBinaryOperator(getToken())) != NULL
+					&& op->precedence >= minPrecedence) {
+				nextToken();
+				Node *node_binary = new (_arena) BinaryNode(op);
+				node_binary->addChild(left, _arena);
+				node_binary->addChild(parseBinary(op->precedence + 1), _arena);
+				left = node_binary;
 			}
+			return left;
 		}
 
-		void parseAtom(Node *node) {
+		// operand of a binary operator; unary minus binds tighter than them
+		Node *parseAtom() {
 			TRACE;
+			NestingGuard guard(*this);
 			if (isAtomStart()) {
-				Node *node_atom = new AtomNode();
+				Node *node_atom = NULL;
 				if (match(Tokenizer::T_ID)) {
-					parseId(node_atom);
+					node_atom = newIdNode();
+					nextToken();
 				} else if (match(Tokenizer::T_INTEGER)) {
-					Node *node_integer = new IntegerNode(_tokenizer->getTag());
-					_tokenizer->nextToken();
-					node_atom->addChild(node_integer);
+					node_atom = new (_arena) IntegerNode(copyTag());
+					nextToken();
 				}  else if (match(Tokenizer::T_OPENING_RBRACKET)) {
-					_tokenizer->nextToken();
-					parseExpression(node_atom);
+					nextToken();
+					node_atom = parseBinary(0);
 					if (!match(Tokenizer::T_CLOSING_RBRACKET)) {
 						throw PARSER_EXPECTED(Tokenizer::T_CLOSING_RBRACKET);
 					}
-					_tokenizer->nextToken();
+					nextToken();
 				} else if (match(Tokenizer::T_PLUS)) {
 					// unary plus -- just ignore
-					_tokenizer->nextToken();
-					parseAtom(node_atom);
+					nextToken();
+					node_atom = parseAtom();
 				} else if (match(Tokenizer::T_MINUS)) {
-					_tokenizer->nextToken();
-					Node *node_negation = new NegationNode();
-					parseAtom(node_negation);
-					node_atom->addChild(node_negation);
+					nextToken();
+					node_atom = new (_arena) NegationNode();
+					node_atom->addChild(parseAtom(), _arena);
 				} else if (match(Tokenizer::T_OPENING_CBRACKET)) {
-					parseFuncall(node_atom);
+					node_atom = parseFuncall();
 				} else {
 					assert(false);
 				}
-				node->addChild(node_atom);
+				return node_atom;
 			} else {
 				throw PARSER_ILLEGAL;
 			}
@@ -0,0 +1,197 @@
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include "ReadAheadSource.h"
+#include "BufferedStream.h"
+#include "Logger.h"
+
+namespace {
+
+struct Block {
+    char *data;
+    size_t length;
+    // errno of the failed read or 0
+    int error;
+};
+
+}
+
+/*
+ * Ring shared by the reader and the helper thread. The thread fills
+ * blocks[tail % BLOCK_COUNT] and publishes it with a release store of
+ * tail; the reader gives a block back with a release store of head. Each
+ * side loads the other's index with acquire, so no lock is taken while
+ * the ring is neither full nor empty. A side that has to wait sleeps on
+ * changed; the other one takes the mutex to notify only if somebody
+ * sleeps.
+ */
+class ReadAheadBuffers {
+public:
+    int fd;
+    size_t blockSize;
+    Block blocks[ReadAheadSource::BLOCK_COUNT];
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    // set when the reader is gone
+    std::atomic<bool> stop;
+    // sides sleeping on changed
+    std::atomic<int> waiting;
+    std::mutex mutex;
+    std::condition_variable changed;
+    // written by the reader to wake the thread from poll()
+    int wakeFds[2];
+
+    ReadAheadBuffers(int fd, size_t blockSize) :
+    fd(fd),
+    blockSize(blockSize),
+    head(0),
+    tail(0),
+    stop(false),
+    waiting(0) {
+        if (pipe(wakeFds) == -1) {
+            throw BufferedStreamException(LOG_MSG(strerror(errno)));
+        }
+        for (size_t i = 0; i < ReadAheadSource::BLOCK_COUNT; ++i) {
+            blocks[i].data = new char[blockSize];
+            blocks[i].length = 0;
+            blocks[i].error = 0;
+        }
+    }
+
+    ~ReadAheadBuffers() {
+        for (size_t i = 0; i < ReadAheadSource::BLOCK_COUNT; ++i) {
+            delete[] blocks[i].data;
+        }
+        close(wakeFds[0]);
+        close(wakeFds[1]);
+    }
+
+    // returns when ready() holds; the other side calls wake() after it
+    // changes what ready() looks at
+    template <class Ready>
+    void wait(Ready ready) {
+        if (ready()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        waiting.fetch_add(1, std::memory_order_relaxed);
+        // either ready() sees the change or wake() sees waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        changed.wait(lock, ready);
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            changed.notify_all();
+        }
+    }
+};
+
+static void readAhead(ReadAheadBuffers *buffers) {
+    size_t tail = 0;
+    while (true) {
+        // a full ring waits for the reader to give a block back
+        buffers->wait([&] {
+            return buffers->stop.load(std::memory_order_acquire)
+                    || tail - buffers->head.load(std::memory_order_acquire)
+                    < ReadAheadSource::BLOCK_COUNT;
+        });
+        if (buffers->stop.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        // whatever one read() gives is passed on at once, so a slow pipe
+        // is tokenized as it comes
+        Block &block = buffers->blocks[tail % ReadAheadSource::BLOCK_COUNT];
+        block.length = 0;
+        block.error = 0;
+        struct pollfd fds[2] = {
+            {buffers->fd, POLLIN, 0},
+            {buffers->wakeFds[0], POLLIN, 0}
+        };
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            block.error = errno;
+        } else if (fds[1].revents != 0) {
+            return;
+        } else {
+            ssize_t bytesRead = read(buffers->fd, block.data, buffers->blockSize);
+            if (bytesRead == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                block.error = errno;
+            } else {
+                block.length = bytesRead;
+            }
+        }
+
+        buffers->tail.store(++tail, std::memory_order_release);
+        buffers->wake();
+        // empty block is EOF
+        if (block.length == 0 || block.error != 0) {
+            return;
+        }
+    }
+}
+
+ReadAheadSource::ReadAheadSource(int fd, size_t blockSize) :
+_buffers(new ReadAheadBuffers(fd, blockSize)),
+_thread(readAhead, _buffers.get()),
+_data(NULL),
+_spos(0),
+_epos(0),
+_offset(0),
+_head(0),
+_eof(false) {
+}
+
+ReadAheadSource::~ReadAheadSource() {
+    _buffers->stop.store(true, std::memory_order_release);
+    _buffers->wake();
+    // the thread may be waiting for input in poll()
+    char wake = 0;
+    while (write(_buffers->wakeFds[1], &wake, 1) == -1 && errno == EINTR) {
+    }
+    _thread.join();
+}
+
+int ReadAheadSource::next() {
+    if (_eof) {
+        return 0;
+    }
+    if (_data != NULL) {
+        // giving the consumed block back to the thread
+        _offset += _epos;
+        _spos = 0;
+        _epos = 0;
+        _data = NULL;
+        _buffers->head.store(++_head, std::memory_order_release);
+        _buffers->wake();
+    }
+    _buffers->wait([this] {
+        return _buffers->tail.load(std::memory_order_acquire) != _head;
+    });
+
+    const Block &block = _buffers->blocks[_head % BLOCK_COUNT];
+    if (block.error != 0) {
+        throw BufferedStreamException(LOG_MSG(strerror(block.error)));
+    }
+    if (block.length == 0) {
+        _eof = true;
+        return 0;
+    }
+    _data = block.data;
+    _epos = block.length;
+    _lines.append(_data, _epos);
+    return _data[_spos++];
+}
@@ -0,0 +1,92 @@
+#ifndef READAHEADSOURCE_H
+#define	READAHEADSOURCE_H
+
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+#include "CharStream.h"
+#include "LineIndex.h"
+
+class ReadAheadBuffers;
+
+/**
+ * CharStream source for pipes and stdin: a helper thread reads ahead
+ * while the tokenizer consumes what was read before. Every read() is
+ * handed over as soon as it returns through a lock-free single-producer/
+ * single-consumer ring of BLOCK_COUNT blocks; only a side that finds the
+ * ring full or empty sleeps, on a condition variable. The destructor
+ * wakes the thread and joins it, so nothing is
+ * read from the descriptor after that. The descriptor is not closed.
+ *
+ * The symbols (and so the tokens) are the same as with FdSource.
+ */
+class ReadAheadSource {
+private:
+    std::unique_ptr<ReadAheadBuffers> _buffers;
+    std::thread _thread;
+    // current block
+    const char *_data;
+    size_t _spos;
+    size_t _epos;
+    // offset of _data[0] from the beginning of the input
+    size_t _offset;
+    // blocks taken from the ring
+    size_t _head;
+    bool _eof;
+    LineIndex _lines;
+
+    // takes the next block; returns its first symbol or 0 at EOF
+    int next();
+
+    ReadAheadSource(const ReadAheadSource &);
+    ReadAheadSource &operator=(const ReadAheadSource &);
+public:
+    // a pipe gives at most 64 KB per read()
+    const static size_t BLOCK_SIZE = 1 << 16;
+    const static size_t BLOCK_COUNT = 16;
+
+    ReadAheadSource(int fd, size_t blockSize = BLOCK_SIZE);
+    ~ReadAheadSource();
+
+    int get() {
+        if (_spos != _epos) {
+            return _data[_spos++];
+        }
+        return next();
+    }
+
+    void unget() {
+        if (!_eof) {
+            _spos--;
+        }
+    }
+
+    bool eof() const {
+        return _eof;
+    }
+
+    size_t getOffset() const {
+        return _offset + _spos;
+    }
+
+    bool isMapped() const {
+        return false;
+    }
+
+    const char *getData() const {
+        return NULL;
+    }
+
+    size_t getSize() const {
+        return _offset + _epos;
+    }
+
+    const LineIndex &getLines() const {
+        return _lines;
+    }
+};
+
+typedef CharStream<ReadAheadSource> ReadAheadCharStream;
+
+#endif	/* READAHEADSOURCE_H */
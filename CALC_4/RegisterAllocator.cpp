@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cassert>
+#include <stdint.h>
+
+#include "RegisterAllocator.h"
+
+namespace {
+
+/*
+ * Instruction p reads its operands at the position 2p and writes its
+ * result at 2p + 1, so a value read for the last time by an instruction
+ * may share the register with the result of the same instruction.
+ */
+int usePosition(int p) {
+    return 2 * p;
+}
+
+int defPosition(int p) {
+    return 2 * p + 1;
+}
+
+bool endsBlock(IrOp op) {
+    return op == IR_JMP || op == IR_BRANCH || op == IR_RET;
+}
+
+// instructions that call a function and so clobber %eax, %ecx and %edx
+bool isCall(IrOp op) {
+    return op == IR_CALL || op == IR_PRINT || op == IR_READ;
+}
+
+// a bit set per basic block
+class BlockSets {
+private:
+    std::vector<uint64_t> _words;
+    int _width;
+public:
+
+    BlockSets(int blocks, int bits) :
+    _words((size_t) blocks * ((bits + 63) / 64)),
+    _width((bits + 63) / 64) {
+    }
+
+    uint64_t *get(int block) {
+        return &_words[(size_t) block * _width];
+    }
+
+    static bool test(const uint64_t *set, int bit) {
+        return (set[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    static void set(uint64_t *set, int bit) {
+        set[bit / 64] |= (uint64_t) 1 << (bit % 64);
+    }
+};
+
+struct Occurrences {
+    int first;
+    int last;
+    int block;
+    // read before it is set in the block or used in more than one block
+    bool global;
+};
+
+void use(std::vector<Occurrences> &occurrences, const IrOperand &operand,
+        int p, int block) {
+    if (!operand.isReg()) {
+        return;
+    }
+    Occurrences &o = occurrences[operand.value];
+    if (o.first == -1) {
+        o.first = usePosition(p);
+        o.block = block;
+        o.global = true;
+    } else if (o.block != block) {
+        o.global = true;
+    }
+    o.last = usePosition(p);
+}
+
+void def(std::vector<Occurrences> &occurrences, const IrOperand &operand,
+        int p, int block) {
+    if (!operand.isReg()) {
+        return;
+    }
+    Occurrences &o = occurrences[operand.value];
+    if (o.first == -1) {
+        o.first = defPosition(p);
+        o.block = block;
+    } else if (o.block != block) {
+        o.global = true;
+    }
+    o.last = defPosition(p);
+}
+
+}
+
+const char *RegisterAllocator::getRegisterName(Register reg) {
+    static const char *names[REGISTER_COUNT] = {"%ebx", "%esi", "%edi", "%ecx"};
+    return names[reg];
+}
+
+RegisterAllocator::RegisterAllocator(const IrFunction &function) :
+_save_offsets(REGISTER_COUNT, 0),
+_scratch_offset(0),
+_frame_size(0),
+_spill_count(0) {
+    Location none = {Location::NONE, 0};
+    _locations.assign(function.getRegisterCount(), none);
+    for (int reg = 0; reg < function.getRegisterCount(); ++reg) {
+        if (function.isParameter(reg)) {
+            Location location = {Location::FRAME, function.getParameterOffset(reg)};
+            _locations[reg] = location;
+        }
+    }
+
+    std::vector<Interval> intervals;
+    computeIntervals(function, intervals);
+    scan(function, intervals);
+
+    // the frame: saved registers, spilled values, the scratch slot
+    int slots = 0;
+    for (int reg = EBX; reg <= EDI; ++reg) {
+        if (_save_offsets[reg] != 0) {
+            _save_offsets[reg] = -4 * ++slots;
+        }
+    }
+    for (size_t reg = 0; reg < _locations.size(); ++reg) {
+        Location &location = _locations[reg];
+        if (location.kind == Location::FRAME && !function.isParameter(reg)) {
+            // spill slot number until now
+            location.value = -4 * (slots + location.value + 1);
+        }
+    }
+    slots += _spill_count;
+    _scratch_offset = -4 * ++slots;
+    _frame_size = 4 * slots;
+}
+
+/*
+ * Liveness of the values used in several blocks is found with the usual
+ * backward dataflow over the blocks; an interval covers every block where
+ * its value is live. Values of one block live from the instruction that
+ * sets them to the last use.
+ */
+void RegisterAllocator::computeIntervals(const IrFunction &function,
+        std::vector<Interval> &intervals) {
+    const std::vector<IrInstruction> &code = function.getCode();
+    int size = code.size();
+    int registers = function.getRegisterCount();
+
+    // basic blocks
+    std::vector<int> blockOf(size);
+    std::vector<int> blockStarts;
+    std::vector<int> labelBlocks(function.getLabelCount(), -1);
+    for (int p = 0; p < size; ++p) {
+        if (p == 0 || code[p].op == IR_LABEL || endsBlock(code[p - 1].op)) {
+            blockStarts.push_back(p);
+        }
+        blockOf[p] = blockStarts.size() - 1;
+        if (code[p].op == IR_LABEL) {
+            labelBlocks[code[p].label] = blockOf[p];
+        }
+    }
+    int blocks = blockStarts.size();
+    blockStarts.push_back(size);
+
+    Occurrences unused = {-1, -1, -1, false};
+    std::vector<Occurrences> occurrences(registers, unused);
+    for (int p = 0; p < size; ++p) {
+        const IrInstruction &instruction = code[p];
+        use(occurrences, instruction.a, p, blockOf[p]);
+        use(occurrences, instruction.b, p, blockOf[p]);
+        if (instruction.op == IR_READ) {
+            use(occurrences, instruction.dst, p, blockOf[p]);
+        }
+        def(occurrences, instruction.dst, p, blockOf[p]);
+    }
+
+    std::vector<int> globals(registers, -1);
+    int globalCount = 0;
+    for (int reg = 0; reg < registers; ++reg) {
+        if (function.isParameter(reg)) {
+            occurrences[reg].global = true;
+        }
+        if (occurrences[reg].first != -1 && occurrences[reg].global) {
+            globals[reg] = globalCount++;
+        }
+    }
+
+    BlockSets uses(blocks, globalCount);
+    BlockSets defs(blocks, globalCount);
+    for (int p = 0; p < size; ++p) {
+        const IrInstruction &instruction = code[p];
+        const IrOperand *read[] = {&instruction.a, &instruction.b,
+            instruction.op == IR_READ ? &instruction.dst : NULL};
+        uint64_t *blockUses = uses.get(blockOf[p]);
+        uint64_t *blockDefs = defs.get(blockOf[p]);
+        for (int i = 0; i < 3; ++i) {
+            if (read[i] != NULL && read[i]->isReg() && globals[read[i]->value] != -1) {
+                int g = globals[read[i]->value];
+                if (!BlockSets::test(blockDefs, g)) {
+                    BlockSets::set(blockUses, g);
+                }
+            }
+        }
+        if (instruction.dst.isReg() && globals[instruction.dst.value] != -1) {
+            BlockSets::set(blockDefs, globals[instruction.dst.value]);
+        }
+    }
+
+    // successors of the blocks, -1 if there is none
+    std::vector<int> successors(2 * blocks, -1);
+    for (int b = 0; b < blocks; ++b) {
+        const IrInstruction &last = code[blockStarts[b + 1] - 1];
+        int next = b + 1 < blocks ? b + 1 : -1;
+        if (last.op == IR_JMP) {
+            successors[2 * b] = labelBlocks[last.label];
+        } else if (last.op == IR_BRANCH) {
+            successors[2 * b] = labelBlocks[last.label];
+            successors[2 * b + 1] = next;
+        } else if (last.op != IR_RET) {
+            successors[2 * b] = next;
+        }
+    }
+
+    BlockSets liveIn(blocks, globalCount);
+    BlockSets liveOut(blocks, globalCount);
+    int width = (globalCount + 63) / 64;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = blocks - 1; b >= 0; --b) {
+            uint64_t *in = liveIn.get(b);
+            uint64_t *out = liveOut.get(b);
+            const uint64_t *blockUses = uses.get(b);
+            const uint64_t *blockDefs = defs.get(b);
+            for (int w = 0; w < width; ++w) {
+                uint64_t word = 0;
+                for (int s = 2 * b; s < 2 * b + 2; ++s) {
+                    if (successors[s] != -1) {
+                        word |= liveIn.get(successors[s])[w];
+                    }
+                }
+                out[w] = word;
+                word = blockUses[w] | (word & ~blockDefs[w]);
+                if (word != in[w]) {
+                    in[w] = word;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // calls before the instruction p
+    std::vector<int> calls(size + 1, 0);
+    for (int p = 0; p < size; ++p) {
+        calls[p + 1] = calls[p] + (isCall(code[p].op) ? 1 : 0);
+    }
+
+    for (int reg = 0; reg < registers; ++reg) {
+        const Occurrences &o = occurrences[reg];
+        if (o.first == -1) {
+            continue;
+        }
+        Interval interval = {reg, function.isParameter(reg) ? -1 : o.first, o.last, false};
+        if (globals[reg] != -1) {
+            int g = globals[reg];
+            for (int b = 0; b < blocks; ++b) {
+                if (BlockSets::test(liveIn.get(b), g)) {
+                    interval.start = std::min(interval.start, usePosition(blockStarts[b]));
+                }
+                if (BlockSets::test(liveOut.get(b), g)) {
+                    interval.end = std::max(interval.end, defPosition(blockStarts[b + 1] - 1));
+                }
+            }
+        }
+        // live while a call at c runs: set before 2c and needed after 2c + 1
+        int first = (interval.start + 2) / 2;
+        int last = interval.end >= 2 ? (interval.end - 2) / 2 : -1;
+        interval.crossesCall = first <= last && calls[last + 1] - calls[first] > 0;
+        intervals.push_back(interval);
+    }
+}
+
+void RegisterAllocator::scan(const IrFunction &function,
+        std::vector<Interval> &intervals) {
+    std::sort(intervals.begin(), intervals.end());
+
+    static const Register anyRegister[] = {ECX, EBX, ESI, EDI};
+    static const Register savedRegister[] = {EBX, ESI, EDI};
+
+    // interval in every register, -1 if it is free
+    int owners[REGISTER_COUNT];
+    std::fill(owners, owners + REGISTER_COUNT, -1);
+
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        const Interval &current = intervals[i];
+        for (int reg = 0; reg < REGISTER_COUNT; ++reg) {
+            if (owners[reg] != -1 && intervals[owners[reg]].end < current.start) {
+                owners[reg] = -1;
+            }
+        }
+
+        const Register *candidates = current.crossesCall ? savedRegister : anyRegister;
+        int count = current.crossesCall ? 3 : 4;
+        int chosen = -1;
+        for (int k = 0; k < count && chosen == -1; ++k) {
+            if (owners[candidates[k]] == -1) {
+                chosen = candidates[k];
+            }
+        }
+
+        if (chosen == -1) {
+            // the one that is needed longest goes to the frame
+            int victim = -1;
+            for (int k = 0; k < count; ++k) {
+                int owner = owners[candidates[k]];
+                if (victim == -1 || intervals[owner].end > intervals[owners[victim]].end) {
+                    victim = candidates[k];
+                }
+            }
+            if (intervals[owners[victim]].end > current.end) {
+                spill(function, intervals[owners[victim]].reg);
+                chosen = victim;
+            } else {
+                spill(function, current.reg);
+                continue;
+            }
+        }
+
+        owners[chosen] = i;
+        Location location = {Location::REGISTER, chosen};
+        _locations[current.reg] = location;
+        if (chosen != ECX) {
+            _save_offsets[chosen] = 1;
+        }
+    }
+}
+
+void RegisterAllocator::spill(const IrFunction &function, int reg) {
+    if (function.isParameter(reg)) {
+        // stays where the caller has put it
+        Location location = {Location::FRAME, function.getParameterOffset(reg)};
+        _locations[reg] = location;
+    } else {
+        // the offset is known when all the spills are
+        Location location = {Location::FRAME, _spill_count++};
+        _locations[reg] = location;
+    }
+}
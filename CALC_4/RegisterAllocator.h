@@ -0,0 +1,109 @@
+#ifndef REGISTERALLOCATOR_H
+#define	REGISTERALLOCATOR_H
+
+#include <vector>
+
+#include "Ir.h"
+
+/**
+ * Linear scan register allocation over the live intervals of the virtual
+ * registers of an IrFunction.
+ *
+ * An interval spans the positions of the code where the register is live,
+ * found from the liveness of the basic blocks, so a variable used in a loop
+ * is live in the whole loop. Intervals are taken in the order of their
+ * starts; each gets a register that is free at that moment or, if there is
+ * none, the interval ending last of the active ones and this one is spilled
+ * to the frame.
+ *
+ * %eax and %edx are left to the emitted code (division, calls, moving
+ * between two memory operands). %ecx is clobbered by the calls, so values
+ * live across a call get only %ebx, %esi and %edi; these are saved by the
+ * function when it uses them.
+ */
+class RegisterAllocator {
+public:
+
+    enum Register {
+        EBX,
+        ESI,
+        EDI,
+        ECX,
+        REGISTER_COUNT
+    };
+
+    // where a virtual register is kept
+    struct Location {
+
+        enum Kind {
+            // the register is never used
+            NONE,
+            REGISTER,
+            FRAME
+        };
+
+        Kind kind;
+        // Register or the offset from %ebp
+        int value;
+    };
+
+    explicit RegisterAllocator(const IrFunction &function);
+
+    const Location &getLocation(int reg) const {
+        return _locations[reg];
+    }
+
+    // callee-saved registers the function has to save
+    bool isSaved(Register reg) const {
+        return _save_offsets[reg] != 0;
+    }
+
+    int getSaveOffset(Register reg) const {
+        return _save_offsets[reg];
+    }
+
+    // a slot of the frame for the code (e.g. the address for scanf)
+    int getScratchOffset() const {
+        return _scratch_offset;
+    }
+
+    // bytes below %ebp
+    int getFrameSize() const {
+        return _frame_size;
+    }
+
+    int getSpillCount() const {
+        return _spill_count;
+    }
+
+    static const char *getRegisterName(Register reg);
+
+private:
+
+    struct Interval {
+        int reg;
+        int start;
+        int end;
+        bool crossesCall;
+
+        bool operator<(const Interval &other) const {
+            return start < other.start || (start == other.start && reg < other.reg);
+        }
+    };
+
+    std::vector<Location> _locations;
+    std::vector<int> _save_offsets;
+    int _scratch_offset;
+    int _frame_size;
+    int _spill_count;
+
+    static void computeIntervals(const IrFunction &function,
+            std::vector<Interval> &intervals);
+    void scan(const IrFunction &function, std::vector<Interval> &intervals);
+    void spill(const IrFunction &function, int reg);
+
+    RegisterAllocator(const RegisterAllocator &);
+    RegisterAllocator &operator=(const RegisterAllocator &);
+};
+
+#endif	/* REGISTERALLOCATOR_H */
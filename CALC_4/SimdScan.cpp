@@ -0,0 +1,222 @@
+#include "SimdScan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMDSCAN_X86
+#endif
+
+static inline bool isWhitespace(unsigned char symbol) {
+    // ' ', \t, \n, \v, \f, \r
+    return symbol == ' ' || (unsigned char) (symbol - '\t') <= '\r' - '\t';
+}
+
+/* scalar */
+
+static size_t skipWhitespaceScalar(const char *data, size_t pos, size_t size) {
+    while (pos < size && isWhitespace(data[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+static size_t findNewlineScalar(const char *data, size_t pos, size_t size) {
+    while (pos < size && data[pos] != '\n') {
+        pos++;
+    }
+    return pos;
+}
+
+static size_t findCommentEndScalar(const char *data, size_t pos, size_t size) {
+    for (; pos + 1 < size; ++pos) {
+        if (data[pos] == '*' && data[pos + 1] == '/') {
+            return pos;
+        }
+    }
+    // unterminated comment lasts till the end of the input
+    return size;
+}
+
+#ifdef SIMDSCAN_X86
+
+/* SSE2, 16 bytes per step */
+
+static inline unsigned whitespaceMaskSse2(__m128i v) {
+    // symbol - '\t' <= 4 (unsigned) or symbol == ' '
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(4)), d);
+    __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return _mm_movemask_epi8(_mm_or_si128(control, space));
+}
+
+static size_t skipWhitespaceSse2(const char *data, size_t pos, size_t size) {
+    // most runs between tokens are a single space
+    if (pos < size && !isWhitespace(data[pos])) {
+        return pos;
+    }
+    while (pos + 16 <= size) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + pos));
+        unsigned spaces = whitespaceMaskSse2(v);
+        if (spaces != 0xFFFF) {
+            return pos + __builtin_ctz(~spaces);
+        }
+        pos += 16;
+    }
+    return skipWhitespaceScalar(data, pos, size);
+}
+
+static size_t findNewlineSse2(const char *data, size_t pos, size_t size) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (pos + 16 <= size) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + pos));
+        unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (newlines != 0) {
+            return pos + __builtin_ctz(newlines);
+        }
+        pos += 16;
+    }
+    return findNewlineScalar(data, pos, size);
+}
+
+static size_t findCommentEndSse2(const char *data, size_t pos, size_t size) {
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i slash = _mm_set1_epi8('/');
+    // the second load looks one byte further
+    while (pos + 17 <= size) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + pos));
+        __m128i next = _mm_loadu_si128((const __m128i *) (data + pos + 1));
+        unsigned ends = _mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpeq_epi8(v, star), _mm_cmpeq_epi8(next, slash)));
+        if (ends != 0) {
+            return pos + __builtin_ctz(ends);
+        }
+        pos += 16;
+    }
+    return findCommentEndScalar(data, pos, size);
+}
+
+/* AVX2, 32 bytes per step */
+
+__attribute__((target("avx2")))
+static inline unsigned whitespaceMaskAvx2(__m256i v) {
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(4)), d);
+    __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    return _mm256_movemask_epi8(_mm256_or_si256(control, space));
+}
+
+__attribute__((target("avx2")))
+static size_t skipWhitespaceAvx2(const char *data, size_t pos, size_t size) {
+    // most runs between tokens are a single space
+    if (pos < size && !isWhitespace(data[pos])) {
+        return pos;
+    }
+    while (pos + 32 <= size) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + pos));
+        unsigned spaces = whitespaceMaskAvx2(v);
+        if (spaces != 0xFFFFFFFF) {
+            return pos + __builtin_ctz(~spaces);
+        }
+        pos += 32;
+    }
+    return skipWhitespaceSse2(data, pos, size);
+}
+
+__attribute__((target("avx2")))
+static size_t findNewlineAvx2(const char *data, size_t pos, size_t size) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (pos + 32 <= size) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + pos));
+        unsigned newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+        if (newlines != 0) {
+            return pos + __builtin_ctz(newlines);
+        }
+        pos += 32;
+    }
+    return findNewlineSse2(data, pos, size);
+}
+
+__attribute__((target("avx2")))
+static size_t findCommentEndAvx2(const char *data, size_t pos, size_t size) {
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i slash = _mm256_set1_epi8('/');
+    while (pos + 33 <= size) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + pos));
+        __m256i next = _mm256_loadu_si256((const __m256i *) (data + pos + 1));
+        unsigned ends = _mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpeq_epi8(v, star), _mm256_cmpeq_epi8(next, slash)));
+        if (ends != 0) {
+            return pos + __builtin_ctz(ends);
+        }
+        pos += 32;
+    }
+    return findCommentEndSse2(data, pos, size);
+}
+
+#endif /* SIMDSCAN_X86 */
+
+SimdScan::Level SimdScan::_level = SimdScan::SCALAR;
+SimdScan::FindFunction SimdScan::_skipWhitespace = skipWhitespaceScalar;
+SimdScan::FindFunction SimdScan::_findNewline = findNewlineScalar;
+SimdScan::FindFunction SimdScan::_findCommentEnd = findCommentEndScalar;
+bool SimdScan::_initialized = SimdScan::init();
+
+bool SimdScan::init() {
+    setLevel(getMaxLevel());
+    return true;
+}
+
+SimdScan::Level SimdScan::getMaxLevel() {
+#ifdef SIMDSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SSE2;
+    }
+#endif
+    return SCALAR;
+}
+
+SimdScan::Level SimdScan::getLevel() {
+    return _level;
+}
+
+bool SimdScan::setLevel(Level level) {
+    if (level > getMaxLevel()) {
+        return false;
+    }
+
+    switch (level) {
+#ifdef SIMDSCAN_X86
+        case AVX2:
+            _skipWhitespace = skipWhitespaceAvx2;
+            _findNewline = findNewlineAvx2;
+            _findCommentEnd = findCommentEndAvx2;
+            break;
+        case SSE2:
+            _skipWhitespace = skipWhitespaceSse2;
+            _findNewline = findNewlineSse2;
+            _findCommentEnd = findCommentEndSse2;
+            break;
+#endif
+        default:
+            _skipWhitespace = skipWhitespaceScalar;
+            _findNewline = findNewlineScalar;
+            _findCommentEnd = findCommentEndScalar;
+            break;
+    }
+    _level = level;
+    return true;
+}
+
+const char *SimdScan::getLevelName(Level level) {
+    switch (level) {
+        case AVX2:
+            return "avx2";
+        case SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
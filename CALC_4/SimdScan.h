@@ -0,0 +1,56 @@
+#ifndef SIMDSCAN_H
+#define	SIMDSCAN_H
+
+#include <cstddef>
+
+/**
+ * Bulk scanning of the contiguous input for the lexer: whitespace runs,
+ * end of line comments and end of block comments.
+ *
+ * The best implementation supported by the CPU is picked at startup;
+ * setLevel() switches it (e.g. to compare with the scalar code).
+ */
+class SimdScan {
+public:
+
+    enum Level {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+private:
+    typedef size_t(*FindFunction)(const char *data, size_t pos, size_t size);
+
+    static Level _level;
+    static FindFunction _skipWhitespace;
+    static FindFunction _findNewline;
+    static FindFunction _findCommentEnd;
+    static bool _initialized;
+
+    static bool init();
+public:
+
+    // offset of the first non-whitespace symbol at or after pos (or size)
+    static size_t skipWhitespace(const char *data, size_t pos, size_t size) {
+        return _skipWhitespace(data, pos, size);
+    }
+
+    // offset of the first '\n' at or after pos (or size)
+    static size_t findNewline(const char *data, size_t pos, size_t size) {
+        return _findNewline(data, pos, size);
+    }
+
+    // offset of the first "*/" at or after pos (or size)
+    static size_t findCommentEnd(const char *data, size_t pos, size_t size) {
+        return _findCommentEnd(data, pos, size);
+    }
+
+    static Level getMaxLevel();
+    static Level getLevel();
+    // returns false if the level is not supported
+    static bool setLevel(Level level);
+    static const char *getLevelName(Level level);
+};
+
+#endif	/* SIMDSCAN_H */
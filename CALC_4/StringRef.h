@@ -0,0 +1,66 @@
+#ifndef STRINGREF_H
+#define	STRINGREF_H
+
+#include <cstring>
+#include <string>
+
+/**
+ * Non-owning reference to a range of characters (e.g. token in the source).
+ * The referenced memory must outlive the StringRef; use str() to get
+ * an owned copy.
+ */
+class StringRef {
+private:
+    const char *_data;
+    size_t _length;
+public:
+
+    StringRef() : _data(""), _length(0) {
+    }
+
+    StringRef(const char *data, size_t length) : _data(data), _length(length) {
+    }
+
+    StringRef(const std::string &str) : _data(str.data()), _length(str.length()) {
+    }
+
+    const char *data() const {
+        return _data;
+    }
+
+    size_t length() const {
+        return _length;
+    }
+
+    bool empty() const {
+        return _length == 0;
+    }
+
+    char operator[](size_t index) const {
+        return _data[index];
+    }
+
+    std::string str() const {
+        return std::string(_data, _length);
+    }
+
+    bool operator==(const StringRef &other) const {
+        return _length == other._length
+                && std::memcmp(_data, other._data, _length) == 0;
+    }
+
+    bool operator!=(const StringRef &other) const {
+        return !(*this == other);
+    }
+
+    bool operator==(const char *other) const {
+        return std::strlen(other) == _length
+                && std::memcmp(_data, other, _length) == 0;
+    }
+
+    bool operator!=(const char *other) const {
+        return !(*this == other);
+    }
+};
+
+#endif	/* STRINGREF_H */
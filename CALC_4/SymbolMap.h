@@ -0,0 +1,111 @@
+#ifndef SYMBOLMAP_H
+#define	SYMBOLMAP_H
+
+#include <cstddef>
+#include <vector>
+
+#include "SymbolPool.h"
+
+/**
+ * Hash table from Symbol to Value: open addressing with linear probing
+ * in one array of entries. NO_SYMBOL marks a free entry, so it cannot
+ * be a key. Entries are only removed all at once by clear().
+ *
+ * To go through the entries:
+ *   for (size_t i = 0; i < map.getCapacity(); ++i)
+ *       if (map.getKey(i) != NO_SYMBOL) ... map.getValue(i) ...
+ */
+template <class Value>
+class SymbolMap {
+private:
+    struct Entry {
+        Symbol key;
+        Value value;
+    };
+
+    std::vector<Entry> _entries;
+    size_t _size;
+
+    const static size_t INITIAL_CAPACITY = 16;
+
+    // symbols are consecutive integers; spread them over the table
+    size_t getSlot(Symbol key) const {
+        return (key * 2654435761u) & (_entries.size() - 1);
+    }
+
+    size_t findSlot(Symbol key) const {
+        size_t slot = getSlot(key);
+        while (_entries[slot].key != key && _entries[slot].key != NO_SYMBOL) {
+            slot = (slot + 1) & (_entries.size() - 1);
+        }
+        return slot;
+    }
+
+    void grow() {
+        std::vector<Entry> entries(2 * _entries.size(), Entry());
+        entries.swap(_entries);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].key != NO_SYMBOL) {
+                _entries[findSlot(entries[i].key)] = entries[i];
+            }
+        }
+    }
+public:
+
+    SymbolMap() : _entries(INITIAL_CAPACITY, Entry()), _size(0) {
+    }
+
+    // NULL if there is no key
+    Value *find(Symbol key) {
+        Entry &entry = _entries[findSlot(key)];
+        return entry.key == key ? &entry.value : NULL;
+    }
+
+    const Value *find(Symbol key) const {
+        const Entry &entry = _entries[findSlot(key)];
+        return entry.key == key ? &entry.value : NULL;
+    }
+
+    bool contains(Symbol key) const {
+        return find(key) != NULL;
+    }
+
+    // inserts Value() if there is no key
+    Value &operator[](Symbol key) {
+        size_t slot = findSlot(key);
+        if (_entries[slot].key == NO_SYMBOL) {
+            // at most 3/4 of the entries are used
+            if (4 * (_size + 1) > 3 * _entries.size()) {
+                grow();
+                slot = findSlot(key);
+            }
+            _entries[slot].key = key;
+            _entries[slot].value = Value();
+            ++_size;
+        }
+        return _entries[slot].value;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    void clear() {
+        _entries.assign(INITIAL_CAPACITY, Entry());
+        _size = 0;
+    }
+
+    size_t getCapacity() const {
+        return _entries.size();
+    }
+
+    Symbol getKey(size_t index) const {
+        return _entries[index].key;
+    }
+
+    Value &getValue(size_t index) {
+        return _entries[index].value;
+    }
+};
+
+#endif	/* SYMBOLMAP_H */
@@ -0,0 +1,73 @@
+#include "SymbolPool.h"
+
+namespace {
+const size_t INITIAL_SLOTS = 256;
+}
+
+SymbolPool::SymbolPool() {
+    clear();
+}
+
+// FNV-1a
+unsigned SymbolPool::hash(StringRef name) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < name.length(); ++i) {
+        h = (h ^ static_cast<unsigned char> (name[i])) * 16777619u;
+    }
+    return h;
+}
+
+Symbol SymbolPool::intern(StringRef name) {
+    if (name.empty()) {
+        return NO_SYMBOL;
+    }
+
+    unsigned h = hash(name);
+    size_t mask = _slots.size() - 1;
+    size_t slot = h & mask;
+    while (_slots[slot] != NO_SYMBOL) {
+        Symbol symbol = _slots[slot];
+        if (_hashes[symbol] == h && _names[symbol] == name) {
+            return symbol;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    Symbol symbol = _names.size();
+    _names.push_back(_text.copy(name));
+    _hashes.push_back(h);
+    _slots[slot] = symbol;
+
+    // at most half of the slots are used
+    if (2 * _names.size() > _slots.size()) {
+        grow();
+    }
+    return symbol;
+}
+
+void SymbolPool::grow() {
+    std::vector<Symbol> slots(2 * _slots.size(), NO_SYMBOL);
+    size_t mask = slots.size() - 1;
+    for (Symbol symbol = 1; symbol < _names.size(); ++symbol) {
+        size_t slot = _hashes[symbol] & mask;
+        while (slots[slot] != NO_SYMBOL) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = symbol;
+    }
+    _slots.swap(slots);
+}
+
+void SymbolPool::clear() {
+    _text.release();
+    _names.assign(1, StringRef());
+    _hashes.assign(1, 0);
+    _slots.assign(INITIAL_SLOTS, NO_SYMBOL);
+}
+
+size_t SymbolPool::getMemoryUsage() const {
+    return _text.getBytesReserved()
+            + _names.capacity() * sizeof (StringRef)
+            + _hashes.capacity() * sizeof (unsigned)
+            + _slots.capacity() * sizeof (Symbol);
+}
@@ -0,0 +1,57 @@
+#ifndef SYMBOLPOOL_H
+#define	SYMBOLPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Arena.h"
+#include "StringRef.h"
+
+// interned name; equal names have equal symbols
+typedef unsigned Symbol;
+
+// symbol of the empty name
+const Symbol NO_SYMBOL = 0;
+
+/**
+ * Interns names: every distinct name is stored once and gets a small
+ * integer Symbol (0, 1, 2, ... in the order of interning), so tables
+ * of names compare integers instead of strings (see SymbolMap).
+ * The lookup is an open-addressing hash table of symbols.
+ */
+class SymbolPool {
+private:
+    // characters of the names
+    Arena _text;
+    // name and its hash by symbol
+    std::vector<StringRef> _names;
+    std::vector<unsigned> _hashes;
+    // symbols at the slots of their hashes; NO_SYMBOL marks a free slot
+    std::vector<Symbol> _slots;
+
+    static unsigned hash(StringRef name);
+    void grow();
+
+    SymbolPool(const SymbolPool &);
+    SymbolPool &operator=(const SymbolPool &);
+public:
+    SymbolPool();
+
+    Symbol intern(StringRef name);
+
+    // the name stays valid until clear()
+    StringRef getName(Symbol symbol) const {
+        return _names[symbol];
+    }
+
+    // number of symbols, NO_SYMBOL included
+    size_t size() const {
+        return _names.size();
+    }
+
+    void clear();
+
+    size_t getMemoryUsage() const;
+};
+
+#endif	/* SYMBOLPOOL_H */
@@ -0,0 +1,81 @@
+#include <climits>
+
+#include "TokenBuffer.h"
+#include "Logger.h"
+
+TokenBuffer::TokenBuffer() :
+_source(NULL),
+_source_size(0) {
+}
+
+void TokenBuffer::setSource(const char *source, size_t size) {
+    _source = source;
+    _source_size = size;
+    _lines.clear();
+}
+
+void TokenBuffer::setLines(const LineIndex &lines) {
+    _lines = lines;
+}
+
+void TokenBuffer::reserve(size_t count) {
+    _types.reserve(count);
+    _offsets.reserve(count);
+    _lengths.reserve(count);
+    _symbols.reserve(count);
+}
+
+void TokenBuffer::clear() {
+    _types.clear();
+    _offsets.clear();
+    _lengths.clear();
+    _text_offsets.clear();
+    _symbols.clear();
+    _text.clear();
+    _lines.clear();
+    _pool.clear();
+}
+
+void TokenBuffer::add(Tokenizer::ValueType type, size_t offset, size_t length) {
+    // offsets are kept in 32 bits; the copied tags are no longer than the
+    // input before them, so _text_offsets fit as well
+    if (offset > UINT_MAX || length > UINT_MAX - offset) {
+        throw TokenizerException(LOG_MSG("Input of 4 GiB or more is not supported"));
+    }
+    _types.push_back(type);
+    _offsets.push_back(offset);
+    _lengths.push_back(length);
+    _symbols.push_back(type == Tokenizer::T_ID
+            ? _pool.intern(getTagRef(_types.size() - 1)) : NO_SYMBOL);
+}
+
+void TokenBuffer::add(Tokenizer::ValueType type, size_t offset, StringRef tag) {
+    _text_offsets.push_back(_text.length());
+    _text.append(tag.data(), tag.length());
+    add(type, offset, tag.length());
+}
+
+int TokenBuffer::getLineNumber(size_t index) const {
+    if (_source != NULL) {
+        _lines.update(_source, _source_size);
+    }
+    return _lines.getLineNumber(_offsets[index]);
+}
+
+int TokenBuffer::getLinePosition(size_t index) const {
+    if (_source != NULL) {
+        _lines.update(_source, _source_size);
+    }
+    return _lines.getLinePosition(_offsets[index]);
+}
+
+size_t TokenBuffer::getMemoryUsage() const {
+    return _types.capacity() * sizeof(unsigned char)
+            + _offsets.capacity() * sizeof(unsigned int)
+            + _lengths.capacity() * sizeof(unsigned int)
+            + _text_offsets.capacity() * sizeof(unsigned int)
+            + _symbols.capacity() * sizeof(Symbol)
+            + _text.capacity()
+            + _lines.getMemoryUsage()
+            + _pool.getMemoryUsage();
+}
@@ -0,0 +1,101 @@
+#ifndef TOKENBUFFER_H
+#define	TOKENBUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Tokenizer.h"
+#include "StringRef.h"
+#include "LineIndex.h"
+#include "SymbolPool.h"
+
+/**
+ * All tokens of the input stored as structure of arrays, so that parser
+ * can address any token by index (arbitrary lookahead and backtracking).
+ * Tags point into the mapped source if there is one; otherwise they are
+ * copied into the buffer's own text.
+ * Tokens are located by offsets in the input; line and position are
+ * looked up in the line index only for error messages.
+ * Identifiers are interned into the buffer's SymbolPool as they are
+ * added; other tokens have NO_SYMBOL.
+ */
+class TokenBuffer {
+private:
+    std::vector<unsigned char> _types;
+    std::vector<unsigned int> _offsets;
+    std::vector<unsigned int> _lengths;
+    // offsets of the tags in _text if there is no source
+    std::vector<unsigned int> _text_offsets;
+    std::vector<Symbol> _symbols;
+
+    // mapped source or NULL if tags are kept in _text
+    const char *_source;
+    size_t _source_size;
+    std::string _text;
+    // indexed on the first query if there is the source
+    mutable LineIndex _lines;
+    SymbolPool _pool;
+
+    TokenBuffer(const TokenBuffer &);
+    TokenBuffer &operator=(const TokenBuffer &);
+public:
+
+    TokenBuffer();
+
+    void setSource(const char *source, size_t size);
+    // lines of the input without source (see setSource())
+    void setLines(const LineIndex &lines);
+    void reserve(size_t count);
+    void clear();
+
+    // tag is at offset in the source; throws TokenizerException if the
+    // tag ends past 4 GiB
+    void add(Tokenizer::ValueType type, size_t offset, size_t length);
+    // tag is copied
+    void add(Tokenizer::ValueType type, size_t offset, StringRef tag);
+
+    size_t size() const {
+        return _types.size();
+    }
+
+    Tokenizer::ValueType getType(size_t index) const {
+        return static_cast<Tokenizer::ValueType> (_types[index]);
+    }
+
+    size_t getOffset(size_t index) const {
+        return _offsets[index];
+    }
+
+    size_t getLength(size_t index) const {
+        return _lengths[index];
+    }
+
+    StringRef getTagRef(size_t index) const {
+        if (_source != NULL) {
+            return StringRef(_source + _offsets[index], _lengths[index]);
+        }
+        return StringRef(_text.data() + _text_offsets[index], _lengths[index]);
+    }
+
+    std::string getTag(size_t index) const {
+        return getTagRef(index).str();
+    }
+
+    Symbol getSymbol(size_t index) const {
+        return _symbols[index];
+    }
+
+    // names of the symbols stay valid until clear()
+    const SymbolPool &getSymbols() const {
+        return _pool;
+    }
+
+    int getLineNumber(size_t index) const;
+    int getLinePosition(size_t index) const;
+
+    // bytes used by the arrays and symbols (not counting the source)
+    size_t getMemoryUsage() const;
+};
+
+#endif	/* TOKENBUFFER_H */
@@ -1,17 +1,20 @@
 #include <assert.h>
 #include <cctype>
+#include <cstring>
 #include <vector>
 #include <math.h>
 #include "Tokenizer.h"
-#include "create_map.h"
+#include "TokenBuffer.h"
+#include "DfaLexer.h"
 
 #include "Logger.h"
 #include "LocatableStream.h"
+#include "CharStream.h"
+#include "ReadAheadSource.h"
 
 using std::istream;
 using std::string;
 using std::exception;
-using std::map;
 using std::vector;
 
 TokenizerException::TokenizerException(string msg) :
@@ -24,124 +27,287 @@ TokenizerException::~TokenizerException() throw () {
 const char *TokenizerException::what() const throw () {
     return _msg.c_str();
 }
-map<Tokenizer::ValueType, string> Tokenizer::_valueTypeTags =
-        create_map<Tokenizer::ValueType, string>
-        (T_UNDEFINED, "Undefined symbol")
-(T_ID, "ID")
-(T_INTEGER, "Integer")
-//(T_FLOAT, "Float")
-(T_PLUS, "Plus")
-(T_MINUS, "Minus")
-(T_MULT, "Multiplication")
-(T_DIV, "Division")
-//(T_POWER, "Power")
-(T_MOD, "Mod")
-(T_ASSIGNMENT, "Assignment")
-(T_SEMICOLON, "Semicolon")
-(T_OPENING_RBRACKET, "Opening round bracket")
-(T_CLOSING_RBRACKET, "Closing round bracket")
-(T_OPENING_CBRACKET, "Opening curly bracket")
-(T_CLOSING_CBRACKET, "Closing curly bracket")
-(T_EOF, "End Of File")
-(T_TYPE_INT, "Integer type")
-//(T_TYPE_FLOAT, "Float type")
-(T_READ, "Read operation")
-(T_PRINT, "Print operation")
-(T_FOR, "For")
-(T_WHILE, "While")
-(T_IF, "If")
-(T_ELSE, "Else")
-(T_LESS, "Less")
-(T_LESS_OR_EQUAL, "Less or equal")
-(T_GREATER, "Greater")
-(T_GREATER_OR_EQUAL, "Greater or equal")
-//(T_SHIFT_LEFT, "Shift left")
-//(T_SHIFT_RIGHT, "Shift right")
-(T_EQUAL, "Equal")
-(T_NOT_EQUAL, "Not equal")
-(T_OPENING_SBRACKET, "Opening square bracket")
-(T_CLOSING_SBRACKET, "Closing square bracket")
-(T_AND, "And")
-(T_OR, "Or")
-(T_NOT, "Not")
-(T_FALSE, "False")
-(T_TRUE, "True")
-(T_RETURN, "Return")
-
-(T_DEF, "Define function")
-(T_COLON, "Colon")
-(T_ENDDEF, "Define function end")
-(T_COMMA, "Comma")
-(T_DO, "Do")
-(T_DONE, "Done")
-(T_THEN, "Then")
-//(T_DOT, "Dot")
-(T_FI, "Fi");
-
-
-Tokenizer::Tokenizer(LocatableStream &stream) :
-_type(Tokenizer::T_UNDEFINED),
+
+constexpr frozen_map<TokenizerBase::ValueType, const char *, TokenizerBase::VALUE_TYPE_COUNT>
+TokenizerBase::_valueTypeTags = {{
+    {T_UNDEFINED, "Undefined symbol"},
+    {T_ID, "ID"},
+    {T_INTEGER, "Integer"},
+    //{T_FLOAT, "Float"},
+    {T_PLUS, "Plus"},
+    {T_MINUS, "Minus"},
+    {T_MULT, "Multiplication"},
+    {T_DIV, "Division"},
+    //{T_POWER, "Power"},
+    {T_MOD, "Mod"},
+    {T_ASSIGNMENT, "Assignment"},
+    {T_SEMICOLON, "Semicolon"},
+    {T_OPENING_RBRACKET, "Opening round bracket"},
+    {T_CLOSING_RBRACKET, "Closing round bracket"},
+    {T_OPENING_CBRACKET, "Opening curly bracket"},
+    {T_CLOSING_CBRACKET, "Closing curly bracket"},
+    {T_EOF, "End Of File"},
+    {T_TYPE_INT, "Integer type"},
+    //{T_TYPE_FLOAT, "Float type"},
+    {T_PRINT, "Print operation"},
+    {T_READ, "Read operation"},
+    {T_FOR, "For"},
+    {T_WHILE, "While"},
+    {T_IF, "If"},
+    {T_ELSE, "Else"},
+    {T_LESS, "Less"},
+    {T_LESS_OR_EQUAL, "Less or equal"},
+    {T_GREATER, "Greater"},
+    {T_GREATER_OR_EQUAL, "Greater or equal"},
+    //{T_SHIFT_LEFT, "Shift left"},
+    //{T_SHIFT_RIGHT, "Shift right"},
+    {T_EQUAL, "Equal"},
+    {T_NOT_EQUAL, "Not equal"},
+    {T_OPENING_SBRACKET, "Opening square bracket"},
+    {T_CLOSING_SBRACKET, "Closing square bracket"},
+    {T_AND, "And"},
+    {T_OR, "Or"},
+    {T_NOT, "Not"},
+    {T_FALSE, "False"},
+    {T_TRUE, "True"},
+    {T_RETURN, "Return"},
+
+    {T_DEF, "Define function"},
+    {T_COLON, "Colon"},
+    {T_ENDDEF, "Define function end"},
+    {T_COMMA, "Comma"},
+    {T_DO, "Do"},
+    {T_DONE, "Done"},
+    {T_THEN, "Then"},
+    //{T_DOT, "Dot"},
+    {T_FI, "Fi"},
+}};
+
+static_assert(TokenizerBase::_valueTypeTags.isDense(),
+        "_valueTypeTags must list every ValueType in the order of declaration");
+
+/*
+ * Keywords are found with perfect hash of the length, the first and the last
+ * symbols. To add a keyword append it to _keywords; if static_assert below
+ * reports a collision, pick other KEYWORD_HASH_* multipliers.
+ */
+namespace {
+
+struct Keyword {
+    const char *tag;
+    Tokenizer::ValueType type;
+};
+
+constexpr Keyword _keywords[] = {
+    {"int", Tokenizer::T_TYPE_INT},
+    {"read", Tokenizer::T_READ},
+    {"print", Tokenizer::T_PRINT},
+    {"for", Tokenizer::T_FOR},
+    {"while", Tokenizer::T_WHILE},
+    {"if", Tokenizer::T_IF},
+    {"else", Tokenizer::T_ELSE},
+    {"and", Tokenizer::T_AND},
+    {"or", Tokenizer::T_OR},
+    {"not", Tokenizer::T_NOT},
+    {"false", Tokenizer::T_FALSE},
+    {"true", Tokenizer::T_TRUE},
+    {"return", Tokenizer::T_RETURN},
+    {"def", Tokenizer::T_DEF},
+    {"enddef", Tokenizer::T_ENDDEF},
+    {"do", Tokenizer::T_DO},
+    {"done", Tokenizer::T_DONE},
+    {"then", Tokenizer::T_THEN},
+    {"fi", Tokenizer::T_FI},
+};
+
+const size_t KEYWORD_COUNT = sizeof(_keywords) / sizeof(_keywords[0]);
+const size_t KEYWORD_TABLE_SIZE = 64; // power of 2
+const unsigned KEYWORD_HASH_LENGTH = 6;
+const unsigned KEYWORD_HASH_FIRST = 2;
+const unsigned KEYWORD_HASH_LAST = 1;
+
+constexpr size_t keywordLength(const char *tag) {
+    return *tag ? 1 + keywordLength(tag + 1) : 0;
+}
+
+constexpr unsigned keywordHash(size_t length, unsigned char first, unsigned char last) {
+    return (length * KEYWORD_HASH_LENGTH
+            + first * KEYWORD_HASH_FIRST
+            + last * KEYWORD_HASH_LAST) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+constexpr unsigned keywordHash(const char *tag) {
+    return keywordHash(keywordLength(tag), tag[0], tag[keywordLength(tag) - 1]);
+}
+
+// true if i-th keyword doesn't collide with j-th and all the following
+constexpr bool isKeywordHashUnique(size_t i, size_t j) {
+    return j >= KEYWORD_COUNT
+            || (keywordHash(_keywords[i].tag) != keywordHash(_keywords[j].tag)
+            && isKeywordHashUnique(i, j + 1));
+}
+
+constexpr bool isKeywordHashPerfect(size_t i) {
+    return i >= KEYWORD_COUNT
+            || (isKeywordHashUnique(i, i + 1) && isKeywordHashPerfect(i + 1));
+}
+
+static_assert(isKeywordHashPerfect(0), "Keyword hash collision, change KEYWORD_HASH_* multipliers");
+
+struct KeywordSlot {
+    const char *tag;
+    size_t length;
+    Tokenizer::ValueType type;
+};
+
+// the keyword with the hash, KEYWORD_COUNT if there is none
+constexpr size_t findKeyword(unsigned hash, size_t i = 0) {
+    return i >= KEYWORD_COUNT || keywordHash(_keywords[i].tag) == hash
+            ? i : findKeyword(hash, i + 1);
+}
+
+constexpr KeywordSlot makeKeywordSlot(size_t keyword) {
+    return keyword < KEYWORD_COUNT
+            ? KeywordSlot{_keywords[keyword].tag,
+                keywordLength(_keywords[keyword].tag), _keywords[keyword].type}
+            : KeywordSlot{NULL, 0, Tokenizer::T_ID};
+}
+
+struct KeywordSlots {
+    KeywordSlot slots[KEYWORD_TABLE_SIZE];
+};
+
+template <size_t... I>
+struct Indices {
+};
+
+// Indices<0, ..., N - 1>
+template <size_t N, size_t... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {
+};
+
+template <size_t... I>
+struct MakeIndices<0, I...> {
+    typedef Indices<I...> type;
+};
+
+template <size_t... I>
+constexpr KeywordSlots makeKeywordSlots(Indices<I...>) {
+    return KeywordSlots{{makeKeywordSlot(findKeyword(I))...}};
+}
+
+// constant initialized, so it is ready for the static initializers of
+// other translation units
+constexpr KeywordSlots _keywordSlots =
+        makeKeywordSlots(MakeIndices<KEYWORD_TABLE_SIZE>::type());
+
+}
+
+
+template <class Stream>
+BasicTokenizer<Stream>::BasicTokenizer(Stream &stream) :
 _stream(stream),
+_type(T_UNDEFINED),
+_tag_offset(0),
+_tag_length(0),
 _peeking(false) {
 }
 
-Tokenizer::~Tokenizer() {
+template <class Stream>
+BasicTokenizer<Stream>::~BasicTokenizer() {
 }
 
-string Tokenizer::getTag() const {
+template <class Stream>
+StringRef BasicTokenizer<Stream>::makeTagRef(size_t offset, size_t length, const std::string &buffer) const {
+    if (_stream.isMapped()) {
+        return StringRef(_stream.getData() + offset, length);
+    } else {
+        return StringRef(buffer.data(), length);
+    }
+}
+
+template <class Stream>
+StringRef BasicTokenizer<Stream>::getTagRef() const {
     if (_peeking) {
-        return _saved_tag;
+        return makeTagRef(_saved_tag_offset, _saved_tag_length, _saved_tag_buffer);
     } else {
-        return this->_tag;
+        return makeTagRef(_tag_offset, _tag_length, _tag_buffer);
     }
 }
 
-std::string Tokenizer::peekTag() {
+template <class Stream>
+StringRef BasicTokenizer<Stream>::peekTagRef() {
     peekToken();
-    return _tag;
+    return makeTagRef(_tag_offset, _tag_length, _tag_buffer);
 }
 
-int Tokenizer::getLineNumber() const {
-    if (_peeking) {
-        return _saved_line_number;
-    } else {
-        return _stream.getLineNumber();
+template <class Stream>
+string BasicTokenizer<Stream>::getTag() const {
+    return getTagRef().str();
+}
+
+template <class Stream>
+std::string BasicTokenizer<Stream>::peekTag() {
+    return peekTagRef().str();
+}
+
+template <class Stream>
+void BasicTokenizer<Stream>::startTag(int symbol) {
+    // symbol is already read from the stream
+    _tag_offset = _stream.getOffset() - 1;
+    _tag_length = 0;
+    if (!_stream.isMapped()) {
+        _tag_buffer.clear();
     }
+    appendTag(symbol);
 }
 
-int Tokenizer::getLinePosition() const {
-    if (_peeking) {
-        return _saved_line_position;
-    } else {
-        return _stream.getLinePosition() - _tag.length() + 1;
+template <class Stream>
+void BasicTokenizer<Stream>::appendTag(int symbol) {
+    _tag_length++;
+    if (!_stream.isMapped()) {
+        _tag_buffer += symbol;
     }
 }
 
-int Tokenizer::peekLineNumber() {
+template <class Stream>
+int BasicTokenizer<Stream>::getLineNumber() const {
+    return _stream.getLineNumber(_peeking ? _saved_tag_offset : _tag_offset);
+}
+
+template <class Stream>
+int BasicTokenizer<Stream>::getLinePosition() const {
+    return _stream.getLinePosition(_peeking ? _saved_tag_offset : _tag_offset);
+}
+
+template <class Stream>
+int BasicTokenizer<Stream>::peekLineNumber() {
     peekToken();
-    return _stream.getLineNumber();
+    return _stream.getLineNumber(_tag_offset);
 }
 
-int Tokenizer::peekLinePosition() {
+template <class Stream>
+int BasicTokenizer<Stream>::peekLinePosition() {
     peekToken();
-    return _stream.getLinePosition() - _tag.length() + 1;
+    return _stream.getLinePosition(_tag_offset);
 }
 
-Tokenizer::ValueType Tokenizer::nextToken() {
+template <class Stream>
+TokenizerBase::ValueType BasicTokenizer<Stream>::nextToken() {
 
     if (_peeking) {
         _peeking = false;
         return _type;
     }
 
-    string token;
     while (true) {
 
         int symbol = _stream.get();
 
         // operations, EOF, / -> // | /*
         if (_stream.eof()) {
-            token = "";
+            _tag_offset = _stream.getOffset();
+            _tag_length = 0;
             _type = T_EOF;
         } else if (isspace(symbol)) {
             while (isspace(symbol) && !_stream.eof()) {
@@ -150,83 +316,75 @@ Tokenizer::ValueType Tokenizer::nextToken() {
             _stream.unget();
             continue;
         } else if (symbol == '+') {
-            token = symbol;
+            startTag(symbol);
             _type = T_PLUS;
         } else if (symbol == '-') {
-            token = symbol;
+            startTag(symbol);
             _type = T_MINUS;
         } else if (symbol == '*') {
-            token = symbol;
+            startTag(symbol);
             _type = T_MULT;
         } else if (symbol == ':') {
-            token = symbol;
+            startTag(symbol);
             _type = T_COLON;
         } else if (symbol == '%') {
-            token = symbol;
+            startTag(symbol);
             _type = T_MOD;
         } else if (symbol == '=') {
-            token = symbol;
-            int next_symbol = _stream.get();
-            if (next_symbol == '=') {
-                token += next_symbol;
+            startTag(symbol);
+            if (_stream.peek() == '=') {
+                appendTag(_stream.get());
                 _type = T_EQUAL;
             } else {
                 _type = T_ASSIGNMENT;
-                _stream.unget();
             }
         } else if (symbol == ';') {
-            token = symbol;
+            startTag(symbol);
             _type = T_SEMICOLON;
         } else if (symbol == '(') {
-            token = symbol;
+            startTag(symbol);
             _type = T_OPENING_RBRACKET;
         } else if (symbol == ')') {
-            token = symbol;
+            startTag(symbol);
             _type = T_CLOSING_RBRACKET;
         } else if (symbol == '[') {
-            token = symbol;
+            startTag(symbol);
             _type = T_OPENING_SBRACKET;
         } else if (symbol == ']') {
-            token = symbol;
+            startTag(symbol);
             _type = T_CLOSING_SBRACKET;
         } else if (symbol == '{') {
-            token = symbol;
+            startTag(symbol);
             _type = T_OPENING_CBRACKET;
         } else if (symbol == '}') {
-            token = symbol;
+            startTag(symbol);
             _type = T_CLOSING_CBRACKET;
         } else if (symbol == ',') {
-            token = symbol;
+            startTag(symbol);
             _type = T_COMMA;
         } else if (symbol == '<') {
-            token = symbol;
-            int next_symbol = _stream.get();
-            if (next_symbol == '=') {
-                token += next_symbol;
+            startTag(symbol);
+            if (_stream.peek() == '=') {
+                appendTag(_stream.get());
                 _type = T_LESS_OR_EQUAL;
             } else {
                 _type = T_LESS;
-                _stream.unget();
             }
         } else if (symbol == '>') {
-            token = symbol;
-            int next_symbol = _stream.get();
-            if (next_symbol == '=') {
-                token += next_symbol;
+            startTag(symbol);
+            if (_stream.peek() == '=') {
+                appendTag(_stream.get());
                 _type = T_GREATER_OR_EQUAL;
             } else {
                 _type = T_GREATER;
-                _stream.unget();
             }
         } else if (symbol == '!') {
-            token = symbol;
-            int next_symbol = _stream.get();
-            if (next_symbol == '=') {
-                token += next_symbol;
+            startTag(symbol);
+            if (_stream.peek() == '=') {
+                appendTag(_stream.get());
                 _type = T_NOT_EQUAL;
             } else {
                 _type = T_NOT;
-                _stream.unget();
             }
         } else if (symbol == '#') {
             // line comment
@@ -236,9 +394,10 @@ Tokenizer::ValueType Tokenizer::nextToken() {
             _stream.unget();
             continue;
         } else if (symbol == '/') {
-            int next_symbol = _stream.get();
+            int next_symbol = _stream.peek();
 
             if (next_symbol == '/') {
+                _stream.get();
                 // line comment
                 while ((symbol != '\n') && !_stream.eof()) {
                     symbol = _stream.get();
@@ -246,23 +405,23 @@ Tokenizer::ValueType Tokenizer::nextToken() {
                 _stream.unget();
                 continue;
             } else if (next_symbol == '*') {
+                _stream.get();
                 symbol = _stream.get();
                 next_symbol = _stream.get();
-                while ((symbol != '*') || (next_symbol != '/') && !_stream.eof()) {
+                while (((symbol != '*') || (next_symbol != '/')) && !_stream.eof()) {
                     symbol = next_symbol;
                     next_symbol = _stream.get();
                 }
                 continue;
             } else {
-                _stream.unget();
-                token = symbol;
+                startTag(symbol);
                 _type = T_DIV;
             }
         } else if (isdigit(symbol)) {
-            token = symbol;
+            startTag(symbol);
             symbol = _stream.get();
             while (isdigit(symbol) && !_stream.eof()) {
-                token += symbol;
+                appendTag(symbol);
                 symbol = _stream.get();
             }
 
@@ -271,80 +430,77 @@ Tokenizer::ValueType Tokenizer::nextToken() {
             _type = T_INTEGER;
             _stream.unget();
         } else if (isalpha(symbol) || symbol == '_') {
-            token += symbol;
+            startTag(symbol);
             symbol = _stream.get();
             while ((isalnum(symbol) || symbol == '_') && !_stream.eof()) {
-                token += symbol;
+                appendTag(symbol);
                 symbol = _stream.get();
             }
             _stream.unget();
 
-            if (token == "int") {
-                _type = T_TYPE_INT;
-            } else if (token == "read") {
-                _type = T_READ;
-            } else if (token == "print") {
-                _type = T_PRINT;
-			} else if (token == "for") {
-				_type = T_FOR;
-            } else if (token == "while") {
-                _type = T_WHILE;
-            } else if (token == "if") {
-                _type = T_IF;
-            } else if (token == "else") {
-                _type = T_ELSE;
-            } else if (token == "and") {
-                _type = T_AND;
-            } else if (token == "or") {
-                _type = T_OR;
-            } else if (token == "not") {
-                _type = T_NOT;
-            } else if (token == "false") {
-                _type = T_FALSE;
-            } else if (token == "true") {
-                _type = T_TRUE;
-            } else if (token == "return") {
-                _type = T_RETURN;
-            } else if (token == "def") {
-                _type = T_DEF;
-            } else if (token == "enddef") {
-                _type = T_ENDDEF;
-            } else if (token == "do") {
-                _type = T_DO;
-            } else if (token == "done") {
-                _type = T_DONE;
-            } else if (token == "then") {
-                _type = T_THEN;
-            } else if (token == "fi") {
-                _type = T_FI;
-            } else {
-                _type = T_ID;
-            }
+            _type = lookupKeyword(getTagRef());
         } else {
-            token += symbol;
+            startTag(symbol);
             _type = T_UNDEFINED;
         }
 
-        _tag = token;
-
-DEBUG(fmt("Read %s %s", _tag.c_str(), getTokenDescription(_type).c_str()));
+DEBUG(fmt("Read %.*s %s", (int) _tag_length, getTagRef().data(), getTokenDescription(_type).c_str()));
 
         return _type;
     }
 }
 
-Tokenizer::ValueType Tokenizer::peekToken() {
+TokenizerBase::ValueType TokenizerBase::lookupKeyword(StringRef tag) {
+    size_t length = tag.length();
+    if (length == 0) {
+        return T_ID;
+    }
+    const KeywordSlot &slot = _keywordSlots.slots[keywordHash(length, tag[0], tag[length - 1])];
+    if (slot.length == length && memcmp(slot.tag, tag.data(), length) == 0) {
+        return slot.type;
+    }
+    return T_ID;
+}
+
+template <class Stream>
+TokenizerBase::ValueType BasicTokenizer<Stream>::peekToken() {
     if (_peeking == false) {
-        _saved_line_number = this->getLineNumber();
-        _saved_line_position = this->getLinePosition();
-        _saved_tag = this->getTag();
+        _saved_tag_offset = _tag_offset;
+        _saved_tag_length = _tag_length;
+        _saved_tag_buffer.swap(_tag_buffer);
         _saved_type = this->nextToken();
         _peeking = true;
     }
     return _saved_type;
 }
 
-Tokenizer::ValueType Tokenizer::getToken() {
+template <class Stream>
+void BasicTokenizer<Stream>::tokenizeAll(TokenBuffer &tokens) {
+    tokens.clear();
+
+    if (_stream.isMapped()) {
+        // tags stay in the mapped file
+        DfaLexer lexer(_stream.getData(), _stream.getSize());
+        tokens.setSource(_stream.getData(), _stream.getSize());
+        tokens.reserve(_stream.getSize() / 3 + 1);
+        do {
+            lexer.nextToken();
+            tokens.add(lexer.getToken(),
+                    lexer.getTagOffset(), lexer.getTagLength());
+        } while (lexer.getToken() != T_EOF);
+    } else {
+        tokens.setSource(NULL, 0);
+        do {
+            nextToken();
+            tokens.add(getToken(), _tag_offset, getTagRef());
+        } while (getToken() != T_EOF);
+        // the input is gone, but its lines are known
+        tokens.setLines(_stream.getLines());
+    }
+}
+
+template <class Stream>
+TokenizerBase::ValueType BasicTokenizer<Stream>::getToken() {
     if (_peeking) {
         return _saved_type;
     } else {
@@ -352,6 +508,11 @@ Tokenizer::ValueType Tokenizer::getToken() {
     }
 }
 
-std::string Tokenizer::getTokenDescription(ValueType valueType) const {
+std::string TokenizerBase::getTokenDescription(ValueType valueType) {
     return _valueTypeTags[valueType];
 }
+
+template class BasicTokenizer<LocatableStream>;
+template class BasicTokenizer<MemoryCharStream>;
+template class BasicTokenizer<FdCharStream>;
+template class BasicTokenizer<ReadAheadCharStream>;
@@ -6,9 +6,12 @@
 #include <cstdlib>
 #include <string>
 #include <vector>
-#include <map>
 
+#include "frozen_map.h"
 #include "LocatableStream.h"
+#include "StringRef.h"
+
+class TokenBuffer;
 
 class TokenizerException : public std::exception {
 private:
@@ -20,7 +23,10 @@ public:
     const char *what() const throw ();
 };
 
-class Tokenizer {
+/**
+ * Token types and the things which don't depend on the character stream.
+ */
+class TokenizerBase {
 public:
 
     enum ValueType {
@@ -74,29 +80,59 @@ public:
         T_DONE,
         T_THEN,
         T_FI,
+        VALUE_TYPE_COUNT // number of token types, not a token
     };
 
-    static std::map<ValueType, std::string> _valueTypeTags;
+    static const frozen_map<ValueType, const char *, VALUE_TYPE_COUNT> _valueTypeTags;
+
+    static std::string getTokenDescription(ValueType valueType);
+
+    // keyword type for the identifier or T_ID
+    static ValueType lookupKeyword(StringRef tag);
+};
 
+/**
+ * Tokenizer over any character stream with LocatableStream interface:
+ * get/unget/peek/eof/getOffset, isMapped/getData/getSize and
+ * getLineNumber/getLinePosition/getLines for offsets. With CharStream
+ * every call on the per-symbol path is resolved at compile time.
+ *
+ * Member functions are defined in Tokenizer.cpp, which instantiates the
+ * template for LocatableStream and CharStreams from CharStream.h; add an
+ * instantiation there for another stream.
+ */
+template <class Stream>
+class BasicTokenizer : public TokenizerBase {
 private:
-    LocatableStream &_stream;
-    Tokenizer::ValueType _type;
-    std::string _tag;
+    Stream &_stream;
+    ValueType _type;
+    // tag is kept as offset and length in the source; characters are
+    // copied to _tag_buffer only if the source is not mapped into memory
+    size_t _tag_offset;
+    size_t _tag_length;
+    std::string _tag_buffer;
 
     bool _peeking;
-    std::string _saved_tag;
-    Tokenizer::ValueType _saved_type;
-    int _saved_line_number;
-    int _saved_line_position;
+    size_t _saved_tag_offset;
+    size_t _saved_tag_length;
+    std::string _saved_tag_buffer;
+    ValueType _saved_type;
+
+    void startTag(int symbol);
+    void appendTag(int symbol);
+    StringRef makeTagRef(size_t offset, size_t length, const std::string &buffer) const;
 public:
 
-    Tokenizer(LocatableStream &stream);
-    virtual ~Tokenizer();
-    Tokenizer::ValueType peekToken();
-    Tokenizer::ValueType nextToken();
-    Tokenizer::ValueType getToken();
+    BasicTokenizer(Stream &stream);
+    ~BasicTokenizer();
+    ValueType peekToken();
+    ValueType nextToken();
+    ValueType getToken();
     std::string getTag() const;
     std::string peekTag();
+    // valid until the next call to nextToken() or peekToken()
+    StringRef getTagRef() const;
+    StringRef peekTagRef();
 
     int getLineNumber() const;
     int getLinePosition() const;
@@ -104,9 +140,11 @@ public:
     int peekLineNumber();
     int peekLinePosition();
 
-    std::string getTokenDescription(ValueType valueType) const;
+    // lexes the whole input at once; must be called before nextToken()
+    void tokenizeAll(TokenBuffer &tokens);
 };
 
+typedef BasicTokenizer<LocatableStream> Tokenizer;
 
 
 #endif  /* TOKENIZER_H */
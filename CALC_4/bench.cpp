@@ -0,0 +1,696 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <cerrno>
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.h"
+#include "LocatableStream.h"
+#include "CharStream.h"
+#include "ReadAheadSource.h"
+#include "Tokenizer.h"
+#include "DfaLexer.h"
+#include "SimdScan.h"
+#include "TokenBuffer.h"
+#include "Parser.h"
+#include "Compilation.h"
+
+/*
+ * Self-checks and throughput measurements of the compiler stages.
+ * Every check exits with non-zero status on mismatch, so test.sh runs them
+ * over every test program; pass bigger files and iteration counts for
+ * timings.
+ */
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t bytes, size_t tokens, double seconds) {
+    if (tokens != 0) {
+        printf("  %-12s %10lu tokens %9.3f ms %9.2f MB/s\n",
+                name, (unsigned long) tokens, seconds * 1e3,
+                bytes / seconds / (1024 * 1024));
+    } else {
+        printf("  %-12s %17s %9.3f ms %9.2f MB/s\n",
+                name, "", seconds * 1e3, bytes / seconds / (1024 * 1024));
+    }
+}
+
+// empty files are not mapped
+static const char *getData(const BufferedStream &stream) {
+    if (!stream.isMapped() && stream.getSize() != 0) {
+        throw BufferedStreamException("Input is not a regular file");
+    }
+    return stream.isMapped() ? stream.getData() : "";
+}
+
+/*
+ * Tokenizer over a character stream vs DfaLexer (tables over the mapped
+ * file): the same types, tags and positions are expected for every token.
+ */
+template <class Stream>
+static bool compareLexers(const char *filename, const char *name, Stream &stream,
+        const char *data, size_t size) {
+    BasicTokenizer<Stream> tokenizer(stream);
+    DfaLexer lexer(data, size);
+    size_t tokens = 0;
+    while (true) {
+        Tokenizer::ValueType expected = tokenizer.nextToken();
+        Tokenizer::ValueType actual = lexer.nextToken();
+        tokens++;
+
+        if (expected != actual
+                || tokenizer.getTagRef() != lexer.getTagRef()
+                || tokenizer.getLineNumber() != lexer.getLineNumber()
+                || tokenizer.getLinePosition() != lexer.getLinePosition()) {
+            ERROR(fmt("%s: token %lu differs: %s %s '%s' %d:%d vs DfaLexer %s '%s' %d:%d",
+                    filename, (unsigned long) tokens, name,
+                    tokenizer.getTokenDescription(expected).c_str(),
+                    tokenizer.getTag().c_str(),
+                    tokenizer.getLineNumber(), tokenizer.getLinePosition(),
+                    tokenizer.getTokenDescription(actual).c_str(),
+                    lexer.getTagRef().str().c_str(),
+                    lexer.getLineNumber(), lexer.getLinePosition()));
+            return false;
+        }
+        if (expected == Tokenizer::T_EOF) {
+            break;
+        }
+    }
+    return true;
+}
+
+template <class Stream>
+static size_t countTokens(Stream &stream) {
+    BasicTokenizer<Stream> tokenizer(stream);
+    size_t tokens = 0;
+    while (tokenizer.nextToken() != Tokenizer::T_EOF) {
+        tokens++;
+    }
+    return tokens;
+}
+
+static int openFile(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        throw BufferedStreamException(strerror(errno));
+    }
+    return fd;
+}
+
+static int benchLexer(const char *filename, int iterations) {
+    LocatableStream stream(filename);
+    const char *data = getData(stream);
+    size_t size = stream.getSize();
+
+    MemoryCharStream memoryStream(data, size);
+    int fd = openFile(filename);
+    FdCharStream fdStream(fd);
+    // small blocks, so that the ring goes around many times
+    int readAheadFd = openFile(filename);
+    ReadAheadCharStream readAheadStream(readAheadFd, 13);
+    bool agree = compareLexers(filename, "Tokenizer", stream, data, size)
+            && compareLexers(filename, "MemoryCharStream", memoryStream, data, size)
+            && compareLexers(filename, "FdCharStream", fdStream, data, size)
+            && compareLexers(filename, "ReadAheadCharStream", readAheadStream, data, size);
+    close(fd);
+    close(readAheadFd);
+    if (!agree) {
+        return EXIT_FAILURE;
+    }
+    printf("%s: %lu bytes, lexers agree\n", filename, (unsigned long) size);
+
+    double start = now();
+    size_t tokens = 0;
+    for (int i = 0; i < iterations; ++i) {
+        LocatableStream s(filename);
+        tokens += countTokens(s);
+    }
+    report("Tokenizer", size * iterations, tokens, now() - start);
+
+    start = now();
+    tokens = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int fd = openFile(filename);
+        LocatableStream s(fd);
+        tokens += countTokens(s);
+    }
+    report("Tokenizer fd", size * iterations, tokens, now() - start);
+
+    start = now();
+    tokens = 0;
+    for (int i = 0; i < iterations; ++i) {
+        MemoryCharStream s(data, size);
+        tokens += countTokens(s);
+    }
+    report("Memory", size * iterations, tokens, now() - start);
+
+    start = now();
+    tokens = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int fd = openFile(filename);
+        FdCharStream s(fd);
+        tokens += countTokens(s);
+        close(fd);
+    }
+    report("Fd", size * iterations, tokens, now() - start);
+
+    start = now();
+    tokens = 0;
+    for (int i = 0; i < iterations; ++i) {
+        int fd = openFile(filename);
+        {
+            ReadAheadCharStream s(fd);
+            tokens += countTokens(s);
+        }
+        close(fd);
+    }
+    report("ReadAhead", size * iterations, tokens, now() - start);
+
+    start = now();
+    tokens = 0;
+    for (int i = 0; i < iterations; ++i) {
+        DfaLexer l(data, size);
+        while (l.nextToken() != Tokenizer::T_EOF) {
+            tokens++;
+        }
+    }
+    report("DfaLexer", size * iterations, tokens, now() - start);
+
+    return EXIT_SUCCESS;
+}
+
+// positions are checked too, so the line index is built with the same scan
+static void lexAll(const char *data, size_t size, TokenBuffer &tokens) {
+    DfaLexer lexer(data, size);
+    tokens.clear();
+    tokens.setSource(data, size);
+    do {
+        lexer.nextToken();
+        tokens.add(lexer.getToken(), lexer.getTagOffset(), lexer.getTagLength());
+    } while (lexer.getToken() != Tokenizer::T_EOF);
+}
+
+/*
+ * DfaLexer with every SimdScan level supported by the CPU: the scalar
+ * token stream is the reference, each level is checked against it and timed.
+ */
+static int benchScan(const char *filename, int iterations) {
+    LocatableStream stream(filename);
+    const char *data = getData(stream);
+    size_t size = stream.getSize();
+    SimdScan::Level maxLevel = SimdScan::getMaxLevel();
+
+    TokenBuffer expected;
+    TokenBuffer actual;
+    SimdScan::setLevel(SimdScan::SCALAR);
+    lexAll(data, size, expected);
+    expected.getLineNumber(0);
+
+    for (int level = SimdScan::SCALAR; level <= maxLevel; ++level) {
+        SimdScan::setLevel((SimdScan::Level) level);
+        lexAll(data, size, actual);
+        for (size_t i = 0; i < expected.size() || i < actual.size(); ++i) {
+            if (i >= actual.size() || i >= expected.size()
+                    || expected.getType(i) != actual.getType(i)
+                    || expected.getOffset(i) != actual.getOffset(i)
+                    || expected.getLength(i) != actual.getLength(i)
+                    || expected.getLineNumber(i) != actual.getLineNumber(i)
+                    || expected.getLinePosition(i) != actual.getLinePosition(i)) {
+                ERROR(fmt("%s: token %lu differs with %s scan",
+                        filename, (unsigned long) i + 1,
+                        SimdScan::getLevelName((SimdScan::Level) level)));
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    printf("%s: %lu tokens, %lu bytes, scans agree up to %s\n",
+            filename, (unsigned long) expected.size(), (unsigned long) size,
+            SimdScan::getLevelName(maxLevel));
+
+    for (int level = SimdScan::SCALAR; level <= maxLevel; ++level) {
+        SimdScan::setLevel((SimdScan::Level) level);
+        size_t tokens = 0;
+        double start = now();
+        for (int i = 0; i < iterations; ++i) {
+            DfaLexer lexer(data, size);
+            while (lexer.nextToken() != Tokenizer::T_EOF) {
+                tokens++;
+            }
+        }
+        report(SimdScan::getLevelName((SimdScan::Level) level),
+                size * iterations, tokens, now() - start);
+    }
+    SimdScan::setLevel(maxLevel);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * BufferedStream over a descriptor with a tiny window, so that peek(n),
+ * unget(n) and mark/reset cross refills all the time; every symbol has to
+ * match the mapped file.
+ */
+static bool checkStream(const char *filename, const char *data, size_t size) {
+    const size_t BUFFER_SIZE = 7;
+    const size_t LOOKBEHIND = 5;
+    const size_t PEEK = 12;
+    const size_t MARK = 20;
+
+    BufferedStream stream(openFile(filename), BUFFER_SIZE, LOOKBEHIND);
+    for (size_t pos = 0; pos < size; ++pos) {
+        if (stream.getOffset() != pos) {
+            ERROR(fmt("%s: offset %lu instead of %lu", filename,
+                    (unsigned long) stream.getOffset(), (unsigned long) pos));
+            return false;
+        }
+        for (size_t n = 0; n < PEEK; ++n) {
+            int expected = (pos + n < size) ? data[pos + n] : 0;
+            if (stream.peek(n) != expected) {
+                ERROR(fmt("%s: peek(%lu) at %lu differs", filename,
+                        (unsigned long) n, (unsigned long) pos));
+                return false;
+            }
+        }
+        if (stream.get() != data[pos]) {
+            ERROR(fmt("%s: get() at %lu differs", filename, (unsigned long) pos));
+            return false;
+        }
+        if (pos % 3 == 0) {
+            size_t count = (pos + 1 < LOOKBEHIND) ? pos + 1 : LOOKBEHIND;
+            stream.unget(count);
+            for (size_t i = pos + 1 - count; i <= pos; ++i) {
+                if (stream.get() != data[i]) {
+                    ERROR(fmt("%s: get() at %lu after unget(%lu) differs",
+                            filename, (unsigned long) i, (unsigned long) count));
+                    return false;
+                }
+            }
+        }
+        if (pos % 11 == 0) {
+            stream.mark();
+            for (size_t i = 0; i < MARK; ++i) {
+                stream.get();
+            }
+            stream.reset();
+            stream.clearMark();
+            if (stream.getOffset() != pos + 1 || stream.eof()) {
+                ERROR(fmt("%s: reset() to %lu failed", filename, (unsigned long) pos + 1));
+                return false;
+            }
+        }
+    }
+    if (stream.get() != 0 || !stream.eof()) {
+        ERROR(fmt("%s: no EOF after %lu bytes", filename, (unsigned long) size));
+        return false;
+    }
+    return true;
+}
+
+static int benchStream(const char *filename, int iterations) {
+    LocatableStream mapped(filename);
+    const char *data = getData(mapped);
+    size_t size = mapped.getSize();
+
+    if (!checkStream(filename, data, size)) {
+        return EXIT_FAILURE;
+    }
+    printf("%s: %lu bytes, windowed reads agree\n", filename, (unsigned long) size);
+
+    double start = now();
+    for (int i = 0; i < iterations; ++i) {
+        BufferedStream stream(openFile(filename));
+        while (stream.get() != 0 || !stream.eof()) {
+        }
+    }
+    report("get()", size * iterations, 0, now() - start);
+
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+        BufferedStream stream(openFile(filename));
+        while (stream.peek(1) != 0) {
+            stream.get();
+        }
+    }
+    report("peek(1)", size * iterations, 0, now() - start);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Lexing of the whole input into TokenBuffer, parsing of the ready
+ * TokenBuffer and code generation (stack machine and with the register
+ * allocator) are timed separately. The tree is then copied into a
+ * FlatTree, which must give the same XML and code.
+ */
+static int benchParser(const char *filename, int iterations) {
+    LocatableStream stream(filename);
+    Tokenizer tokenizer(stream);
+    TokenBuffer tokens;
+
+    double start = now();
+    for (int i = 0; i < iterations; ++i) {
+        tokenizer.tokenizeAll(tokens);
+    }
+    report("tokenizeAll", stream.getSize() * iterations,
+            tokens.size() * iterations, now() - start);
+    printf("  %lu bytes in token arrays\n", (unsigned long) tokens.getMemoryUsage());
+
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+        Parser parser(&tokens);
+    }
+    report("Parser", stream.getSize() * iterations,
+            tokens.size() * iterations, now() - start);
+
+    size_t heap = mallinfo2().uordblks;
+    Compilation compilation(&tokens);
+    Parser &parser = compilation.getParser();
+    const Arena &arena = parser.getArena();
+    printf("  %lu nodes, %lu bytes in arena (%lu reserved, %lu allocations), %lu bytes of heap\n",
+            (unsigned long) parser.getNodeCount(),
+            (unsigned long) arena.getBytesUsed(),
+            (unsigned long) arena.getBytesReserved(),
+            (unsigned long) arena.getAllocationCount(),
+            (unsigned long) (mallinfo2().uordblks - heap));
+    start = now();
+    std::string code = compilation.generate();
+    report("Codegen", stream.getSize(), tokens.size(), now() - start);
+
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+        FlatTree flat(parser.getRoot());
+    }
+    report("FlatTree", stream.getSize() * iterations,
+            tokens.size() * iterations, now() - start);
+
+    FlatTree flat(parser.getRoot());
+    printf("  %lu nodes, %lu bytes in flat tree\n",
+            (unsigned long) flat.size(), (unsigned long) flat.getBytesUsed());
+
+    size_t count = 0;
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+        count += countNodes(NodePtr(parser.getRoot()));
+    }
+    report("walk Node", stream.getSize() * iterations, 0, now() - start);
+    count = 0;
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+        count += countNodes(flat.getRoot());
+    }
+    report("walk flat", stream.getSize() * iterations, 0, now() - start);
+    assert(count == flat.size() * iterations);
+
+    if (buildXMLTree(flat.getRoot()) != parser.getXMLTree()) {
+        printf("XML of the flat tree differs\n");
+        return EXIT_FAILURE;
+    }
+
+    Program program;
+    CodeBuffer flatCode;
+    start = now();
+    generateProgram(flat.getRoot(), program, flatCode);
+    report("Codegen flat", stream.getSize(), tokens.size(), now() - start);
+    if (flatCode.str() != code) {
+        printf("Code of the flat tree differs\n");
+        return EXIT_FAILURE;
+    }
+
+    compilation.setRegisterAllocation(true);
+    start = now();
+    std::string registerCode = compilation.generate();
+    report("Codegen regs", stream.getSize(), tokens.size(), now() - start);
+    program.clear();
+    program.setRegisterAllocation(true);
+    CodeBuffer flatRegisterCode;
+    generateProgram(flat.getRoot(), program, flatRegisterCode);
+    if (flatRegisterCode.str() != registerCode) {
+        printf("Register code of the flat tree differs\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static const int SESSION_THREADS = 4;
+
+static void compileFile(const char *filename, int iterations, std::string *code) {
+    for (int i = 0; i < iterations; ++i) {
+        LocatableStream stream(filename);
+        Tokenizer tokenizer(stream);
+        Compilation compilation(&tokenizer);
+        *code = compilation.generate();
+    }
+}
+
+/*
+ * The file is compiled iterations times on each of 1, 2, ... threads at
+ * once, every time in a Compilation of its own: each has to give the code
+ * of a compilation done alone.
+ */
+static int benchSessions(const char *filename, int iterations) {
+    std::string expected;
+    compileFile(filename, 1, &expected);
+    size_t size = expected.length();
+
+    for (int threads = 1; threads <= SESSION_THREADS; threads *= 2) {
+        std::vector<std::string> codes(threads);
+        std::vector<std::thread> workers;
+        double start = now();
+        for (int t = 0; t < threads; ++t) {
+            workers.push_back(std::thread(compileFile, filename, iterations, &codes[t]));
+        }
+        for (int t = 0; t < threads; ++t) {
+            workers[t].join();
+        }
+        double seconds = now() - start;
+
+        for (int t = 0; t < threads; ++t) {
+            if (codes[t] != expected) {
+                printf("Code of the session on thread %d of %d differs\n", t, threads);
+                return EXIT_FAILURE;
+            }
+        }
+        printf("  %d thread(s) %10d compilations %9.3f ms %9.2f MB/s of code\n",
+                threads, threads * iterations, seconds * 1e3,
+                size * threads * iterations / seconds / (1024 * 1024));
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static const int MAX_JOBS = 8;
+
+/*
+ * Code generation of the file with the functions generated one by one
+ * and on 1, 2, ... MAX_JOBS threads. The code must not depend on the
+ * number of threads; the speedup is against the sequential generation.
+ */
+static int benchJobs(const char *filename, int iterations) {
+    LocatableStream stream(filename);
+    Tokenizer tokenizer(stream);
+    Compilation compilation(&tokenizer);
+
+    double start = now();
+    for (int i = 0; i < iterations; ++i) {
+        compilation.generate();
+    }
+    double sequential = now() - start;
+    printf("  %-12s %9.3f ms\n", "sequential", sequential * 1e3);
+
+    std::string expected = compilation.generate(1);
+    for (int jobs = 1; jobs <= MAX_JOBS; jobs *= 2) {
+        std::string code;
+        start = now();
+        for (int i = 0; i < iterations; ++i) {
+            code = compilation.generate(jobs);
+        }
+        double seconds = now() - start;
+        if (code != expected) {
+            printf("Code of %d jobs differs\n", jobs);
+            return EXIT_FAILURE;
+        }
+        printf("  %2d job(s)    %9.3f ms %6.2fx\n", jobs, seconds * 1e3,
+                sequential / seconds);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static const int LOG_THREADS = 4;
+
+static void logMessages(int thread, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        DEBUG(fmt("T%d %lu", thread, (unsigned long) i));
+    }
+}
+
+/*
+ * Logs count messages from each of threads threads to the file at path
+ * and checks the file: messages of a thread are in order and none is
+ * missing unless reported as dropped. Exits on mismatch.
+ */
+static void checkLog(const char *name, const char *path, int threads, size_t count,
+        bool async, Logger::OverflowPolicy policy, double &seconds) {
+    std::ofstream out(path, std::ios::trunc);
+    Logger::setStream(&out);
+    Logger::setLevel(Logger::DEBUG);
+
+    double start = now();
+    if (async) {
+        Logger::startAsync(policy, 1024);
+    }
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.push_back(std::thread(logMessages, t, count));
+    }
+    logMessages(0, count);
+    for (size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+    Logger::stopAsync();
+    seconds = now() - start;
+
+    Logger::setLevel(Logger::ERROR);
+    Logger::setStream(&std::cerr);
+    out.close();
+
+    std::ifstream in(path);
+    std::vector<size_t> next(threads, 0);
+    std::vector<size_t> received(threads, 0);
+    size_t dropped = 0;
+    bool ok = true;
+    std::string line;
+    while (std::getline(in, line)) {
+        // "LEVEL file:function:line message", the message ends with 2 words
+        size_t last = line.rfind(' ');
+        size_t pos = (last == std::string::npos || last == 0)
+                ? std::string::npos : line.rfind(' ', last - 1);
+        if (pos == std::string::npos || pos == 0) {
+            ok = false;
+            break;
+        }
+        int thread;
+        unsigned long i;
+        if (line.compare(0, 6, "DEBUG ") == 0
+                && sscanf(line.c_str() + pos, " T%d %lu", &thread, &i) == 2
+                && thread >= 0 && thread < threads) {
+            // gaps are allowed only if messages are dropped
+            ok = ok && (i == next[thread] || (policy == Logger::DROP && i > next[thread]));
+            next[thread] = i + 1;
+            received[thread]++;
+        } else if (line.compare(0, 5, "WARN ") == 0
+                && sscanf(line.c_str() + line.rfind(' ', pos - 1), " %lu messages", &i) == 1) {
+            dropped += i;
+        } else {
+            ok = false;
+        }
+    }
+    size_t total = 0;
+    for (int t = 0; t < threads; ++t) {
+        total += received[t];
+    }
+    if (!ok || total + dropped != count * threads || (dropped != 0 && policy != Logger::DROP)) {
+        ERROR(fmt("%s: %lu messages written, %lu dropped of %lu", name,
+                (unsigned long) total, (unsigned long) dropped,
+                (unsigned long) count * threads));
+        exit(EXIT_FAILURE);
+    }
+    if (dropped != 0) {
+        printf("  %s: %lu of %lu messages dropped\n", name,
+                (unsigned long) dropped, (unsigned long) count * threads);
+    }
+}
+
+/*
+ * One DEBUG message per token of the file from each thread: synchronous
+ * logging (one thread, the stream is not locked) vs the asynchronous sink.
+ */
+static int benchLog(const char *filename, int iterations) {
+    LocatableStream stream(filename);
+    Tokenizer tokenizer(stream);
+    TokenBuffer tokens;
+    tokenizer.tokenizeAll(tokens);
+    size_t count = tokens.size() * iterations;
+
+    char path[] = "/tmp/benchlogXXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        throw BufferedStreamException(LOG_MSG(strerror(errno)));
+    }
+    close(fd);
+
+    struct Run {
+        const char *name;
+        int threads;
+        bool async;
+        Logger::OverflowPolicy policy;
+    } runs[] = {
+        {"sync", 1, false, Logger::BLOCK},
+        {"async block", 1, true, Logger::BLOCK},
+        {"async block", LOG_THREADS, true, Logger::BLOCK},
+        {"async drop", LOG_THREADS, true, Logger::DROP},
+    };
+    for (size_t i = 0; i < sizeof (runs) / sizeof (runs[0]); ++i) {
+        double seconds;
+        checkLog(runs[i].name, path, runs[i].threads, count,
+                runs[i].async, runs[i].policy, seconds);
+        printf("  %-12s %d thread(s) %10lu messages %9.3f ms\n", runs[i].name,
+                runs[i].threads, (unsigned long) count * runs[i].threads, seconds * 1e3);
+    }
+    unlink(path);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    Logger::setLevel(Logger::ERROR);
+
+    if (argc < 3) {
+        CRITICAL(fmt("Usage: %s lexer|scan|stream|parser|sessions|jobs|log file [iterations]", argv[0]));
+    }
+
+    const char *what = argv[1];
+    const char *filename = argv[2];
+    int iterations = (argc > 3) ? atoi(argv[3]) : 1;
+
+    try {
+        if (!strcmp(what, "lexer")) {
+            return benchLexer(filename, iterations);
+        } else if (!strcmp(what, "scan")) {
+            return benchScan(filename, iterations);
+        } else if (!strcmp(what, "stream")) {
+            return benchStream(filename, iterations);
+        } else if (!strcmp(what, "parser")) {
+            return benchParser(filename, iterations);
+        } else if (!strcmp(what, "sessions")) {
+            return benchSessions(filename, iterations);
+        } else if (!strcmp(what, "jobs")) {
+            return benchJobs(filename, iterations);
+        } else if (!strcmp(what, "log")) {
+            return benchLog(filename, iterations);
+        } else {
+            CRITICAL(fmt("Unknown benchmark %s", what));
+        }
+    } catch (BufferedStreamException &ex) {
+        CRITICAL(ex.what());
+    } catch (ParserException &ex) {
+        CRITICAL(ex.what());
+    } catch (std::exception &ex) {
+        CRITICAL(ex.what());
+    }
+
+    return EXIT_SUCCESS;
+}
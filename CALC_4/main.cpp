@@ -6,10 +6,14 @@
 #include <cassert>
 #include <cerrno>
 #include <cstring>
+#include <unistd.h>
 
 #include "Logger.h"
+#include "CharStream.h"
+#include "ReadAheadSource.h"
 #include "Tokenizer.h"
 #include "Parser.h"
+#include "Compilation.h"
 
 using std::cin;
 using std::cout;
@@ -19,58 +23,93 @@ using std::istream;
 using std::string;
 using std::exception;
 
-int main(int argc, char** argv) {
-    Logger::setLevel(Logger::ERROR);
-
-    if (argc <= 1) {
-        CRITICAL(fmt("Usage: %s [file|-]", argv[0]));
-    }
-
-    LocatableStream *ls = NULL;
-
-    try {
-        if (!strcmp(argv[1], "-")) {
-            ls = new LocatableStream(0);
-        } else {
-            ls = new LocatableStream(argv[1]);
-        }
-
-        Tokenizer *tokenizer = new Tokenizer(*ls);
-        Parser *parser = new Parser(tokenizer);
+// stdin goes through statically dispatched CharStream, files are mapped
+template <class Stream>
+static void compile(Stream &stream, int maxNesting, int jobs, bool registers) {
+    BasicTokenizer<Stream> tokenizer(stream);
+    Compilation compilation(&tokenizer, maxNesting);
+    compilation.setRegisterAllocation(registers);
 //#define TREE_BUILD_TEST
 #ifdef TREE_BUILD_TEST
-        cout << parser->getXMLTree() << endl;
+    cout << compilation.getParser().getXMLTree() << endl;
 #endif
-        std::string code = parser->generate();
-        cout << code << endl;
+    CodeBuffer code(STDOUT_FILENO);
+    compilation.generate(code, jobs);
+    code.append("\n");
+    code.flush();
 
 //#define TOKENIZER_TEST
 #ifdef TOKENIZER_TEST
-        for (tokenizer->nextToken();
-                tokenizer->getToken() != Tokenizer::T_EOF;
-                tokenizer->nextToken()) {
-            cout << tokenizer->getTag()
-                    << "\t" << tokenizer->getTokenDescription(tokenizer->getToken()) << '\t'
-                    << tokenizer->getLineNumber() << '\t'
-                    << tokenizer->getLinePosition() << endl;
-        }
+    for (tokenizer.nextToken();
+            tokenizer.getToken() != Tokenizer::T_EOF;
+            tokenizer.nextToken()) {
+        cout << tokenizer.getTag()
+                << "\t" << tokenizer.getTokenDescription(tokenizer.getToken()) << '\t'
+                << tokenizer.getLineNumber() << '\t'
+                << tokenizer.getLinePosition() << endl;
+    }
 #endif
+}
 
+int main(int argc, char** argv) {
+    Logger::setLevel(Logger::ERROR);
+
+    // stdin is read by a helper thread with --read-ahead;
+    // --debug logs everything through the asynchronous sink;
+    // --max-nesting N rejects programs nested deeper than N;
+    // --jobs N generates the functions on N threads;
+    // --registers keeps the variables in registers (see RegisterAllocator)
+    bool readAhead = false;
+    bool registers = false;
+    int maxNesting = Parser::DEFAULT_MAX_NESTING;
+    int jobs = 0;
+    int arg = 1;
+    for (; arg < argc - 1; ++arg) {
+        if (!strcmp(argv[arg], "--read-ahead")) {
+            readAhead = true;
+        } else if (!strcmp(argv[arg], "--debug")) {
+            Logger::setLevel(Logger::DEBUG);
+            Logger::startAsync(Logger::BLOCK);
+        } else if (!strcmp(argv[arg], "--max-nesting") && arg + 2 < argc) {
+            maxNesting = atoi(argv[++arg]);
+            if (maxNesting <= 0) {
+                CRITICAL(fmt("Bad nesting limit %s", argv[arg]));
+            }
+        } else if (!strcmp(argv[arg], "--registers")) {
+            registers = true;
+        } else if (!strcmp(argv[arg], "--jobs") && arg + 2 < argc) {
+            jobs = atoi(argv[++arg]);
+            if (jobs <= 0) {
+                CRITICAL(fmt("Bad number of jobs %s", argv[arg]));
+            }
+        } else {
+            break;
+        }
+    }
+    const char *input = argv[arg];
 
-        delete parser;
-        delete tokenizer;
+    if (argc <= 1 || arg != argc - 1) {
+        CRITICAL(fmt("Usage: %s [--read-ahead] [--debug] [--max-nesting N] [--jobs N] [--registers] [file|-]", argv[0]));
+    }
+
+    try {
+        if (!strcmp(input, "-") && readAhead) {
+            ReadAheadCharStream stream(0);
+            compile(stream, maxNesting, jobs, registers);
+        } else if (!strcmp(input, "-")) {
+            FdCharStream stream(0);
+            compile(stream, maxNesting, jobs, registers);
+        } else {
+            LocatableStream stream(input);
+            compile(stream, maxNesting, jobs, registers);
+        }
     } catch (BufferedStreamException &ex) {
-        delete ls;
         CRITICAL(ex.what());
     } catch (ParserException &ex) {
-        delete ls;
         CRITICAL(ex.what());
     } catch (exception &ex) {
-        delete ls;
         CRITICAL(ex.what());
     }
 
-    delete ls;
-
     return EXIT_SUCCESS;
 }
@@ -1,6 +1,7 @@
 #!/bin/bash 
 
 APP=./main
+BENCH=./bench
 
 SUCCESS=0
 FAIL=0
@@ -29,6 +30,134 @@ for i in tests/*.sc ; do
 	fi
 done
 
+for i in tests/*.sc ; do
+	echo '========== Checking lexers, parser, sessions and jobs on ' "$i" ==========
+	${BENCH} lexer "$i" && ${BENCH} scan "$i" && ${BENCH} stream "$i" && ${BENCH} parser "$i" > /dev/null && ${BENCH} sessions "$i" > /dev/null && ${BENCH} jobs "$i" > /dev/null && ${BENCH} log "$i"
+	if [ "X$?" = "X0" ] ; then
+		echo "Ok";
+		let SUCCESS=$(($SUCCESS+1))
+	else 
+		echo "Failed";
+		let FAIL=$(($FAIL+1))
+	fi
+done
+
+# a = 60 * 60 * 24 must be a single movl, and no imull may be left on a
+# register that was just loaded with a literal
+folded() {
+	local asm
+	asm=$("$@") || return 1
+	grep -q 'movl \$86400, ' <<< "$asm" && ! awk '
+		/^ *movl \$-?[0-9]+, %/ { register = $3; next }
+		/^ *imull \$/ && $3 == register { found = 1 }
+		{ register = "" }
+		END { exit !found }' <<< "$asm"
+}
+
+for i in "" --registers ; do
+	echo '========== Checking constant folding in tests/folding.sc' $i ==========
+	folded ${APP} $i tests/folding.sc
+	if [ "X$?" = "X0" ] ; then
+		echo "Ok";
+		let SUCCESS=$(($SUCCESS+1))
+	else
+		echo "Failed";
+		let FAIL=$(($FAIL+1))
+	fi
+done
+
+# generated programs, too big to keep in tests/
+GENERATED=$(mktemp -d)
+trap 'rm -rf "$GENERATED"' EXIT
+
+# counts the command as a test of the generated program; its output is
+# dropped
+check_generated() {
+	local name=$1
+	shift
+	echo '========== Running generated test ' "$name" ==========
+	"$@" > /dev/null
+	if [ "X$?" = "X0" ] ; then
+		echo "Ok";
+		let SUCCESS=$(($SUCCESS+1))
+	else 
+		echo "Failed";
+		let FAIL=$(($FAIL+1))
+	fi
+}
+
+# the command must print the message on an error
+fails_with() {
+	local message=$1
+	shift
+	"$@" 2>&1 | grep -q "$message"
+}
+
+# lists of any length are parsed in loops
+awk -v n=200000 'BEGIN {
+	printf "def int main :\n\tint a;\n\ta = 0;\n"
+	for (i = 0; i < n; ++i) printf "\ta = a + 1;\n"
+	printf "\tprint a;\n\treturn 0;\nenddef\n"
+}' > "$GENERATED/statements.sc"
+awk -v n=200000 'BEGIN {
+	printf "def int main :\n\tint a;\n\ta = 0;\n\tprint a"
+	for (i = 0; i < n; ++i) printf " + 1"
+	printf ";\n\treturn 0;\nenddef\n"
+}' > "$GENERATED/sum.sc"
+awk -v n=50000 'BEGIN {
+	printf "def int f\nint p0"
+	for (i = 1; i < n; ++i) printf ",\nint p%d", i
+	printf " :\n\treturn p0 - p%d;\nenddef\n\ndef int main :\n\tprint {f 0", n - 1
+	for (i = 1; i < n; ++i) printf ", %d", i
+	printf "};\n\treturn 0;\nenddef\n"
+}' > "$GENERATED/arguments.sc"
+for i in statements sum arguments ; do
+	check_generated "$i" ${APP} "$GENERATED/$i.sc"
+	check_generated "$i with --registers" ${APP} --registers "$GENERATED/$i.sc"
+done
+
+# nesting deeper than --max-nesting is an error, not a stack overflow
+awk -v n=1001 'BEGIN {
+	printf "def int main :\n\tint a;\n\ta = 1;\n\tprint "
+	for (i = 0; i < n; ++i) printf "("
+	printf "a"
+	for (i = 0; i < n; ++i) printf ")"
+	printf ";\n\treturn 0;\nenddef\n"
+}' > "$GENERATED/brackets.sc"
+awk -v n=1001 'BEGIN {
+	printf "def int main :\n\tint a;\n\ta = 1;\n"
+	for (i = 0; i < n; ++i) printf "\tif a > 0 then\n"
+	printf "\tprint a;\n"
+	for (i = 0; i < n; ++i) printf "\tfi\n"
+	printf "\treturn 0;\nenddef\n"
+}' > "$GENERATED/blocks.sc"
+for i in brackets blocks ; do
+	check_generated "1001 $i" fails_with "nesting is deeper than 1000" ${APP} --max-nesting 1000 "$GENERATED/$i.sc"
+done
+
+# a NUL byte after the first symbol of a two-symbol operator is a symbol
+# of its own, whichever stream the input comes from
+for i in '/' '<' '=' '!' ; do
+	printf 'def int main :\n\tif 1 %s\0 2 then\n\tfi\n\treturn 0;\nenddef\n' "$i" > "$GENERATED/nul.sc"
+	check_generated "NUL after $i in bench lexer" ${BENCH} lexer "$GENERATED/nul.sc"
+done
+printf 'def int main :\n\tif 1 <\0 2 then\n\tfi\n\treturn 0;\nenddef\n' > "$GENERATED/nul.sc"
+check_generated "NUL from a file" fails_with "2:8: illegal token" ${APP} "$GENERATED/nul.sc"
+check_generated "NUL from stdin" fails_with "2:8: illegal token" ${APP} - < "$GENERATED/nul.sc"
+check_generated "NUL with --read-ahead" fails_with "2:8: illegal token" ${APP} --read-ahead - < "$GENERATED/nul.sc"
+
+# long chains of operators of both precedences
+awk -v n=200000 'BEGIN {
+	printf "def int main :\n\tint a;\n\ta = 1;\n\tprint a"
+	for (i = 1; i < n; i += 2) printf " + a * 2 - a %% 3"
+	printf ";\n\tprint 1"
+	for (i = 1; i < n; ++i) printf " + 1"
+	printf ";\n\treturn 0;\nenddef\n"
+}' > "$GENERATED/chain.sc"
+check_generated "200000 terms" ${APP} "$GENERATED/chain.sc"
+check_generated "200000 terms with --registers" ${APP} --registers "$GENERATED/chain.sc"
+check_generated "200000 terms in bench parser" ${BENCH} parser "$GENERATED/chain.sc"
+
 echo 'Total tests ' $(($SUCCESS + $FAIL))
 echo 'Success ' $SUCCESS
 echo 'Fail ' $FAIL
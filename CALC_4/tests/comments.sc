@@ -0,0 +1,56 @@
+/***********************************************************************
+ * Comments and whitespace of every length: block comment ends
+ * and line ends fall on both sides of 16 and 32 byte blocks.
+ ***********************************************************************/
+
+# line comment
+// another line comment                                        
+def int twice
+int a:
+																			return a * 2; // deep indentation
+enddef
+
+def int main
+int argc :
+	int a;
+	a = 0;
+	/*--------*/a = a + 1;
+	/*---------*/a = a + 1;
+	/*----------*/a = a + 1;
+	/*-----------*/a = a + 1;
+	/*------------*/a = a + 1;
+	/*-------------*/a = a + 1;
+	/*--------------*/a = a + 1;
+	/*---------------*/a = a + 1;
+	/*----------------*/a = a + 1;
+	/*-----------------*/a = a + 1;
+	/*------------------*/a = a + 1;
+	/*-------------------*/a = a + 1;
+	/*--------------------*/a = a + 1;
+	/*---------------------*/a = a + 1;
+	/*----------------------*/a = a + 1;
+	/*-----------------------*/a = a + 1;
+	/*------------------------*/a = a + 1;
+	/*-------------------------*/a = a + 1;
+	/*--------------------------*/a = a + 1;
+	/*---------------------------*/a = a + 1;
+	/*----------------------------*/a = a + 1;
+	/*-----------------------------*/a = a + 1;
+	/*------------------------------*/a = a + 1;
+	/*-------------------------------*/a = a + 1;
+	/*--------------------------------*/a = a + 1;
+	/*---------------------------------*/a = a + 1;
+               a = a + 1; #xxxxxxxxxxxxxxx
+                a = a + 1; #xxxxxxxxxxxxxxxx
+                 a = a + 1; #xxxxxxxxxxxxxxxxx
+                               a = a + 1; #xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+                                a = a + 1; #xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+                                 a = a + 1; #xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+	/* multi
+	   line */ print {twice a};
+	/* stars ** inside * / not the end **/
+                                        
+	print a; /* trailing */
+	return 0;
+enddef
+/* comment till the end of file */
@@ -0,0 +1,38 @@
+def int twice
+int x :
+	return x * 2;
+enddef
+
+def int main
+int argc :
+	int a;
+	int b;
+	a = 60 * 60 * 24;
+	b = 0;
+	read b;
+	print 2147483647 + 1;
+	print 65536 * 65536 + 3;
+	print -(-2147483648);
+	print -7 / 2;
+	print -7 % 2;
+	print 010 * 2;
+	print a * (3 - 1) + 5;
+	print {twice 4 * 5} - 2 * 3;
+	print b * 0;
+	if b != b then
+		print 1 / (3 - 3) + b;
+		print -2147483648 / -1;
+	fi
+	if 1 < 2 and 3 >= 4 or not [false and false] then
+		print 1;
+	fi
+	while b > 0 and true or false do
+		b = b - 1;
+	done
+	if [2 * 3 == 6 or b > 0] and not false then
+		print b;
+	else
+		print 0;
+	fi
+	return 0;
+enddef
@@ -0,0 +1,27 @@
+def int main
+int argc :
+	int i;
+	int j;
+	int k;
+	int s;
+	s = 0;
+	for i = 0 ; i < 4 ; i = i + 1 do
+		j = 0;
+		while j < i do
+			if j % 2 == 0 then
+				for k = 0 ; k < j ; k = k + 1 do
+					if k < 1 then
+						s = s + 1;
+					else
+						s = s + 10;
+					fi
+				done
+			else
+				s = s + 100;
+			fi
+			j = j + 1;
+		done
+	done
+	print s;
+	return 0;
+enddef
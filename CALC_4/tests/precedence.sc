@@ -0,0 +1,31 @@
+def int twice
+int x :
+	return x * 2;
+enddef
+
+def int main
+int argc :
+	int a;
+	int b;
+	a = 7;
+	b = 3;
+	print 10 - 3 - 2;
+	print 100 / 10 / 5;
+	print 100 % 7 % 3;
+	print a - b * 2 + 1;
+	print a * b % 4 * 5;
+	print -a + b;
+	print -a * -b;
+	print - - a;
+	print a - -b * 2;
+	print -a % b;
+	print -a / 2;
+	print 2 * (a + b) - a % b;
+	print (a - b) * (a + b) / (b - 1);
+	print {twice a - b} * b - {twice {twice 1}};
+	print +a - +b;
+	if a - b * 2 > 0 and a % b == 1 then
+		print 1;
+	fi
+	return 0;
+enddef
@@ -0,0 +1,5 @@
+def int main
+int argc :
+	print 1;
+enddef
+/* comment is not closed till the end of file